@@ -37,6 +37,36 @@ bool Perspective::GenerateRay(const int x, const int y, Ray *r, const float *cam
     r->FaceID = -1;
     r->propagating_eta = 1.f;
     r->rtype = PRIMARY;
+    r->throughput = RGB(1.f, 1.f, 1.f);
+    r->after_diffuse = false;
+    // a cone from the eye through the pixel (the lens aperture is ignored)
+    r->cone_width = 0.f;
+    r->cone_spread = pixel_spread;
 
     return true;
 }
+
+// inverse of GenerateRay for the pinhole camera ; the pixel sample positions are
+// uniform over the image plane, so We = 1 / (A cos^4) and pdf = 1 / (A cos^3),
+// where A is the area of the image plane at distance 1 (pbrt book, sec 16.1.1)
+bool Perspective::Project (const Point &p, int *x, int *y, Point *eye, float *We, float *pdf_dir) {
+    if (defocus_angle > 0.f) return false;
+    Vector d = Eye.vec2point(p);
+    float const z = d.dot(forward);
+    if (z <= 0.f) return false;
+    // where the ray crosses the viewport (at focus_dist)
+    Point const q = Eye + d * (focus_dist / z);
+    Vector const off = pixel00_loc.vec2point(q);
+    float const px = off.dot(pixel_delta_u) / pixel_delta_u.normSQ();
+    float const py = off.dot(pixel_delta_v) / pixel_delta_v.normSQ();
+    if (px < 0.f || py < 0.f || px >= (float)W || py >= (float)H) return false;
+    *x = (int)px;
+    *y = (int)py;
+    *eye = Eye;
+    d.normalize();
+    float const cos_theta = d.dot(forward);
+    float const cos2 = cos_theta * cos_theta;
+    *pdf_dir = 1.f / (image_area * cos2 * cos_theta);
+    *We = *pdf_dir / cos_theta;
+    return true;
+}
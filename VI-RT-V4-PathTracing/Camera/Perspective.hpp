@@ -12,6 +12,7 @@
 #include "camera.hpp"
 #include "ray.hpp"
 #include "vector.hpp"
+#include "RNG.hpp"
 #include <random>
 
 class Perspective: public Camera {
@@ -26,7 +27,7 @@ private:
      
      Our Random Number Generator (rng) */
     std::random_device rdev{};
-    std::mt19937 rng{rdev()};
+    RNG rng{rdev()};
     std::uniform_real_distribution<float>U_dist{-1.0,1.0};  // uniform distribution in[0,1[
     
     inline Point random_in_unit_disk() {
@@ -41,13 +42,18 @@ private:
     Point pixel00_loc;    // Location of pixel 0, 0
     Vector pixel_delta_u;  // Offset to pixel to the right
     Vector pixel_delta_v;  // Offset to pixel below
+    Vector forward;
+    float focus_dist;
+    float image_area;      // of the image plane at distance 1
+    float pixel_spread;    // angle subtended by a pixel (at the image centre)
 
 public:
     Perspective (const Point _Eye, const Point _At, const Vector _Up, const int _W, const int _H, const float _fovH, float _defocus_angle=0, float _focus_dist=1.): Eye(_Eye), At(_At), W(_W), H(_H), defocus_angle(_defocus_angle) {
 
         // compute camera 2 world transform
-        Vector forward (At.X-Eye.X, At.Y-Eye.Y, At.Z-Eye.Z);
+        forward = Vector (At.X-Eye.X, At.Y-Eye.Y, At.Z-Eye.Z);
         forward.normalize();
+        focus_dist = _focus_dist;
         Vector right = forward.cross(_Up);
         right.normalize();
         // recompute UP exactly as the cross product  right X forward
@@ -68,6 +74,8 @@ public:
         // Calculate the horizontal and vertical delta vectors from pixel to pixel.
         pixel_delta_u = viewport_u / W;
         pixel_delta_v = viewport_v / H;
+        image_area = viewport_width * viewport_height / (_focus_dist * _focus_dist);
+        pixel_spread = 2.f * tan_halfH / H;
 
         // Calculate the location of the upper left pixel.
         Point viewport_upper_left = Eye + _focus_dist*forward;
@@ -81,6 +89,7 @@ public:
     }
 
     bool GenerateRay(const int x, const int y, Ray *r, const float *cam_jitter=NULL);
+    bool Project (const Point &p, int *x, int *y, Point *eye, float *We, float *pdf_dir);
     void getResolution (int *_W, int *_H) {*_W=W; *_H=H;}
 };
 
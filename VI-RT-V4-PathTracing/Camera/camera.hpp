@@ -17,6 +17,11 @@ public:
     ~Camera() {}
     virtual bool GenerateRay(const int x, const int y, Ray *r, const float *cam_jitter=NULL) {return false;};
     virtual void getResolution (int *_W, int *_H) {*_W=0; *_H=0;}
+    // light tracing: the pixel (x,y) whose rays reach p, the camera position eye, and
+    // the importance We and pdf (solid angle) of the ray from eye through p, both
+    // normalized over the whole image ; false if p is out of view or the camera
+    // is not a pinhole
+    virtual bool Project (const Point &p, int *x, int *y, Point *eye, float *We, float *pdf_dir) {return false;}
 };
 
 #endif /* camera_hpp */
@@ -0,0 +1,95 @@
+//
+//  ImageAOV.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "ImageAOV.hpp"
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+
+// Ward's shared exponent: the mantissas of the largest component scale the others
+static void toRGBE (const RGB &c, unsigned char *rgbe) {
+    float const m = std::max(c.R, std::max(c.G, c.B));
+    if (m < 1e-32f) {
+        rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+        return;
+    }
+    int e;
+    float const scale = frexpf(m, &e) * 256.f / m;
+    rgbe[0] = (unsigned char)(std::max(c.R, 0.f) * scale);
+    rgbe[1] = (unsigned char)(std::max(c.G, 0.f) * scale);
+    rgbe[2] = (unsigned char)(std::max(c.B, 0.f) * scale);
+    rgbe[3] = (unsigned char)(e + 128);
+}
+
+static RGB fromRGBE (const unsigned char *rgbe) {
+    if (rgbe[3] == 0) return RGB(0., 0., 0.);
+    // the centre of the quantization interval
+    float const f = ldexpf(1.f, (int)rgbe[3] - (128 + 8));
+    return RGB((rgbe[0] + 0.5f) * f, (rgbe[1] + 0.5f) * f, (rgbe[2] + 0.5f) * f);
+}
+
+void ImageAOV::Mix (const std::vector<RGB> &gains, Image *img) {
+    int const N = W * H;
+    std::vector<RGB> sum(plane(-1), plane(-1) + N);
+    for (int g = 0 ; g < groups() ; g++) {
+        RGB gain = (g < (int)gains.size() ? gains[g] : RGB(1., 1., 1.));
+        if (gain.isZero()) continue;
+        RGB const *p = plane(g);
+        for (int i = 0 ; i < N ; i++) {
+            sum[i].R += gain.R * p[i].R;
+            sum[i].G += gain.G * p[i].G;
+            sum[i].B += gain.B * p[i].B;
+        }
+    }
+    for (int y = 0 ; y < H ; y++) {
+        for (int x = 0 ; x < W ; x++) img->set(x, y, sum[y*W+x]);
+    }
+}
+
+bool ImageAOV::Save (std::string filename) {
+    std::ofstream ofs(filename, std::ios::binary);
+    if (ofs.fail()) {
+        fprintf(stderr, "Can't open output file\n");
+        return false;
+    }
+    ofs << "AOV\n" << W << " " << H << " " << groups() << "\n";
+    for (const std::string &name : names) ofs << name << "\n";
+    std::vector<unsigned char> buffer((size_t)W * H * 4);
+    for (int g = -1 ; g < groups() ; g++) {
+        RGB const *p = plane(g);
+        for (int i = 0 ; i < W * H ; i++) toRGBE(p[i], &buffer[(size_t)i * 4]);
+        ofs.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    }
+    ofs.close();
+    return !ofs.fail();
+}
+
+bool ImageAOV::Load (std::string filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    std::string header;
+    int w, h, n;
+    ifs >> header >> w >> h >> n;
+    ifs.ignore(256, '\n');
+    if (ifs.fail() || header != "AOV" || w <= 0 || h <= 0 || n < 0) {
+        fprintf(stderr, "Can't read input file\n");
+        return false;
+    }
+    W = w;
+    H = h;
+    names.resize(n);
+    for (int g = 0 ; g < n ; g++) std::getline(ifs, names[g]);
+    planes.assign((size_t)(n + 1) * W * H, RGB(0., 0., 0.));
+    std::vector<unsigned char> buffer((size_t)W * H * 4);
+    for (int g = -1 ; g < n ; g++) {
+        ifs.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+        if (ifs.fail()) {
+            fprintf(stderr, "Truncated input file\n");
+            return false;
+        }
+        RGB *p = plane(g);
+        for (int i = 0 ; i < W * H ; i++) p[i] = fromRGBE(&buffer[(size_t)i * 4]);
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+//
+//  ImageAOV.hpp
+//  VI-RT-V4-PathTracing
+//
+//  The per light group AOVs of a render: one radiance plane per group plus
+//  a plane with the rest of the image (the radiance not due to any light:
+//  background, caustic photons, cached radiance), so that the planes add up
+//  to the rendered image.
+//  File layout: an ASCII header "AOV\n<W> <H> <groups>\n" followed by the
+//  group names (one per line), then the planes (the rest first, then the
+//  groups in order), rows top to bottom, 4 bytes per pixel in Ward's shared
+//  exponent RGBE format (Graphics Gems II, "Real pixels"): a third of the
+//  size of 3 floats, with about 1% relative precision.
+//
+
+#ifndef ImageAOV_hpp
+#define ImageAOV_hpp
+
+#include <string>
+#include <vector>
+#include "RGB.hpp"
+#include "image.hpp"
+
+class ImageAOV {
+    std::vector<RGB> planes;    // (groups + 1) x W x H
+public:
+    int W, H;
+    std::vector<std::string> names;     // of the groups
+    ImageAOV (): W(0), H(0) {}
+    ImageAOV (const int _W, const int _H, const std::vector<std::string> &_names): planes((_names.size() + 1) * _W * _H, RGB(0., 0., 0.)), W(_W), H(_H), names(_names) {}
+    int groups (void) const { return (int)names.size(); }
+    // the plane of group g ; g = -1: the rest of the image
+    RGB *plane (const int g) { return &planes[(size_t)(g + 1) * W * H]; }
+    // img: each pixel, the sum of the groups scaled by their gains plus the rest
+    void Mix (const std::vector<RGB> &gains, Image *img);
+    bool Save (std::string filename);
+    bool Load (std::string filename);
+};
+
+#endif /* ImageAOV_hpp */
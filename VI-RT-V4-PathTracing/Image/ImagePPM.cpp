@@ -8,6 +8,18 @@
 #include "ImagePPM.hpp"
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "Reinhard.hpp"
 #include "Box.hpp"
@@ -15,25 +27,23 @@
 
 void ImagePPM::ImgClamp (int const W, int const H, RGB *image, char_pixel *img2save) {
     
-    // Use a Post Filter ?
+    // Use a Post Filter ? (into a buffer of its own, then tone map that)
     //Box F;
-    Median F;
-    RGB * imageTM = new RGB[W*H];
-    //F.Filter(W, H, image, imageTM);
-    // Use a Tone Mapper ?
-    Reinhard TM;
-    TM.ToneMap(W, H, image, imageTM);
-    
-    // loop over each pixel in the image, clamp and convert to byte format
-    for (int j = 0 ; j< H ; j++) {
-        for (int i = 0; i < W ; ++i) {
-            RGB Cout = imageTM[j*W+i];
-            img2save[j*W+i].val[0] = (unsigned char)(fmax(fmin(1.f, Cout.R),0.f) * 255);
-            img2save[j*W+i].val[1] = (unsigned char)(fmax(fmin(1.f, Cout.G),0.f) * 255);
-            img2save[j*W+i].val[2] = (unsigned char)(fmax(fmin(1.f, Cout.B),0.f) * 255);
-        }
+    //Median F;
+    //F.Filter(W, H, image, imageF);
+    // Denoise ? (on the radiance, before tone mapping)
+    RGB * imageD = NULL;
+    if (features != NULL && denoise_passes > 0) {
+        ATrous D(*features, denoise_passes);
+        imageD = new RGB[W*H];
+        D.Filter(W, H, image, imageD);
+        image = imageD;
     }
-    delete [] imageTM;
+    // Use a Tone Mapper ? fused with the clamp and the conversion to byte format
+    Reinhard TM;
+    static_assert(sizeof(char_pixel) == 3, "char_pixel must be 3 packed bytes");
+    TM.ToneMapQuantize(W, H, image, reinterpret_cast<unsigned char *>(img2save));
+    if (imageD != NULL) delete [] imageD;
 }
 
 
@@ -52,57 +62,163 @@ bool ImagePPM::Save (std::string filename) {
         ofs.open(filename, std::ios::binary);  //need to spec. binary mode for Windows users
         if (ofs.fail()) throw("Can't open output file");
         ofs << "P6\n" << W << " " << H << "\n255\n";
-        unsigned char r, g, b;
-        // loop over each pixel in the image, clamp and convert to byte format
-        for (int i = 0; i < W * H; ++i) {
-            r = imageToSave[i].val[0];
-            g = imageToSave[i].val[1];
-            b = imageToSave[i].val[2];
-            ofs << r << g << b;
-        }
+        // the pixels, in one write
+        ofs.write((const char *)imageToSave, (std::streamsize)W * H * sizeof(char_pixel));
         ofs.close();
+        delete [] imageToSave;
         return true;
     }
     catch (const char *err) {
         fprintf(stderr, "%s\n", err);
         ofs.close();
+        delete [] imageToSave;
         return  false;
     }
 }
 
-bool ImagePPM::Load (std::string filename) {
-    std::ifstream ifs;
-     ifs.open(filename, std::ios::binary);
-     // need to spec. binary mode for Windows users
-     //Image src;
-     try {
-         if (ifs.fail()) {
-             throw("Can't open input file");
-             return false;
-         }
-         std::string header;
-         int w, h, b;
-         ifs >> header;
-         if (strcmp(header.c_str(), "P6") != 0) throw("Can't read input file");
-         ifs >> w >> h >> b;
-         W = w;
-         H = h;
-         imagePlane =  new RGB[W*H];
-         ifs.ignore(256, '\n');  //skip empty lines in necessary until we get to the binary data
-         unsigned char pix[3];  //read each pixel one by one and convert bytes to floats
-         for (int i = 0; i < w * h; ++i) {
-             ifs.read(reinterpret_cast<char *>(pix), 3);
-             imagePlane[i].R = pix[0] / 255.f;
-             imagePlane[i].G = pix[1] / 255.f;
-             imagePlane[i].B = pix[2] / 255.f;
-         }
-         ifs.close();
-     }
-     catch (const char *err) {
-         fprintf(stderr, "%s\n", err);
-         ifs.close();
-         return false;
-     }
-  
-     return true;
+// rows [y0, y1[ of H, one band per thread
+template <typename F>
+static void parallelRows (int const H, F f) {
+    int const n_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    for (int t=0 ; t<n_threads ; t++) {
+        int const y0 = H * t / n_threads, y1 = H * (t+1) / n_threads;
+        workers.push_back(std::thread(f, y0, y1));
+    }
+    for (std::thread &w : workers) w.join();
+}
+
+// next header token, past white space and # comments
+static bool headerToken (const unsigned char *f, size_t const size, size_t &pos, std::string &token) {
+    for (;;) {
+        while (pos < size && isspace(f[pos])) pos++;
+        if (pos >= size || f[pos] != '#') break;
+        while (pos < size && f[pos] != '\n') pos++;
+    }
+    size_t const start = pos;
+    while (pos < size && !isspace(f[pos])) pos++;
+    token.assign((const char *)f + start, pos - start);
+    return pos > start;
+}
+
+bool ImagePPM::OpenFile (std::string filename) {
+    CloseFile();
+#ifndef _WIN32
+    int const fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED) {
+            close(fd);
+            file = (const unsigned char *)m;
+            file_size = (size_t)st.st_size;
+            mapped = true;
+            return true;
+        }
+    }
+    close(fd);
+#endif
+    // can't be mapped: read it whole
+    std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+    if (ifs.fail()) return false;
+    file_size = (size_t)ifs.tellg();
+    ifs.seekg(0);
+    file_data.resize(file_size);
+    ifs.read((char *)file_data.data(), (std::streamsize)file_size);
+    if (ifs.fail()) {
+        CloseFile();
+        return false;
+    }
+    file = file_data.data();
+    return true;
+}
+
+void ImagePPM::CloseFile (void) {
+#ifndef _WIN32
+    if (mapped) munmap((void *)file, file_size);
+#endif
+    std::vector<unsigned char>().swap(file_data);
+    file = NULL;
+    file_size = 0;
+    mapped = false;
+    bytes = NULL;
+}
+
+// Portable Float Map (HDR): "PF\n" W H scale, then 3 floats per pixel with the
+// rows stored bottom to top ; scale < 0 means little endian data
+// http://www.pauldebevec.com/Research/HDR/PFM/
+bool ImagePPM::LoadPFM (const unsigned char *payload, float const scale) {
+    if (imagePlane != NULL) delete [] imagePlane;
+    imagePlane = new RGB[W*H];
+    uint16_t const one = 1;
+    bool const swap = ((scale < 0.f) != (*(const unsigned char *)&one == 1));
+    parallelRows(H, [&] (int const y0, int const y1) {
+        for (int j = y0 ; j < y1 ; j++) {
+            float *dst = &imagePlane[j*W].R;
+            memcpy(dst, payload + (size_t)(H-1-j) * W * 3 * sizeof(float), W * 3 * sizeof(float));
+            if (!swap) continue;
+            for (int c = 0 ; c < 3*W ; c++) {
+                unsigned char *b = (unsigned char *)&dst[c];
+                std::swap(b[0], b[3]);
+                std::swap(b[1], b[2]);
+            }
+        }
+    });
+    return true;
+}
+
+bool ImagePPM::Load (std::string filename, bool const keep_bytes) {
+    // whatever was loaded before goes
+    if (imagePlane != NULL) delete [] imagePlane;
+    imagePlane = NULL;
+    W = H = 0;
+    if (!OpenFile(filename)) {
+        fprintf(stderr, "Can't open input file\n");
+        return false;
+    }
+    try {
+        size_t pos = 0;
+        std::string header, ws, hs, ms;
+        if (!headerToken(file, file_size, pos, header) || !headerToken(file, file_size, pos, ws) ||
+            !headerToken(file, file_size, pos, hs) || !headerToken(file, file_size, pos, ms)) throw("Can't read input file");
+        pos++;  // the single white space before the pixels
+        int const w = atoi(ws.c_str()), h = atoi(hs.c_str());
+        if (w <= 0 || h <= 0) throw("Can't read input file");
+        size_t const n = (size_t)w * h * 3;
+        if (header == "PF") {
+            if (pos + n * sizeof(float) > file_size) throw("Can't read input file");
+            W = w;
+            H = h;
+            LoadPFM(file + pos, strtof(ms.c_str(), nullptr));
+            CloseFile();
+            return true;
+        }
+        if (header != "P6") throw("Can't read input file");
+        int const maxval = atoi(ms.c_str());
+        if (maxval <= 0 || maxval > 255) throw("Only 8 bit P6 images are supported");
+        if (pos + n > file_size) throw("Can't read input file");
+        W = w;
+        H = h;
+        if (keep_bytes && maxval == 255) {
+            bytes = file + pos;
+            return true;
+        }
+        // bytes to floats, a loop the compiler vectorizes, the rows split among threads
+        imagePlane = new RGB[W*H];
+        const unsigned char *src = file + pos;
+        float *dst = &imagePlane[0].R;
+        float const max = (float)maxval;
+        parallelRows(H, [&] (int const y0, int const y1) {
+            for (int i = y0*W*3 ; i < y1*W*3 ; i++) dst[i] = src[i] / max;
+        });
+        CloseFile();
+    }
+    catch (const char *err) {
+        fprintf(stderr, "%s\n", err);
+        CloseFile();
+        W = H = 0;
+        return false;
+    }
+    return true;
 }
@@ -8,17 +8,52 @@
 #ifndef ImagePPM_hpp
 #define ImagePPM_hpp
 #include "image.hpp"
+#include <fstream>
+#include <vector>
+#include "ATrous.hpp"
 //#include "ToneMap.hpp"
 //#include "Reinhard.hpp"
 
 class ImagePPM: public Image {
     char_pixel *imageToSave;
+    FeatureBuffers *features;   // denoise with these before tone mapping (NULL: don't)
+    int denoise_passes;
+    // the loaded file: mapped, or read whole if it can't be (file_data)
+    const unsigned char *file;
+    size_t file_size;
+    bool mapped;
+    std::vector<unsigned char> file_data;
+    const unsigned char *bytes;     // 8 bit pixels left in the file (NULL: in imagePlane)
+    bool OpenFile (std::string filename);
+    void CloseFile (void);
+    // W x H floats (r,g,b) into a new imagePlane ; Load has checked that the file holds them
+    bool LoadPFM (const unsigned char *payload, float const scale);
+    bool Load (std::string filename, bool const keep_bytes);
 
 public:
-    ImagePPM(const int W, const int H):Image(W, H) {}
-    ImagePPM():Image() {}
+    ImagePPM(const int W, const int H):Image(W, H), features(NULL), denoise_passes(0), file(NULL), file_size(0), mapped(false), bytes(NULL) {}
+    ImagePPM():Image(), features(NULL), denoise_passes(0), file(NULL), file_size(0), mapped(false), bytes(NULL) {}
+    ~ImagePPM() { CloseFile(); }
+    // the a-trous filter runs at Save, on the features the renderer recorded
+    void SetDenoiser (FeatureBuffers *_features, const int passes=5) {
+        features = _features;
+        denoise_passes = passes;
+    }
     bool Save (std::string filename);
-    bool Load (std::string filename);
+    // loads 8 bit (P6) and float (PF) images into the RGB plane
+    bool Load (std::string filename) { return Load(filename, false); }
+    // as Load, but 8 bit images stay in the mapped file (no RGB plane) ; read them with texel
+    bool LoadTexture (std::string filename) { return Load(filename, true); }
+    // pixel (x, y), clamped to the image, from the plane or the 8 bit data
+    RGB texel (int x, int y) const {
+        x = (x < 0 ? 0 : (x >= W ? W-1 : x));
+        y = (y < 0 ? 0 : (y >= H ? H-1 : y));
+        if (bytes != NULL) {
+            const unsigned char *p = bytes + 3*(y*W+x);
+            return RGB(p[0] / 255.f, p[1] / 255.f, p[2] / 255.f);
+        }
+        return imagePlane[y*W+x];
+    }
     void ImgClamp (int const W, int const H, RGB *image, char_pixel *img2save);
 };
 
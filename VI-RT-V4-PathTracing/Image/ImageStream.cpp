@@ -0,0 +1,93 @@
+//
+//  ImageStream.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "ImageStream.hpp"
+#include <cstdio>
+#include "image.hpp"
+#include "Reinhard.hpp"
+
+ImageStream::ImageStream (const int _W, const int _H, const int _rows, const int inFlight): W(_W), H(_H) {
+    rows = (_rows > 0 ? _rows : 1);
+    int const n = (inFlight > 1 ? inFlight : 2);
+    buffers.resize(n);
+    for (int b=0 ; b<n ; b++) free_buffers.push_back(b);
+    current = -1;
+    closing = false;
+    ok = true;
+}
+
+ImageStream::~ImageStream () {
+    Close();
+}
+
+bool ImageStream::Open (std::string filename) {
+    ofs.open(filename, std::ios::binary);
+    if (ofs.fail()) {
+        fprintf(stderr, "Can't open output file\n");
+        return false;
+    }
+    ofs << "P6\n" << W << " " << H << "\n255\n";
+    writer = std::thread(&ImageStream::WriteLoop, this);
+    return true;
+}
+
+void ImageStream::WriteLoop () {
+    std::vector<char_pixel> bytes((size_t)rows * W);
+    Reinhard TM;
+    for (;;) {
+        std::pair<int, int> band;
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [this] () { return !full.empty() || closing; });
+            if (full.empty()) return;
+            band = full.front();
+            full.pop_front();
+        }
+        TM.ToneMapQuantize(W, band.second, buffers[band.first].data(), reinterpret_cast<unsigned char *>(bytes.data()));
+        ofs.write((const char *)bytes.data(), (std::streamsize)band.second * W * sizeof(char_pixel));
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if (ofs.fail()) ok = false;
+            free_buffers.push_back(band.first);
+        }
+        cv.notify_all();
+    }
+}
+
+RGB *ImageStream::Band (void) {
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait(lock, [this] () { return !free_buffers.empty(); });
+    current = free_buffers.front();
+    free_buffers.pop_front();
+    // allocated on first use
+    buffers[current].assign((size_t)rows * W, RGB(0., 0., 0.));
+    return buffers[current].data();
+}
+
+void ImageStream::Commit (const int n) {
+    if (current < 0) return;
+    {
+        std::lock_guard<std::mutex> lock(m);
+        full.push_back(std::make_pair(current, (n < rows ? n : rows)));
+        current = -1;
+    }
+    cv.notify_all();
+}
+
+bool ImageStream::Close (void) {
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            closing = true;
+        }
+        cv.notify_all();
+        writer.join();
+    }
+    if (ofs.is_open()) {
+        ofs.close();
+        if (ofs.fail()) ok = false;
+    }
+    return ok;
+}
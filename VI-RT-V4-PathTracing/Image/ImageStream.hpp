@@ -0,0 +1,55 @@
+//
+//  ImageStream.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Streaming PPM output for resolutions that do not fit in memory. There
+//  is no W x H plane: the renderer fills bands of rows, top to bottom, and
+//  a writer thread tone maps (Reinhard) each finished band and appends it to
+//  the file while the next ones render. At most inFlight bands exist at a
+//  time, so the memory is bounded by inFlight * rows * W, whatever H is.
+//  Only per pixel operators fit: no post filters or denoising.
+//
+
+#ifndef ImageStream_hpp
+#define ImageStream_hpp
+
+#include "RGB.hpp"
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class ImageStream {
+    int rows;
+    std::ofstream ofs;
+    std::vector<std::vector<RGB> > buffers;
+    std::deque<int> free_buffers;
+    std::deque<std::pair<int, int> > full;   // buffer, rows in it ; in image order
+    int current;                             // the band being rendered (-1: none)
+    std::mutex m;
+    std::condition_variable cv;
+    std::thread writer;
+    bool closing;
+    bool ok;
+    void WriteLoop ();
+public:
+    int W, H;
+    // rows: rows per band ; inFlight: bands rendering, queued or being written
+    ImageStream (const int W, const int H, const int rows=16, const int inFlight=4);
+    ~ImageStream ();
+    // writes the header and starts the writer
+    bool Open (std::string filename);
+    int BandRows (void) const { return rows; }
+    // a band of BandRows() x W pixels to render into (waits while all are in flight)
+    RGB *Band (void);
+    // the first n rows of the last Band are done: queue them for writing
+    void Commit (const int n);
+    // waits for the writer ; false if any write failed
+    bool Close (void);
+};
+
+#endif /* ImageStream_hpp */
@@ -0,0 +1,109 @@
+//
+//  MipTexture.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "MipTexture.hpp"
+#include <algorithm>
+#include <cmath>
+
+void MipTexture::allocate (Level &L, int const w, int const h) {
+    L.w = w;
+    L.h = h;
+    L.tiles_x = (w + MIP_TILE - 1) / MIP_TILE;
+    int const tiles_y = (h + MIP_TILE - 1) / MIP_TILE;
+    L.texels.assign(3 * (size_t)L.tiles_x * tiles_y * MIP_TILE * MIP_TILE, 0);
+}
+
+bool MipTexture::Build (const ImagePPM &image) {
+    levels.clear();
+    W = image.W;
+    H = image.H;
+    if (W <= 0 || H <= 0) return false;
+
+    Level L0;
+    allocate(L0, W, H);
+    for (int y=0 ; y<H ; y++) {
+        for (int x=0 ; x<W ; x++) {
+            RGB const c = image.texel(x, y);
+            unsigned char *t = &L0.texels[offset(L0, x, y)];
+            t[0] = (unsigned char)(std::min(1.f, std::max(0.f, c.R)) * 255.f + 0.5f);
+            t[1] = (unsigned char)(std::min(1.f, std::max(0.f, c.G)) * 255.f + 0.5f);
+            t[2] = (unsigned char)(std::min(1.f, std::max(0.f, c.B)) * 255.f + 0.5f);
+        }
+    }
+    levels.push_back(L0);
+
+    // each level the rounded mean of 2x2 texels of the one above (the last row or column repeated if odd)
+    while (levels.back().w > 1 || levels.back().h > 1) {
+        Level const &P = levels.back();
+        Level L;
+        allocate(L, std::max(1, P.w / 2), std::max(1, P.h / 2));
+        for (int y=0 ; y<L.h ; y++) {
+            int const y0 = std::min(2*y, P.h-1), y1 = std::min(2*y+1, P.h-1);
+            for (int x=0 ; x<L.w ; x++) {
+                int const x0 = std::min(2*x, P.w-1), x1 = std::min(2*x+1, P.w-1);
+                const unsigned char *a = &P.texels[offset(P, x0, y0)], *b = &P.texels[offset(P, x1, y0)];
+                const unsigned char *c = &P.texels[offset(P, x0, y1)], *d = &P.texels[offset(P, x1, y1)];
+                unsigned char *t = &L.texels[offset(L, x, y)];
+                for (int k=0 ; k<3 ; k++) t[k] = (unsigned char)((a[k] + b[k] + c[k] + d[k] + 2) / 4);
+            }
+        }
+        levels.push_back(L);
+    }
+    return true;
+}
+
+size_t MipTexture::Bytes (void) const {
+    size_t b = 0;
+    for (const Level &L : levels) b += L.texels.size();
+    return b;
+}
+
+float MipTexture::LOD (float const uv_width) const {
+    if (uv_width <= 0.f) return 0.f;
+    return std::max(0.f, log2f(uv_width * std::max(W, H)));
+}
+
+void MipTexture::fetch (const Level &L, int x, int y, float *rgb) {
+    x = std::min(std::max(x, 0), L.w-1);
+    y = std::min(std::max(y, 0), L.h-1);
+    const unsigned char *t = &L.texels[offset(L, x, y)];
+    rgb[0] = t[0];
+    rgb[1] = t[1];
+    rgb[2] = t[2];
+}
+
+RGB MipTexture::bilinear (const Level &L, float const u, float const v) {
+    // texel centres at (i + 0.5) / w
+    float const x = u * L.w - 0.5f, y = v * L.h - 0.5f;
+    // floor of x, y >= -0.5 (u, v are clamped), without the libm call
+    int const x0 = (int)(x + 1.f) - 1, y0 = (int)(y + 1.f) - 1;
+    float const fx = x - x0, fy = y - y0;
+    float c00[3], c10[3], c01[3], c11[3];
+    fetch(L, x0, y0, c00);
+    fetch(L, x0+1, y0, c10);
+    fetch(L, x0, y0+1, c01);
+    fetch(L, x0+1, y0+1, c11);
+    float rgb[3];
+    for (int k=0 ; k<3 ; k++) {
+        float const top = c00[k] + fx * (c10[k] - c00[k]);
+        float const bottom = c01[k] + fx * (c11[k] - c01[k]);
+        rgb[k] = (top + fy * (bottom - top)) / 255.f;
+    }
+    return RGB(rgb);
+}
+
+RGB MipTexture::Lookup (float const u, float const v, float const lod) const {
+    if (levels.empty()) return RGB(0., 0., 0.);
+    float const su = std::min(std::max(u, 0.f), 1.f), sv = std::min(std::max(v, 0.f), 1.f);
+    int const last = (int)levels.size() - 1;
+    if (!(lod > 0.f)) return bilinear(levels[0], su, sv);
+    if (lod >= last) return bilinear(levels[last], su, sv);
+    int const l = (int)lod;
+    float const f = lod - l;
+    RGB fine = bilinear(levels[l], su, sv);
+    if (f <= 0.f) return fine;
+    RGB coarse = bilinear(levels[l+1], su, sv);
+    return fine * (1.f - f) + coarse * f;
+}
@@ -0,0 +1,61 @@
+//
+//  MipTexture.hpp
+//  VI-RT-V4-PathTracing
+//
+//  8 bit RGB texture with a MIP pyramid (each level a 2x2 box filter of the
+//  one above, down to 1x1). Every level is stored in tiles of
+//  MIP_TILE x MIP_TILE texels, the texels of a tile in Morton (Z) order, so
+//  that the 4 texels of a bilinear lookup are nearly always in the same
+//  cache line or two. Lookups are trilinear between the two levels around
+//  the level of detail, and clamp to the border. The values are the file's
+//  bytes / 255, as ImagePPM reads them.
+//
+
+#ifndef MipTexture_hpp
+#define MipTexture_hpp
+
+#include <vector>
+#include <cstddef>
+#include "RGB.hpp"
+#include "ImagePPM.hpp"
+
+// texels per tile side (a power of 2, at most 16)
+#define MIP_TILE 8
+
+class MipTexture {
+    typedef struct Level {
+        int w, h;
+        int tiles_x;                        // tiles per row
+        std::vector<unsigned char> texels;  // r,g,b per texel, tile after tile
+    } Level;
+    std::vector<Level> levels;
+    // position of (x, y) within a tile: the bits of x and y interleaved
+    static int morton (int const x, int const y) {
+        // the bits of 0..15 spread to the even positions
+        static const unsigned char spread[16] = {0, 1, 4, 5, 16, 17, 20, 21, 64, 65, 68, 69, 80, 81, 84, 85};
+        return spread[x] | (spread[y] << 1);
+    }
+    // (x, y) inside L
+    static size_t offset (const Level &L, int const x, int const y) {
+        int const tile = (y / MIP_TILE) * L.tiles_x + x / MIP_TILE;
+        return 3 * ((size_t)tile * MIP_TILE * MIP_TILE + morton(x & (MIP_TILE-1), y & (MIP_TILE-1)));
+    }
+    static void allocate (Level &L, int const w, int const h);
+    // texel (x, y) of L, clamped to it
+    static void fetch (const Level &L, int x, int y, float *rgb);
+    static RGB bilinear (const Level &L, float const u, float const v);
+public:
+    int W, H;
+    MipTexture (): W(0), H(0) {}
+    // from an image loaded with Load or LoadTexture (float values are clamped to [0,1])
+    bool Build (const ImagePPM &image);
+    int Levels (void) const { return (int)levels.size(); }
+    // memory taken by the pyramid
+    size_t Bytes (void) const;
+    // level of detail of a lookup uv_width wide in texture space (0: full resolution)
+    float LOD (float const uv_width) const;
+    // trilinear lookup at (u, v) in [0,1]^2 ; lod 0 is bilinear on the full resolution
+    RGB Lookup (float const u, float const v, float const lod=0.f) const;
+};
+
+#endif /* MipTexture_hpp */
@@ -0,0 +1,123 @@
+//
+//  ATrous.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Edge-avoiding a-trous wavelet filter (Dammertz et al., "Edge-avoiding
+//  a-trous wavelet transform for fast global illumination filtering",
+//  HPG 2010). Each pass blurs with the 5x5 B3 spline kernel, its taps 2^i
+//  pixels apart, weighted down across edges of the first hit features:
+//  shading normal, depth and colour. The colour is divided by the first hit
+//  albedo before filtering (and multiplied back after), so the texture is
+//  not blurred with the noise. Pixels without a surface (lights, background:
+//  normal 0) are kept as they are. The rows are split among threads.
+//
+
+#ifndef ATrous_hpp
+#define ATrous_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "RGB.hpp"
+#include "vector.hpp"
+
+// first hit features, averaged over the samples of each pixel
+typedef struct FeatureBuffers {
+    std::vector<RGB> albedo;        // Kd (or the texture) ; 0: not a diffuse surface
+    std::vector<Vector> normal;     // shading normal facing the camera ; 0: no surface
+    std::vector<float> depth;       // distance along the primary ray
+    FeatureBuffers (const int W, const int H): albedo(W*H, RGB(0.,0.,0.)), normal(W*H), depth(W*H, 0.f) {}
+} FeatureBuffers;
+
+class ATrous  {
+
+    const FeatureBuffers &fb;
+    int passes;
+    float sigma_c;      // colour, on the tone mapped demodulated colour ; halved every pass
+    int sigma_n;        // the cosine between the normals is raised to 2^sigma_n
+    float sigma_z;      // relative depth difference per pixel of distance
+
+    void pass (int const W, int const H, int const step, float const s_c, const RGB *in, RGB *out, int const y0, int const y1) const {
+        static const float k[5] = {1.f/16.f, 1.f/4.f, 3.f/8.f, 1.f/4.f, 1.f/16.f};
+        for (int y=y0 ; y<y1 ; y++) {
+            for (int x=0 ; x<W ; x++) {
+                int const offset = y*W + x;
+                RGB Cp = in[offset];
+                Vector const &Np = fb.normal[offset];
+                if (Np.normSQ() <= 0.f) {
+                    out[offset] = Cp;
+                    continue;
+                }
+                float const Zp = fb.depth[offset];
+                float const Lp = Cp.Y();
+                RGB const Tp = Cp * (1.f / (1.f + std::max(0.f, Lp)));
+                RGB sum(0.,0.,0.);
+                float sumW = 0.f;
+                for (int v=-2 ; v<=2 ; v++) {
+                    int const yq = y + v*step;
+                    if (yq < 0 || yq >= H) continue;
+                    for (int u=-2 ; u<=2 ; u++) {
+                        int const xq = x + u*step;
+                        if (xq < 0 || xq >= W) continue;
+                        int const q = yq*W + xq;
+                        float w = k[u+2] * k[v+2];
+                        RGB Cq = in[q];
+                        if (q != offset) {
+                            float const cos_n = Np.dot(fb.normal[q]);
+                            if (cos_n <= 0.f) continue;
+                            float wn = cos_n;
+                            for (int e=0 ; e<sigma_n ; e++) wn *= wn;
+                            w *= wn;
+                            float const dist = step * sqrtf((float)(u*u + v*v));
+                            float const dZ = fabsf(Zp - fb.depth[q]) / (sigma_z * Zp * dist + EPSILON);
+                            RGB const Tq = Cq * (1.f / (1.f + std::max(0.f, Cq.Y())));
+                            float const dR = Tp.R - Tq.R, dG = Tp.G - Tq.G, dB = Tp.B - Tq.B;
+                            float const dC = (dR*dR + dG*dG + dB*dB) / (s_c * s_c);
+                            w *= expf(-dZ - dC);
+                        }
+                        sum += Cq * w;
+                        sumW += w;
+                    }
+                }
+                out[offset] = sum / sumW;
+            }
+        }
+    }
+
+public:
+    ATrous (const FeatureBuffers &_fb, const int _passes=5): fb(_fb) {
+        passes = _passes;
+        sigma_c = 1.f;
+        sigma_n = 6;
+        sigma_z = 0.02f;
+    }
+    void Filter (int const W, int const H, RGB *imageIn, RGB *imageOut) {
+        // demodulate: filter the light arriving at the surface, not the texture
+        std::vector<RGB> a(W*H), b(W*H);
+        for (int i=0 ; i<W*H ; i++) {
+            RGB const &A = fb.albedo[i];
+            RGB C = imageIn[i];
+            a[i] = RGB(A.R > 0.f ? C.R / A.R : C.R, A.G > 0.f ? C.G / A.G : C.G, A.B > 0.f ? C.B / A.B : C.B);
+        }
+        int const n_threads = std::max(1u, std::thread::hardware_concurrency());
+        float s_c = sigma_c;
+        for (int i=0 ; i<passes ; i++) {
+            std::vector<std::thread> workers;
+            for (int t=0 ; t<n_threads ; t++) {
+                int const y0 = H * t / n_threads, y1 = H * (t+1) / n_threads;
+                workers.push_back(std::thread(&ATrous::pass, this, W, H, 1 << i, s_c, a.data(), b.data(), y0, y1));
+            }
+            for (std::thread &w : workers) w.join();
+            a.swap(b);
+            s_c *= 0.5f;
+        }
+        for (int i=0 ; i<W*H ; i++) {
+            RGB const &A = fb.albedo[i];
+            RGB const &C = a[i];
+            imageOut[i] = RGB(A.R > 0.f ? C.R * A.R : C.R, A.G > 0.f ? C.G * A.G : C.G, A.B > 0.f ? C.B * A.B : C.B);
+        }
+    }
+};
+
+#endif /* ATrous_hpp */
@@ -8,40 +8,95 @@
 #ifndef Box_hpp
 #define Box_hpp
 
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "RGB.hpp"
 #include "vector.hpp"
 
+// Each pixel keeps its colour, scaled to the mean luminance of the
+// (2 radius + 1)^2 window around it. The window sums are separable running
+// sums (a row pass, then a column pass over whole rows, which the compiler
+// vectorizes), independent of the radius ; the rows are split among threads.
+// Pixels closer than radius to the border are copied.
 class Box  {
 
-    const int margin=3;
-    const int hmargin=1;
-    const float mSq = margin*margin;
+    int hmargin;
+
+    template <typename F>
+    static void parallelRows (int const H, F f) {
+        int const n_threads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> workers;
+        for (int t=0 ; t<n_threads ; t++) {
+            int const y0 = H * t / n_threads, y1 = H * (t+1) / n_threads;
+            workers.push_back(std::thread(f, y0, y1));
+        }
+        for (std::thread &w : workers) w.join();
+    }
 
 public:
-    Box () {}
+    Box (const int radius=1): hmargin(radius > 0 ? radius : 1) {}
     void Filter (int const W, int const H, RGB *imageIn, RGB *imageOut) {
-        for (int y=hmargin ; y<H-hmargin ; y++) {
-            int const row_off = y*W;
-            for (int x=hmargin ; x<W-hmargin ; x++) {
-                int const offset = row_off + x;
-                RGB  Cin = imageIn[offset];
-                float const Lin = Cin.Y();
-                if (abs(Lin) < EPSILON ) {
-                    imageOut[offset] = Cin;
-                    continue;
+        int const r = hmargin, side = 2*r+1;
+        double const mSq = side*side;
+        if (W < side || H < side) {
+            std::copy(imageIn, imageIn + W*H, imageOut);
+            return;
+        }
+        // horizontal sums of the luminance (double: the lights are much brighter than the rest)
+        std::vector<double> rowSum(W*H, 0.);
+        parallelRows(H, [&] (int const y0, int const y1) {
+            for (int y=y0 ; y<y1 ; y++) {
+                RGB const *in = imageIn + y*W;
+                double *out = rowSum.data() + y*W;
+                double s = 0.;
+                for (int u=0 ; u<side ; u++) s += in[u].Y();
+                out[r] = s;
+                for (int x=r+1 ; x<W-r ; x++) {
+                    s += in[x+r].Y() - in[x-r-1].Y();
+                    out[x] = s;
+                }
+            }
+        });
+        // vertical sums, each thread sliding its window down its rows
+        parallelRows(H, [&] (int const y0, int const y1) {
+            int const first = std::max(y0, r), last = std::min(y1, H-r);
+            for (int y=y0 ; y<y1 ; y++) {
+                if (y >= first && y < last) {
+                    std::copy(imageIn + y*W, imageIn + y*W + r, imageOut + y*W);
+                    std::copy(imageIn + y*W + W-r, imageIn + (y+1)*W, imageOut + y*W + W-r);
+                } else {
+                    std::copy(imageIn + y*W, imageIn + (y+1)*W, imageOut + y*W);
                 }
-                float sumL=0.f;
-                for (int v=-hmargin ; v<(hmargin+1) ; v++) {
-                    int const row_off_uv = (y+v)*W;
-                    for (int u=-hmargin ; u<(hmargin+1) ; u++) {
-                        int const offset_uv = row_off_uv + x+u;
-                        sumL += imageIn[offset_uv].Y();
+            }
+            if (first >= last) return;
+            std::vector<double> colSum(W, 0.);
+            double *cs = colSum.data();
+            for (int v=first-r ; v<=first+r ; v++) {
+                double const *rs = rowSum.data() + v*W;
+                for (int x=r ; x<W-r ; x++) cs[x] += rs[x];
+            }
+            for (int y=first ; y<last ; y++) {
+                if (y > first) {
+                    double const *add = rowSum.data() + (y+r)*W;
+                    double const *sub = rowSum.data() + (y-r-1)*W;
+                    for (int x=r ; x<W-r ; x++) cs[x] += add[x] - sub[x];
+                }
+                int const row_off = y*W;
+                for (int x=r ; x<W-r ; x++) {
+                    int const offset = row_off + x;
+                    RGB  Cin = imageIn[offset];
+                    float const Lin = Cin.Y();
+                    if (std::abs(Lin) < EPSILON ) {
+                        imageOut[offset] = Cin;
+                        continue;
                     }
+                    float const Lout = (float)(cs[x] / mSq);
+                    imageOut[offset] = Cin * (Lout / Lin);
                 }
-                float  Lout = sumL / mSq;
-                RGB Cout = Cin * Lout / Lin;
-                imageOut[offset] = Cout;
             }
-        }
+        });
     }
 };
 
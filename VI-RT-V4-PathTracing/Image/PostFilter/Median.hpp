@@ -1,5 +1,5 @@
 //
-//  Box.hpp
+//  Median.hpp
 //  VI-RT-V4-PathTracing
 //
 //  Created by Luis Paulo Santos on 26/03/2025.
@@ -10,40 +10,160 @@
 
 #include <vector>
 #include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+#include <utility>
+#include "RGB.hpp"
 #include "vector.hpp"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Each pixel keeps its colour, scaled to the median luminance of the
+// (2 radius + 1)^2 window around it. The median comes out of a sorting
+// network (Batcher's odd-even merge sort over the window padded to a power
+// of 2, keeping only the compare-exchanges the median depends on), run on
+// MEDIAN_LANES neighbouring pixels at once, each compare-exchange a SIMD
+// min / max ; the rows are split among threads. Pixels closer than
+// radius to the border are copied.
+
+#define MEDIAN_LANES 8
+
 class Median  {
-    const int margin=5;
-    const int hmargin=2;
-    const int median_ndx = 12;
+    int hmargin;
+    int margin;         // window side
+    int n;              // window size
+    int median_ndx;
+    int padded;         // n rounded up to a power of 2
+    std::vector<std::pair<int, int> > network;
+
+    void buildNetwork () {
+        padded = 1;
+        while (padded < n) padded <<= 1;
+        std::vector<std::pair<int, int> > all;
+        for (int p=1 ; p<padded ; p<<=1) {
+            for (int k=p ; k>=1 ; k>>=1) {
+                for (int j=k%p ; j+k<padded ; j+=2*k) {
+                    for (int i=0 ; i<k && i+j+k<padded ; i++) {
+                        if ((i+j) / (2*p) == (i+j+k) / (2*p)) all.push_back(std::make_pair(i+j, i+j+k));
+                    }
+                }
+            }
+        }
+        // the padding (+inf) never moves down past a real value: skip those
+        std::vector<bool> pad(padded, false);
+        for (int i=n ; i<padded ; i++) pad[i] = true;
+        std::vector<std::pair<int, int> > live;
+        for (const std::pair<int, int> &c : all) {
+            if (pad[c.second]) continue;
+            if (pad[c.first]) {
+                pad[c.first] = false;
+                pad[c.second] = true;
+            }
+            live.push_back(c);
+        }
+        // only what the median depends on
+        std::vector<bool> needed(padded, false);
+        needed[median_ndx] = true;
+        network.clear();
+        for (int c=(int)live.size()-1 ; c>=0 ; c--) {
+            if (!needed[live[c].first] && !needed[live[c].second]) continue;
+            needed[live[c].first] = needed[live[c].second] = true;
+            network.push_back(live[c]);
+        }
+        std::reverse(network.begin(), network.end());
+    }
+
+    // the median luminance of the windows centred at (x, y) ... (x+MEDIAN_LANES-1, y)
+    // w: room for padded * MEDIAN_LANES floats
+    void medians (int const W, const float *L, int const x, int const y, float (*w)[MEDIAN_LANES], float *med) const {
+        int k = 0;
+        for (int v=-hmargin ; v<=hmargin ; v++) {
+            const float *row = L + (y+v)*W + x;
+            for (int u=-hmargin ; u<=hmargin ; u++, k++) {
+                for (int l=0 ; l<MEDIAN_LANES ; l++) w[k][l] = row[u+l];
+            }
+        }
+        for ( ; k<padded ; k++) {
+            for (int l=0 ; l<MEDIAN_LANES ; l++) w[k][l] = FLT_MAX;
+        }
+        for (const std::pair<int, int> &c : network) {
+            float *a = w[c.first], *b = w[c.second];
+#if defined(__AVX__)
+            __m256 const va = _mm256_loadu_ps(a), vb = _mm256_loadu_ps(b);
+            _mm256_storeu_ps(a, _mm256_min_ps(va, vb));
+            _mm256_storeu_ps(b, _mm256_max_ps(va, vb));
+#elif defined(__SSE2__)
+            for (int l=0 ; l<MEDIAN_LANES ; l+=4) {
+                __m128 const va = _mm_loadu_ps(a+l), vb = _mm_loadu_ps(b+l);
+                _mm_storeu_ps(a+l, _mm_min_ps(va, vb));
+                _mm_storeu_ps(b+l, _mm_max_ps(va, vb));
+            }
+#else
+            for (int l=0 ; l<MEDIAN_LANES ; l++) {
+                float const lo = (a[l] < b[l] ? a[l] : b[l]);
+                float const hi = (a[l] < b[l] ? b[l] : a[l]);
+                a[l] = lo;
+                b[l] = hi;
+            }
+#endif
+        }
+        for (int l=0 ; l<MEDIAN_LANES ; l++) med[l] = w[median_ndx][l];
+    }
 
 public:
-    Median () {}
+    Median (const int radius=2) {
+        hmargin = (radius > 0 ? radius : 1);
+        margin = 2*hmargin+1;
+        n = margin*margin;
+        median_ndx = n/2;
+        buildNetwork();
+    }
     void Filter (int const W, int const H, RGB *imageIn, RGB *imageOut) {
-        for (int y=hmargin ; y<H-hmargin ; y++) {
-            int const row_off = y*W;
-            for (int x=hmargin ; x<W-hmargin ; x++) {
-                int const offset = row_off + x;
-                RGB  Cin = imageIn[offset];
-                float const Lin = Cin.Y();
-                if (abs(Lin) < EPSILON ) {
-                    imageOut[offset] = Cin;
-                    continue;
-                }
-                std::vector<float> window;
-                for (int v=-hmargin ; v<(hmargin+1) ; v++) {
-                    int const row_off_uv = (y+v)*W;
-                    for (int u=-hmargin ; u<(hmargin+1) ; u++) {
-                        int const offset_uv = row_off_uv + x+u;
-                        window.push_back(imageIn[offset_uv].Y());
+        int const r = hmargin;
+        // the luminance, padded to whole blocks of lanes on the right
+        int const LW = W + MEDIAN_LANES;
+        std::vector<float> L(LW*H, 0.f);
+        for (int y=0 ; y<H ; y++) {
+            for (int x=0 ; x<W ; x++) L[y*LW+x] = imageIn[y*W+x].Y();
+        }
+        int const n_threads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> workers;
+        for (int t=0 ; t<n_threads ; t++) {
+            int const y0 = H * t / n_threads, y1 = H * (t+1) / n_threads;
+            workers.push_back(std::thread([&, y0, y1] () {
+                std::vector<float> scratch(padded * MEDIAN_LANES);
+                float (*w)[MEDIAN_LANES] = (float (*)[MEDIAN_LANES])scratch.data();
+                float med[MEDIAN_LANES];
+                for (int y=y0 ; y<y1 ; y++) {
+                    int const row_off = y*W;
+                    if (y < r || y >= H-r || W < margin) {
+                        std::copy(imageIn + row_off, imageIn + row_off + W, imageOut + row_off);
+                        continue;
+                    }
+                    std::copy(imageIn + row_off, imageIn + row_off + r, imageOut + row_off);
+                    std::copy(imageIn + row_off + W-r, imageIn + row_off + W, imageOut + row_off + W-r);
+                    for (int x=r ; x<W-r ; x+=MEDIAN_LANES) {
+                        medians(LW, L.data(), x, y, w, med);
+                        for (int l=0 ; l<MEDIAN_LANES && x+l<W-r ; l++) {
+                            int const offset = row_off + x+l;
+                            RGB  Cin = imageIn[offset];
+                            float const Lin = L[y*LW+x+l];
+                            if (std::abs(Lin) < EPSILON ) {
+                                imageOut[offset] = Cin;
+                                continue;
+                            }
+                            imageOut[offset] = Cin * (med[l] / Lin);
+                        }
                     }
                 }
-                std::sort(window.begin(), window.end());
-                float  Lout = window[median_ndx];
-                RGB Cout = Cin * Lout / Lin;
-                imageOut[offset] = Cout;
-            }
+            }));
         }
+        for (std::thread &w : workers) w.join();
     }
 };
 
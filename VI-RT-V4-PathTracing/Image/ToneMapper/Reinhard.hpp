@@ -8,8 +8,53 @@
 #ifndef Reinhard_hpp
 #define Reinhard_hpp
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "RGB.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 class Reinhard  {
 
+    // n pixels, tone mapped, clamped to [0,1] and truncated to 8 bits (r,g,b)
+    static void quantize (const RGB *in, unsigned char *out, int const n) {
+        int i = 0;
+#if defined(__SSE2__)
+        // 4 pixels: 12 interleaved floats in 3 registers, each divided by its pixel's 1+Y
+        __m128 const zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), scale = _mm_set1_ps(255.f);
+        for ( ; i + 4 <= n ; i += 4) {
+            float d[4];
+            for (int k=0 ; k<4 ; k++) d[k] = (float)(1. + in[i+k].Y());
+            const float *f = &in[i].R;
+            __m128 c0 = _mm_div_ps(_mm_loadu_ps(f), _mm_set_ps(d[1], d[0], d[0], d[0]));
+            __m128 c1 = _mm_div_ps(_mm_loadu_ps(f+4), _mm_set_ps(d[2], d[2], d[1], d[1]));
+            __m128 c2 = _mm_div_ps(_mm_loadu_ps(f+8), _mm_set_ps(d[3], d[3], d[3], d[2]));
+            // min first: NaN becomes 1, as fmin
+            c0 = _mm_mul_ps(_mm_max_ps(_mm_min_ps(c0, one), zero), scale);
+            c1 = _mm_mul_ps(_mm_max_ps(_mm_min_ps(c1, one), zero), scale);
+            c2 = _mm_mul_ps(_mm_max_ps(_mm_min_ps(c2, one), zero), scale);
+            __m128i const i2 = _mm_cvttps_epi32(c2);
+            __m128i const b = _mm_packus_epi16(_mm_packs_epi32(_mm_cvttps_epi32(c0), _mm_cvttps_epi32(c1)), _mm_packs_epi32(i2, i2));
+            _mm_storel_epi64((__m128i *)(out + 3*i), b);
+            int const last = _mm_cvtsi128_si32(_mm_srli_si128(b, 8));
+            memcpy(out + 3*i + 8, &last, 4);
+        }
+#endif
+        for ( ; i<n ; i++) {
+            RGB Cin = in[i];
+            float Lin = Cin.Y();
+            RGB const Cout = Cin / (1. + Lin);
+            out[3*i]   = (unsigned char)(fmax(fmin(1.f, Cout.R),0.f) * 255);
+            out[3*i+1] = (unsigned char)(fmax(fmin(1.f, Cout.G),0.f) * 255);
+            out[3*i+2] = (unsigned char)(fmax(fmin(1.f, Cout.B),0.f) * 255);
+        }
+    }
+
 public:
     Reinhard () {}
     void ToneMap (int const W, int const H, RGB *imageIn, RGB *imageOut) {
@@ -24,6 +69,21 @@ public:
             }
         }
     }
+    // ToneMap, clamp and conversion to bytes in one pass, straight into out
+    // (3 bytes per pixel) ; the rows are split among threads
+    void ToneMapQuantize (int const W, int const H, RGB *imageIn, unsigned char *out) {
+        int const n_threads = std::max(1u, std::thread::hardware_concurrency());
+        if (n_threads == 1) {
+            quantize(imageIn, out, W*H);
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (int t=0 ; t<n_threads ; t++) {
+            int const y0 = H * t / n_threads, y1 = H * (t+1) / n_threads;
+            workers.push_back(std::thread(quantize, imageIn + y0*W, out + 3*y0*W, (y1-y0)*W));
+        }
+        for (std::thread &w : workers) w.join();
+    }
 };
 
 #endif /* Reinhard_hpp */
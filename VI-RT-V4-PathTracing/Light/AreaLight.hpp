@@ -10,23 +10,66 @@
 
 #include "light.hpp"
 #include "triangle.hpp"
+#include "intersection.hpp"
 #include <math.h>
+#include <algorithm>
+
+// solid angle sampling falls back to area sampling outside this range (sr):
+// for tiny (small or distant) lights area sampling is as good and the spherical
+// triangle formulas lose precision ; near 2*PI the triangle is almost a hemisphere
+#define SOLID_ANGLE_MIN 3e-4f
+#define SOLID_ANGLE_MAX 6.22f
+
+// angle between 2 unit vectors, accurate for small angles (spherical triangles and rectangles)
+static inline float angleBetween (const Vector &v1, const Vector &v2) {
+    if (v1.dot(v2) < 0.f) {
+        Vector s = v1 + v2;
+        return M_PI - 2.f * asinf(std::min(1.f, s.norm() / 2.f));
+    }
+    Vector d = v2 - v1;
+    return 2.f * asinf(std::min(1.f, d.norm() / 2.f));
+}
 
 class AreaLight: public Light {
+    // v - (v.w) w, normalized (w must be normalized)
+    static Vector orthogonalTo (const Vector &v, const Vector &w) {
+        Vector o = v - w * v.dot(w);
+        o.normalize();
+        return o;
+    }
+    // spherical triangle subtended by the light at p: unit vectors a, b, c towards
+    // the vertices, its angles and area (Girard's theorem) ; returns false if it is
+    // degenerate or its area is out of [SOLID_ANGLE_MIN, SOLID_ANGLE_MAX]
+    bool sphericalTriangle (Point p, Vector &a, Vector &b, Vector &c, float &alpha, float &beta, float &gamma, float &solidAngle) const {
+        a = p.vec2point(gem->v1); b = p.vec2point(gem->v2); c = p.vec2point(gem->v3);
+        a.normalize(); b.normalize(); c.normalize();
+        // normals of the great circles through each pair of vertices
+        Vector n_ab = a.cross(b), n_bc = b.cross(c), n_ca = c.cross(a);
+        if (n_ab.normSQ() <= 0.f || n_bc.normSQ() <= 0.f || n_ca.normSQ() <= 0.f) return false;
+        n_ab.normalize(); n_bc.normalize(); n_ca.normalize();
+        alpha = angleBetween(n_ab, -1.f * n_ca);
+        beta = angleBetween(n_bc, -1.f * n_ab);
+        gamma = angleBetween(n_ca, -1.f * n_bc);
+        solidAngle = alpha + beta + gamma - M_PI;
+        return (solidAngle >= SOLID_ANGLE_MIN && solidAngle <= SOLID_ANGLE_MAX);
+    }
 public:
     RGB intensity, power;
     Triangle *gem;
     float pdf;
-    AreaLight (RGB _power, Point _v1, Point _v2, Point _v3, Vector _n): power(_power) {
+    // sample the spherical triangle subtended by the light at the shading point
+    // (see Sample_L (r, p, Lpos, pdf_w)) instead of the triangle area
+    bool solidAngleSampling;
+    AreaLight (RGB _power, Point _v1, Point _v2, Point _v3, Vector _n, bool _solidAngleSampling=false): power(_power), solidAngleSampling(_solidAngleSampling) {
         type = AREA_LIGHT;
         gem = new Triangle (_v1, _v2, _v3, _n);
         pdf = 1.f/gem->area();  // for uniform sampling over the area
         intensity = _power * pdf;
     }
     ~AreaLight () {delete gem;}
-    // return the Light RGB radiance for a given point : p
-    RGB L (Point p) {return power;}
-    RGB L () {return power;}
+    // return the Light RGB radiance for a given point : p (power / area)
+    RGB L (Point p) {return intensity;}
+    RGB L () {return intensity;}
     // return a point p and RGB radiance for a given probability pair r[2]
     // the pdf should be taken as 1/Area
     RGB Sample_L (float *r, Point *p) {
@@ -46,6 +89,72 @@ public:
         _pdf = pdf;
         return intensity;
     }
+    // return a point Lpos on the light as seen from p, RGB radiance and the pdf
+    // with respect to the solid angle at p, given a pair of random numbers in [0..[
+    // With solidAngleSampling the direction is sampled uniformly within the spherical
+    // triangle subtended by the light (Arvo, "Stratified sampling of spherical
+    // triangles", SIGGRAPH 1995, as in pbrt-v4 sec 6.5.4), so pdf_w = 1 / solid angle.
+    // Otherwise, or if the solid angle is out of [SOLID_ANGLE_MIN, SOLID_ANGLE_MAX],
+    // the area is sampled and its pdf converted to solid angle.
+    // pdf_w = 0 if p does not see the emitting side of the light
+    RGB Sample_L (float *r, Point p, Point *Lpos, float &pdf_w) {
+        Vector const toV1 = p.vec2point(gem->v1);
+        pdf_w = 0.f;
+        // the light emits towards its normal only
+        if (toV1.dot(gem->normal) >= 0.f) return intensity;
+
+        Vector a, b, c;
+        float alpha, beta, gamma, solidAngle;
+        if (solidAngleSampling && sphericalTriangle(p, a, b, c, alpha, beta, gamma, solidAngle)) {
+            // sub triangle with area r[0] * solidAngle: find its vertex c' on arc ac
+            float const Ap_pi = M_PI + r[0] * solidAngle;
+            float const cosAlpha = cosf(alpha), sinAlpha = sinf(alpha);
+            float const sinPhi = sinf(Ap_pi) * cosAlpha - cosf(Ap_pi) * sinAlpha;
+            float const cosPhi = cosf(Ap_pi) * cosAlpha + sinf(Ap_pi) * sinAlpha;
+            float const k1 = cosPhi + cosAlpha;
+            float const k2 = sinPhi - sinAlpha * a.dot(b);
+            float cosBp = (k2 + (k2 * cosPhi - k1 * sinPhi) * cosAlpha) / ((k2 * sinPhi + k1 * cosPhi) * sinAlpha);
+            cosBp = std::max(-1.f, std::min(1.f, cosBp));
+            float const sinBp = sqrtf(std::max(0.f, 1.f - cosBp * cosBp));
+            Vector const cp = a * cosBp + orthogonalTo(c, a) * sinBp;
+            // direction on arc b c' with the right density
+            float const cosTheta = 1.f - r[1] * (1.f - cp.dot(b));
+            float const sinTheta = sqrtf(std::max(0.f, 1.f - cosTheta * cosTheta));
+            Vector const w = b * cosTheta + orthogonalTo(cp, b) * sinTheta;
+            // intersect the sampled direction with the light plane
+            float const cosW = w.dot(gem->normal);
+            if (cosW < 0.f) {
+                *Lpos = p + w * (toV1.dot(gem->normal) / cosW);
+                pdf_w = 1.f / solidAngle;
+                return intensity;
+            }
+        }
+
+        // area sampling: pdf_w = (1/Area) * dist^2 / cos(light)
+        Sample_L (r, Lpos);
+        Vector Ldir = p.vec2point(*Lpos);
+        float const dist2 = Ldir.normSQ();
+        Ldir.normalize();
+        float const cosL = -1.f * Ldir.dot(gem->normal);
+        if (cosL > 1.e-4 && dist2 > 0.f) pdf_w = pdf * dist2 / cosL;
+        return intensity;
+    }
+    // pdf_w of Sample_L (r, p, Lpos, pdf_w) for Lpos = isect.p
+    float Pdf_L (Point p, Intersection &isect) {
+        // the light emits towards its normal only
+        if (p.vec2point(gem->v1).dot(gem->normal) >= 0.f) return 0.f;
+        Vector a, b, c;
+        float alpha, beta, gamma, solidAngle;
+        Vector Ldir = p.vec2point(isect.p);
+        float const dist2 = Ldir.normSQ();
+        Ldir.normalize();
+        // the same fallback as Sample_L: directions that do not reach the plane of the light are area sampled
+        if (solidAngleSampling && sphericalTriangle(p, a, b, c, alpha, beta, gamma, solidAngle) && Ldir.dot(gem->normal) < 0.f) {
+            return 1.f / solidAngle;
+        }
+        float const cosL = -1.f * Ldir.dot(gem->normal);
+        return (cosL > 1.e-4 && dist2 > 0.f ? pdf * dist2 / cosL : 0.f);
+    }
 };
 
 #endif /* AreaLight_hpp */
@@ -0,0 +1,118 @@
+//
+//  EnvironmentLight.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Infinitely distant light given by a latitude-longitude (equirectangular)
+//  image, loaded with ImagePPM (8 bit P6, or PF float maps for HDR).
+//  Row 0 is up (+Y) ; columns sweep phi in [0, 2 PI[ from +X towards +Z.
+//  Directions are importance sampled proportionally to luminance x sin(theta)
+//  with a marginal alias table over the rows and a conditional one per row:
+//  sampling and pdf evaluation are O(1).
+//
+
+#ifndef EnvironmentLight_hpp
+#define EnvironmentLight_hpp
+
+#include "light.hpp"
+#include "ImagePPM.hpp"
+#include "intersection.hpp"
+#include "AliasTable.hpp"
+#include <vector>
+#include <string>
+#include <math.h>
+#include <algorithm>
+
+class EnvironmentLight: public Light {
+    ImagePPM image;
+    AliasTable marginal;                // rows
+    std::vector<AliasTable> conditional;  // columns within each row
+    float avgLum;                       // average radiance luminance (over the sphere)
+public:
+    float scale;        // multiplies the image values
+    float distance;     // distance of the sampled points ; must be larger than the scene
+    // loads the image ; check W and H (0 if it failed)
+    EnvironmentLight (std::string filename, const float _scale=1.f, const float _distance=1.e6f): avgLum(0.f), scale(_scale), distance(_distance) {
+        type = ENVIRONMENT_LIGHT;
+        if (!image.Load(filename)) {
+            image.W = image.H = 0;
+            return;
+        }
+        int const W = image.W, H = image.H;
+        std::vector<float> rows(H), row(W);
+        conditional.resize(H);
+        double total = 0.;
+        for (int y=0 ; y<H ; y++) {
+            float const sin_theta = sinf(M_PI * (y + 0.5f) / H);
+            double rowsum = 0.;
+            for (int x=0 ; x<W ; x++) {
+                row[x] = image.get(x, y).Y() * scale;
+                rowsum += row[x];
+            }
+            conditional[y].build(row);
+            rows[y] = (float)(rowsum * sin_theta);
+            total += rows[y];
+        }
+        marginal.build(rows);
+        // integral of the luminance over the sphere / 4 PI
+        avgLum = (float)(total * (2. * M_PI / W) * (M_PI / H) / (4. * M_PI));
+    }
+    int W (void) const { return image.W; }
+    int H (void) const { return image.H; }
+    // radiance arriving from direction dir (pointing away from the scene)
+    RGB Le (Vector dir) {
+        if (image.W == 0) return RGB();
+        dir.normalize();
+        float const theta = acosf(std::max(-1.f, std::min(1.f, dir.Y)));
+        float phi = atan2f(dir.Z, dir.X);
+        if (phi < 0.f) phi += 2.f * M_PI;
+        int x = (int)(phi / (2.f * M_PI) * image.W), y = (int)(theta / M_PI * image.H);
+        if (x >= image.W) x = image.W - 1;
+        if (y >= image.H) y = image.H - 1;
+        return image.get(x, y) * scale;
+    }
+    // pdf (solid angle) of sampling direction dir
+    float pdf (Vector dir) {
+        if (image.W == 0) return 0.f;
+        dir.normalize();
+        float const theta = acosf(std::max(-1.f, std::min(1.f, dir.Y)));
+        float phi = atan2f(dir.Z, dir.X);
+        if (phi < 0.f) phi += 2.f * M_PI;
+        int x = (int)(phi / (2.f * M_PI) * image.W), y = (int)(theta / M_PI * image.H);
+        if (x >= image.W) x = image.W - 1;
+        if (y >= image.H) y = image.H - 1;
+        float const sin_theta = sinf(theta);
+        if (sin_theta <= 0.f) return 0.f;
+        return marginal.pmf(y) * conditional[y].pmf(x) * image.W * image.H / (2.f * M_PI * M_PI * sin_theta);
+    }
+    // power of the light is not defined: average radiance luminance instead
+    float AverageLuminance (void) const { return avgLum; }
+    RGB L (Point p) {return RGB(avgLum, avgLum, avgLum);}
+    RGB L () {return RGB(avgLum, avgLum, avgLum);}
+    // return a point Lpos far away (distance) in a sampled direction as seen from p,
+    // RGB radiance and the pdf with respect to the solid angle at p,
+    // given a pair of random numbers in [0..[
+    // (same contract as AreaLight::Sample_L (r, p, Lpos, pdf_w))
+    RGB Sample_L (float *r, Point p, Point *Lpos, float &pdf_w) {
+        pdf_w = 0.f;
+        if (image.W == 0) return RGB();
+        float pm, pc, u, v;
+        int const y = marginal.sample(r[0], pm, &v);
+        int const x = conditional[y].sample(r[1], pc, &u);
+        // uniform within the pixel in (phi, theta)
+        float const theta = M_PI * (y + v) / image.H;
+        float const phi = 2.f * M_PI * (x + u) / image.W;
+        float const sin_theta = sinf(theta);
+        if (sin_theta <= 0.f) return RGB();
+        Vector const dir (sin_theta * cosf(phi), cosf(theta), sin_theta * sinf(phi));
+        *Lpos = p + dir * distance;
+        pdf_w = pm * pc * image.W * image.H / (2.f * M_PI * M_PI * sin_theta);
+        return image.get(x, y) * scale;
+    }
+    // pdf_w of Sample_L (r, p, Lpos, pdf_w) for the direction of a ray that left
+    // the scene: isect as set by Scene::trace on a miss (wo points back along the ray)
+    float Pdf_L (Point p, Intersection &isect) {
+        return pdf(-1.f * isect.wo);
+    }
+};
+
+#endif /* EnvironmentLight_hpp */
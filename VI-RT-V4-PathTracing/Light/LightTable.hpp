@@ -0,0 +1,199 @@
+//
+//  LightTable.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Structure of arrays mirror of the scene lights used by the light
+//  selection strategies. Centroid, normal, area and luminance are computed
+//  once (Scene::SetLights) and the importance of all lights at a shading
+//  point is evaluated with SIMD: 8 lights per instruction with AVX
+//  (make AVX=1, that adds -mavx), 4 with SSE2 (default on x86-64), scalar elsewhere.
+//  Arrays are padded with zero luminance lights to a multiple of 8.
+//
+
+#ifndef LightTable_hpp
+#define LightTable_hpp
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "vector.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+typedef __m256 vfloat;
+#define V_WIDTH 8
+#define v_load(p) _mm256_loadu_ps(p)
+#define v_store(p, a) _mm256_storeu_ps(p, a)
+#define v_set1(f) _mm256_set1_ps(f)
+#define v_add(a, b) _mm256_add_ps(a, b)
+#define v_sub(a, b) _mm256_sub_ps(a, b)
+#define v_mul(a, b) _mm256_mul_ps(a, b)
+#define v_div(a, b) _mm256_div_ps(a, b)
+#define v_max(a, b) _mm256_max_ps(a, b)
+#define v_sqrt(a) _mm256_sqrt_ps(a)
+#define v_and(a, b) _mm256_and_ps(a, b)
+#define v_cmpge(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+#define v_cmpgt(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128 vfloat;
+#define V_WIDTH 4
+#define v_load(p) _mm_loadu_ps(p)
+#define v_store(p, a) _mm_storeu_ps(p, a)
+#define v_set1(f) _mm_set1_ps(f)
+#define v_add(a, b) _mm_add_ps(a, b)
+#define v_sub(a, b) _mm_sub_ps(a, b)
+#define v_mul(a, b) _mm_mul_ps(a, b)
+#define v_div(a, b) _mm_div_ps(a, b)
+#define v_max(a, b) _mm_max_ps(a, b)
+#define v_sqrt(a) _mm_sqrt_ps(a)
+#define v_and(a, b) _mm_and_ps(a, b)
+#define v_cmpge(a, b) _mm_cmpge_ps(a, b)
+#define v_cmpgt(a, b) _mm_cmpgt_ps(a, b)
+#endif
+
+#define LIGHT_TABLE_PAD 8
+
+class LightTable {
+public:
+    int numLights;      // number of scene lights
+    int size;           // numLights rounded up to LIGHT_TABLE_PAD
+    // light position (area lights: centroid)
+    std::vector<float> cx, cy, cz;
+    // area lights normal ; (0,0,0) for point lights
+    std::vector<float> nx, ny, nz;
+    // added to the emitter cosine: 1 for point lights, 0 for area lights
+    std::vector<float> cosOffset;
+    // area ; 1 for point lights
+    std::vector<float> area;
+    // luminance of the emitted intensity ; 0 for ambient lights and padding
+    std::vector<float> lum;
+    // 1 for lights with a position (point and area), 0 otherwise
+    std::vector<float> positional;
+    // IMPORTANCE_ONE weight of the lights without a position (environment: the irradiance
+    // it gives an unoccluded surface) ; 0 for the others
+    std::vector<float> constant;
+    // the lights with a constant weight
+    std::vector<int> infinite;
+
+    LightTable (): numLights(0), size(0) {}
+
+    void resize (const int N) {
+        numLights = N;
+        size = ((N + LIGHT_TABLE_PAD - 1) / LIGHT_TABLE_PAD) * LIGHT_TABLE_PAD;
+        cx.assign(size, 0.f); cy.assign(size, 0.f); cz.assign(size, 0.f);
+        nx.assign(size, 0.f); ny.assign(size, 0.f); nz.assign(size, 0.f);
+        cosOffset.assign(size, 0.f);
+        area.assign(size, 0.f);
+        lum.assign(size, 0.f);
+        positional.assign(size, 0.f);
+        constant.assign(size, 0.f);
+        infinite.clear();
+    }
+
+    // lum * cos(surface) * cos(light) * area / dist^2 (the IMPORTANCE_ONE weights)
+    // with distance=false the division by dist^2 is omitted (IMPORTANCE_ONE_NO_DISTANCE)
+    void importance (const Point &p, const Vector &n, float *w, const bool distance=true) const {
+        constexpr float EPS = 1e-6f;
+        int i = 0;
+#ifdef V_WIDTH
+        vfloat const px = v_set1(p.X), py = v_set1(p.Y), pz = v_set1(p.Z);
+        vfloat const snx = v_set1(n.X), sny = v_set1(n.Y), snz = v_set1(n.Z);
+        vfloat const zero = v_set1(0.f), one = v_set1(1.f), eps = v_set1(EPS), tiny = v_set1(1e-30f);
+        for ( ; i < size ; i += V_WIDTH) {
+            vfloat const Lx = v_sub(v_load(&cx[i]), px);
+            vfloat const Ly = v_sub(v_load(&cy[i]), py);
+            vfloat const Lz = v_sub(v_load(&cz[i]), pz);
+            vfloat const dist2 = v_add(v_add(v_mul(Lx, Lx), v_mul(Ly, Ly)), v_mul(Lz, Lz));
+            vfloat const valid = (distance ? v_cmpge(dist2, eps) : v_cmpgt(dist2, zero));
+            vfloat const inv_d = v_div(one, v_sqrt(v_max(dist2, tiny)));
+            vfloat const dotS = v_add(v_add(v_mul(Lx, snx), v_mul(Ly, sny)), v_mul(Lz, snz));
+            vfloat const dotL = v_add(v_add(v_mul(Lx, v_load(&nx[i])), v_mul(Ly, v_load(&ny[i]))), v_mul(Lz, v_load(&nz[i])));
+            vfloat const cosS = v_max(zero, v_mul(dotS, inv_d));
+            vfloat const cosL = v_max(zero, v_sub(v_load(&cosOffset[i]), v_mul(dotL, inv_d)));
+            vfloat wi = v_mul(v_mul(v_load(&lum[i]), v_load(&area[i])), v_mul(cosS, cosL));
+            if (distance) wi = v_mul(wi, v_mul(inv_d, inv_d));
+            v_store(&w[i], v_add(v_and(wi, valid), v_load(&constant[i])));
+        }
+#endif
+        for ( ; i < size ; i++) {
+            Vector L (cx[i]-p.X, cy[i]-p.Y, cz[i]-p.Z);
+            float const dist2 = L.normSQ();
+            if ((distance && dist2 < EPS) || dist2 <= 0.f) { w[i] = constant[i]; continue; }
+            float const inv_d = 1.f / std::sqrt(dist2);
+            float const cosS = std::max(0.f, L.dot(n) * inv_d);
+            float const cosL = std::max(0.f, cosOffset[i] - (L.X*nx[i] + L.Y*ny[i] + L.Z*nz[i]) * inv_d);
+            w[i] = lum[i] * area[i] * cosS * cosL;
+            if (distance) w[i] *= inv_d * inv_d;
+            w[i] += constant[i];
+        }
+    }
+
+    // 1/dist (the DISTANCE_ONE weights) ; squared=true gives 1/dist^2 (DISTANCE_SQUARED_ONE)
+    // the lights without a position have no distance: each gets the mean weight of the
+    // others, as likely as an average light (1 if there are no others)
+    void inverseDistance (const Point &p, float *w, const bool squared=false) const {
+        int i = 0;
+#ifdef V_WIDTH
+        vfloat const px = v_set1(p.X), py = v_set1(p.Y), pz = v_set1(p.Z);
+        vfloat const one = v_set1(1.f);
+        for ( ; i < size ; i += V_WIDTH) {
+            vfloat const Lx = v_sub(v_load(&cx[i]), px);
+            vfloat const Ly = v_sub(v_load(&cy[i]), py);
+            vfloat const Lz = v_sub(v_load(&cz[i]), pz);
+            vfloat const dist2 = v_add(v_add(v_mul(Lx, Lx), v_mul(Ly, Ly)), v_mul(Lz, Lz));
+            vfloat const wi = (squared ? v_div(one, dist2) : v_div(one, v_sqrt(dist2)));
+            v_store(&w[i], v_and(wi, v_cmpgt(v_load(&positional[i]), v_set1(0.f))));
+        }
+#endif
+        for ( ; i < size ; i++) {
+            Vector L (cx[i]-p.X, cy[i]-p.Y, cz[i]-p.Z);
+            float const dist2 = L.normSQ();
+            w[i] = (positional[i] > 0.f ? (squared ? 1.f / dist2 : 1.f / std::sqrt(dist2)) : 0.f);
+        }
+        if (infinite.empty()) return;
+        float sum = 0.f;
+        int n = 0;
+        for (int l = 0 ; l < numLights ; l++) {
+            if (positional[l] > 0.f) { sum += w[l]; n++; }
+        }
+        for (int l : infinite) w[l] = (n > 0 ? sum / n : 1.f);
+    }
+
+    // importance of a single light l (same value as importance() for that light)
+    float importance1 (const int l, const Point &p, const Vector &n, const bool distance=true) const {
+        constexpr float EPS = 1e-6f;
+        Vector L (cx[l]-p.X, cy[l]-p.Y, cz[l]-p.Z);
+        float const dist2 = L.normSQ();
+        if ((distance && dist2 < EPS) || dist2 <= 0.f) return constant[l];
+        float const inv_d = 1.f / std::sqrt(dist2);
+        float const cosS = std::max(0.f, L.dot(n) * inv_d);
+        float const cosL = std::max(0.f, cosOffset[l] - (L.X*nx[l] + L.Y*ny[l] + L.Z*nz[l]) * inv_d);
+        float const w = lum[l] * area[l] * cosS * cosL;
+        return (distance ? w * inv_d * inv_d : w) + constant[l];
+    }
+
+    // inclusive prefix sum of w[0..size[ into cdf ; returns the total
+    static float prefixSum (const float *w, float *cdf, const int size) {
+        int i = 0;
+        float carry = 0.f;
+#ifdef V_WIDTH
+        // in register scan of 4 lanes: x += x<<1 lane ; x += x<<2 lanes
+        for ( ; i + 4 <= size ; i += 4) {
+            __m128 x = _mm_loadu_ps(&w[i]);
+            x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+            x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+            x = _mm_add_ps(x, _mm_set1_ps(carry));
+            _mm_storeu_ps(&cdf[i], x);
+            carry = cdf[i+3];
+        }
+#endif
+        for ( ; i < size ; i++) {
+            carry += w[i];
+            cdf[i] = carry;
+        }
+        return carry;
+    }
+};
+
+#endif /* LightTable_hpp */
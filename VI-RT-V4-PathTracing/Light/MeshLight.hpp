@@ -0,0 +1,119 @@
+//
+//  MeshLight.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Emissive triangle mesh seen by the light selection strategies as a single
+//  light. A triangle is selected in O(1) with an alias table weighted by its
+//  power (area x luminance of its radiance) and a point is then sampled
+//  uniformly over that triangle.
+//
+
+#ifndef MeshLight_hpp
+#define MeshLight_hpp
+
+#include "light.hpp"
+#include "triangle.hpp"
+#include "BB.hpp"
+#include "AliasTable.hpp"
+#include <vector>
+#include <math.h>
+
+class MeshLight: public Light {
+    AliasTable table;
+    BB bb;      // of all triangles: rays that miss it skip the mesh
+public:
+    std::vector<Triangle *> tris;   // emit towards their normal (right hand rule on the vertices)
+    std::vector<RGB> radiance;      // per triangle
+    RGB power;                      // total power
+    float area;                     // total area
+    Point centroid;                 // area weighted
+    // vertices and 3 indices (into vertices) per triangle
+    // radiance has one RGB per triangle, or a single RGB for the whole mesh
+    MeshLight (const std::vector<Point> &vertices, const std::vector<int> &indices, const std::vector<RGB> &_radiance): area(0.f) {
+        type = MESH_LIGHT;
+        int const N = (int)indices.size() / 3;
+        std::vector<float> weights(N);
+        float cx=0.f, cy=0.f, cz=0.f;
+        for (int t=0 ; t<N ; t++) {
+            Point const &v1 = vertices[indices[3*t]], &v2 = vertices[indices[3*t+1]], &v3 = vertices[indices[3*t+2]];
+            Triangle *tri = new Triangle(v1, v2, v3);
+            tri->BackFaceCulling = false;
+            tris.push_back(tri);
+            RGB Le = (_radiance.size() == 1 ? _radiance[0] : _radiance[t]);
+            radiance.push_back(Le);
+            float const A = tri->area();
+            power += Le * A;
+            area += A;
+            weights[t] = A * Le.Y();
+            cx += A * (v1.X + v2.X + v3.X) / 3.f;
+            cy += A * (v1.Y + v2.Y + v3.Y) / 3.f;
+            cz += A * (v1.Z + v2.Z + v3.Z) / 3.f;
+        }
+        if (area > 0.f) centroid.set(cx / area, cy / area, cz / area);
+        table.build(weights);
+        if (!tris.empty()) {
+            bb = tris[0]->bb;
+            for (Triangle *tri : tris) {
+                bb.update(tri->bb.min);
+                bb.update(tri->bb.max);
+            }
+        }
+    }
+    ~MeshLight () {
+        for (Triangle *tri : tris) delete tri;
+    }
+    // return the Light RGB radiance: the mean over the mesh (power / area)
+    RGB L (Point p) {return L();}
+    RGB L () {return (area > 0.f ? power / area : RGB());}
+    // closest intersection of r with the mesh ; Le is the radiance of the hit triangle
+    // (zero on its back side) and isect->FaceID its index in tris
+    bool intersect (Ray r, Intersection *isect, RGB &Le) {
+        Intersection curr;
+        bool hit = false;
+        if (tris.empty() || !bb.intersect(r)) return false;
+        for (size_t t=0 ; t<tris.size() ; t++) {
+            if (tris[t]->intersect(r, &curr) && (!hit || curr.depth < isect->depth)) {
+                *isect = curr;
+                isect->FaceID = (int)t;
+                Le = (r.dir.dot(tris[t]->normal) < 0.f ? radiance[t] : RGB());
+                hit = true;
+            }
+        }
+        return hit;
+    }
+    // return a point Lpos on the light as seen from p, RGB radiance and the pdf
+    // with respect to the solid angle at p, given a pair of random numbers in [0..[
+    // (same contract as AreaLight::Sample_L (r, p, Lpos, pdf_w))
+    // r[0] selects the triangle and is then reused to sample the point on it
+    RGB Sample_L (float *r, Point p, Point *Lpos, float &pdf_w) {
+        pdf_w = 0.f;
+        if (tris.empty()) return RGB();
+        float pmf, r0;
+        int const t = table.sample(r[0], pmf, &r0);
+        Triangle *tri = tris[t];
+        // uniform point over the triangle, as in AreaLight
+        const float sqrt_r0 = sqrtf(r0);
+        const float alpha = 1.f - sqrt_r0;
+        const float beta = (1.f-r[1]) * sqrt_r0;
+        const float gamma = r[1] * sqrt_r0;
+        *Lpos = tri->v1 * alpha + tri->v2 * beta + tri->v3 * gamma;
+        Vector Ldir = p.vec2point(*Lpos);
+        float const dist2 = Ldir.normSQ();
+        Ldir.normalize();
+        float const cosL = -1.f * Ldir.dot(tri->normal);
+        if (cosL > 1.e-4 && dist2 > 0.f) pdf_w = pmf / tri->area() * dist2 / cosL;
+        return radiance[t];
+    }
+    // pdf_w of Sample_L (r, p, Lpos, pdf_w) for Lpos = isect.p (isect given by intersect)
+    float Pdf_L (Point p, Intersection &isect) {
+        int const t = isect.FaceID;
+        if (t < 0 || t >= (int)tris.size()) return 0.f;
+        Vector Ldir = p.vec2point(isect.p);
+        float const dist2 = Ldir.normSQ();
+        Ldir.normalize();
+        float const cosL = -1.f * Ldir.dot(tris[t]->normal);
+        return (cosL > 1.e-4 && dist2 > 0.f ? table.pmf(t) / tris[t]->area() * dist2 / cosL : 0.f);
+    }
+};
+
+#endif /* MeshLight_hpp */
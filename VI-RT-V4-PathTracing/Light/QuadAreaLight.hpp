@@ -0,0 +1,146 @@
+//
+//  QuadAreaLight.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Area light over a parallelogram (Quad): one light where AreaLight needs 2.
+//  Points are sampled uniformly over the area or, for rectangles with
+//  solidAngleSampling, uniformly within the spherical rectangle subtended at
+//  the shading point (Urena et al., "An area-preserving parametrization for
+//  spherical rectangles", EGSR 2013, as in pbrt-v4 sec 6.5.4).
+//
+
+#ifndef QuadAreaLight_hpp
+#define QuadAreaLight_hpp
+
+#include "light.hpp"
+#include "AreaLight.hpp"
+#include "Quad.hpp"
+#include "intersection.hpp"
+#include <math.h>
+#include <algorithm>
+
+class QuadAreaLight: public Light {
+    static Vector normalized (Vector v) {
+        v.normalize();
+        return v;
+    }
+    bool rectangle;     // edges are orthogonal (required by the spherical rectangle sampling)
+    // spherical rectangle subtended by the light at a shading point, in a local frame
+    // with x, y along the edges and z against the light normal (away from the point)
+    typedef struct SphericalRectangle {
+        Vector ex, ey, ez;
+        float x0, y0, z0, x1, y1;
+        float b0, b1;               // z of the normals of the planes through the x edges
+        float g0, g1, g2, g3;       // internal angles
+        float solidAngle;
+    } SphericalRectangle;
+    // toV1: vector from the shading point to v1 ; returns false if the solid
+    // angle is out of [SOLID_ANGLE_MIN, SOLID_ANGLE_MAX]
+    bool sphericalRectangle (const Vector &toV1, SphericalRectangle &sr) const {
+        float const exl = gem->edge1.norm(), eyl = gem->edge2.norm();
+        sr.ex = gem->edge1 / exl;
+        sr.ey = gem->edge2 / eyl;
+        sr.ez = sr.ex.cross(sr.ey);
+        sr.z0 = toV1.dot(sr.ez);
+        if (sr.z0 > 0.f) { sr.ez = -1.f * sr.ez; sr.z0 = -sr.z0; }
+        sr.x0 = toV1.dot(sr.ex); sr.y0 = toV1.dot(sr.ey);
+        sr.x1 = sr.x0 + exl; sr.y1 = sr.y0 + eyl;
+        // normals of the planes through the shading point and each edge
+        Vector const v00(sr.x0, sr.y0, sr.z0), v01(sr.x0, sr.y1, sr.z0), v10(sr.x1, sr.y0, sr.z0), v11(sr.x1, sr.y1, sr.z0);
+        Vector const n0 = normalized(v00.cross(v10)), n1 = normalized(v10.cross(v11));
+        Vector const n2 = normalized(v11.cross(v01)), n3 = normalized(v01.cross(v00));
+        sr.b0 = n0.Z; sr.b1 = n2.Z;
+        sr.g0 = angleBetween(-1.f * n0, n1); sr.g1 = angleBetween(-1.f * n1, n2);
+        sr.g2 = angleBetween(-1.f * n2, n3); sr.g3 = angleBetween(-1.f * n3, n0);
+        sr.solidAngle = sr.g0 + sr.g1 + sr.g2 + sr.g3 - 2.f * M_PI;
+        return (sr.solidAngle >= SOLID_ANGLE_MIN && sr.solidAngle <= SOLID_ANGLE_MAX);
+    }
+public:
+    RGB intensity, power;
+    Quad *gem;
+    float pdf;
+    // sample the spherical rectangle subtended by the light at the shading point
+    // (see Sample_L (r, p, Lpos, pdf_w)) instead of the quad area
+    bool solidAngleSampling;
+    // v1, v2, v3, v4 in order along the perimeter ; must be a parallelogram
+    QuadAreaLight (RGB _power, Point _v1, Point _v2, Point _v3, Point _v4, Vector _n, bool _solidAngleSampling=false): power(_power), solidAngleSampling(_solidAngleSampling) {
+        type = QUAD_AREA_LIGHT;
+        gem = new Quad (_v1, _v2, _v3, _v4, _n);
+        pdf = 1.f/gem->area();  // for uniform sampling over the area
+        intensity = _power * pdf;
+        rectangle = (fabsf(gem->edge1.dot(gem->edge2)) <= 1.e-4f * gem->area());
+    }
+    ~QuadAreaLight () {delete gem;}
+    // return the Light RGB radiance for a given point : p (power / area)
+    RGB L (Point p) {return intensity;}
+    RGB L () {return intensity;}
+    // return a point p and RGB radiance for a given probability pair r[2]
+    // the pdf should be taken as 1/Area
+    RGB Sample_L (float *r, Point *p) {
+        *p = gem->point(r[0], r[1]);
+        return intensity;
+    }
+    // return a point p, RGB radiance and pdf given a pair of random number in [0..[
+    RGB Sample_L (float *r, Point *p, float& _pdf) {
+        _pdf = pdf;
+        return Sample_L (r, p);
+    }
+    // return a point Lpos on the light as seen from p, RGB radiance and the pdf
+    // with respect to the solid angle at p, given a pair of random numbers in [0..[
+    // Same contract as AreaLight::Sample_L (r, p, Lpos, pdf_w): solid angle sampling
+    // is used for rectangles with solidAngleSampling and a solid angle within
+    // [SOLID_ANGLE_MIN, SOLID_ANGLE_MAX], area sampling otherwise.
+    // pdf_w = 0 if p does not see the emitting side of the light
+    RGB Sample_L (float *r, Point p, Point *Lpos, float &pdf_w) {
+        Vector const toV1 = p.vec2point(gem->v1);
+        pdf_w = 0.f;
+        // the light emits towards its normal only
+        if (toV1.dot(gem->normal) >= 0.f) return intensity;
+
+        SphericalRectangle sr;
+        if (solidAngleSampling && rectangle && sphericalRectangle(toV1, sr)) {
+            // xu: sub rectangle [x0, xu] with solid angle r[0] * solidAngle
+            float const au = r[0] * (sr.g0 + sr.g1 - 2.f * M_PI) + (r[0] - 1.f) * (sr.g2 + sr.g3);
+            float const fu = (cosf(au) * sr.b0 - sr.b1) / sinf(au);
+            float cu = copysignf(1.f / sqrtf(fu * fu + sr.b0 * sr.b0), fu);
+            cu = std::max(-0.99999994f, std::min(0.99999994f, cu));
+            float xu = -(cu * sr.z0) / sqrtf(std::max(0.f, 1.f - cu * cu));
+            xu = std::max(sr.x0, std::min(sr.x1, xu));
+            // yv along the y edge at xu
+            float const dd = sqrtf(xu * xu + sr.z0 * sr.z0);
+            float const h0 = sr.y0 / sqrtf(dd * dd + sr.y0 * sr.y0);
+            float const h1 = sr.y1 / sqrtf(dd * dd + sr.y1 * sr.y1);
+            float const hv = h0 + r[1] * (h1 - h0), hvsq = hv * hv;
+            float const yv = (hvsq < 1.f - 1.e-6f) ? (hv * dd) / sqrtf(1.f - hvsq) : sr.y1;
+            *Lpos = p + sr.ex * xu + sr.ey * yv + sr.ez * sr.z0;
+            pdf_w = 1.f / sr.solidAngle;
+            return intensity;
+        }
+
+        // area sampling: pdf_w = (1/Area) * dist^2 / cos(light)
+        Sample_L (r, Lpos);
+        Vector Ldir = p.vec2point(*Lpos);
+        float const dist2 = Ldir.normSQ();
+        Ldir.normalize();
+        float const cosL = -1.f * Ldir.dot(gem->normal);
+        if (cosL > 1.e-4 && dist2 > 0.f) pdf_w = pdf * dist2 / cosL;
+        return intensity;
+    }
+    // pdf_w of Sample_L (r, p, Lpos, pdf_w) for Lpos = isect.p
+    float Pdf_L (Point p, Intersection &isect) {
+        Vector const toV1 = p.vec2point(gem->v1);
+        // the light emits towards its normal only
+        if (toV1.dot(gem->normal) >= 0.f) return 0.f;
+        SphericalRectangle sr;
+        if (solidAngleSampling && rectangle && sphericalRectangle(toV1, sr)) {
+            return 1.f / sr.solidAngle;
+        }
+        Vector Ldir = p.vec2point(isect.p);
+        float const dist2 = Ldir.normSQ();
+        Ldir.normalize();
+        float const cosL = -1.f * Ldir.dot(gem->normal);
+        return (cosL > 1.e-4 && dist2 > 0.f ? pdf * dist2 / cosL : 0.f);
+    }
+};
+
+#endif /* QuadAreaLight_hpp */
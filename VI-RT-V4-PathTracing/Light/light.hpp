@@ -11,18 +11,23 @@
 #include "vector.hpp"
 #include "RGB.hpp"
 
+struct Intersection;
+
 enum LightType {
     NO_LIGHT,
     AMBIENT_LIGHT,
     POINT_LIGHT,
-    AREA_LIGHT
+    AREA_LIGHT,
+    QUAD_AREA_LIGHT,
+    MESH_LIGHT,
+    ENVIRONMENT_LIGHT
 } ;
 
 class Light {
 public:
     LightType type;
     Light () {type=NO_LIGHT;}
-    ~Light () {}
+    virtual ~Light () {}
     // return the Light RGB radiance for a given point : p
     virtual RGB  L (Point p)  {return RGB();}
     // return the Light RGB radiance
@@ -32,6 +37,10 @@ public:
     virtual RGB   Sample_L (float *prob, Point *p, float &pdf)  {return RGB();}
     // return the probability of p
     virtual float  pdf(Point p)  {return 0.;}
+    // return the pdf (solid angle at p) with which Sample_L (r, p, Lpos, pdf_w)
+    // returns the point isect.p, where isect is the intersection of a ray
+    // leaving p with this light (as given by Scene::trace) ; 0 for delta lights
+    virtual float  Pdf_L(Point p, Intersection &isect)  {return 0.;}
 
 };
 
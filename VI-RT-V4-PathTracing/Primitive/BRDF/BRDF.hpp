@@ -10,29 +10,39 @@
 
 #include "vector.hpp"
 #include "RGB.hpp"
+#include <math.h>
 
 typedef enum {
     SPECULAR_REF=1,
     DIFFUSE_REF=2,
     SPECULAR_TRANS=4,
     GLOSSY_REF=8,
-    BRDF_ALL= SPECULAR_REF | DIFFUSE_REF | SPECULAR_TRANS | GLOSSY_REF
+    GLOSSY_TRANS=16,
+    BRDF_ALL= SPECULAR_REF | DIFFUSE_REF | SPECULAR_TRANS | GLOSSY_REF | GLOSSY_TRANS
 } BRDF_TYPES;
 
 class BRDF {
 public:
     bool textured;
+    bool glossy;    // microfacet material (GGX): Ks and Kt are rough lobes sampled with Sample_f
     float eta;
     RGB Ka, Kd, Ks, Kt;
 
-    BRDF () {textured=false;}
+    BRDF () {textured=false; glossy=false;}
     ~BRDF () {}
     // return the BRDF RGB value for a pair of (incident, scattering) directions : (wi,wo)
     virtual RGB f (Vector wi, Vector wo, const BRDF_TYPES = BRDF_ALL) {return RGB();}
     // return an outgoing direction wo and brdf RGB value for a given wi and probability pair prob[2]
     virtual RGB Sample_f (Vector wi, float *prob, Vector *wo, const BRDF_TYPES = BRDF_ALL) {return RGB();}
+    // same, also returning the pdf of wo
+    virtual RGB Sample_f (Vector wi, float *prob, Vector *wo, float &pdf, const BRDF_TYPES = BRDF_ALL) {pdf=0.; return RGB();}
     // return the probability of sampling wo given wi
-    virtual float pdf(Vector wi, Vector wo, const BRDF_TYPES = BRDF_ALL) {return 0.;}
+    // directions are in the shading frame (normal along Z) ; the diffuse component
+    // is cosine sampled, the specular ones are Dirac deltas (pdf 0 for any given wo)
+    virtual float pdf(Vector wi, Vector wo, const BRDF_TYPES type = BRDF_ALL) {
+        if (!(type & DIFFUSE_REF) || Kd.isZero() || wo.Z <= 0.f) return 0.;
+        return wo.Z / M_PI;
+    }
 };
 
 #endif /* BRDF_hpp */
@@ -10,26 +10,41 @@
 
 #include "BRDF.hpp"
 #include "ImagePPM.hpp"
+#include "MipTexture.hpp"
 #include "Triangle.hpp"
+#include "intersection.hpp"
+#include <algorithm>
+#include <cmath>
+
+// lowest |cos| between the ray and the surface in the footprint (it grows as 1/|cos|)
+#define TEXTURE_MIN_COS 0.05f
+
+// footprint in texture space of the ray cone at a hit (0 for rays without a cone)
+inline float ConeFootprint (const Intersection &isect) {
+    float const cos_o = std::max(fabsf(isect.sn.dot(isect.wo)), TEXTURE_MIN_COS);
+    return isect.cone_width * isect.uv_scale / cos_o;
+}
 
 class DiffuseTexture: public BRDF {
 private:
-    ImagePPM texture;
-    float tex_W, tex_H;
+    MipTexture texture;
 public:
     DiffuseTexture(std::string filename) {
-        texture.Load(filename);
+        // the pyramid keeps its own 8 bit copy: the image (and its file) go at the end of the scope
+        ImagePPM image;
+        image.LoadTexture(filename);
+        texture.Build(image);
         textured=true;
-        tex_W = float (texture.W);
-        tex_H = float (texture.H);
     }
-    RGB GetKd (Vec2 TexCoord) {
-        int x = (int)floor(TexCoord.u * tex_W);
-        int y = (int)floor(TexCoord.v * tex_H);
-
-        RGB color = Kd*texture.get(x, y);
+    // uv_width: footprint of the lookup in texture space (0: the full resolution)
+    RGB GetKd (Vec2 TexCoord, float const uv_width=0.f) {
+        RGB color = Kd*texture.Lookup(TexCoord.u, TexCoord.v, texture.LOD(uv_width));
         return color;
     }
+    // at a ray hit: the ray cone projected on the surface gives the footprint
+    RGB GetKd (const Intersection &isect) {
+        return GetKd(isect.TexCoord, ConeFootprint(isect));
+    }
 };
 
 
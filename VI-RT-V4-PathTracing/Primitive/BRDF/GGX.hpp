@@ -0,0 +1,194 @@
+//
+//  GGX.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Rough conductor (Kt zero) or rough dielectric (Kt non zero, index eta)
+//  with the isotropic GGX (Trowbridge-Reitz) microfacet distribution
+//  (Walter et al., "Microfacet models for refraction through rough
+//  surfaces", EGSR 2007). Sample_f samples the distribution of the normals
+//  visible from wi (Heitz, "Sampling the GGX distribution of visible
+//  normals", JCGT 2018, as in pbrt-v4 sec 9.6), so f*cos/pdf is G/G1 times
+//  the Fresnel term.
+//  Ks tints the reflection (and is the Schlick F0 of conductors), Kt tints
+//  the transmission. Kd adds a diffuse lobe, sampled as in BRDF.
+//  All directions are in the shading frame (normal along Z) and both wi
+//  and wo point away from the surface.
+//
+
+#ifndef GGX_hpp
+#define GGX_hpp
+
+#include "BRDF.hpp"
+#include <math.h>
+#include <algorithm>
+
+// below this alpha the surface is too smooth for the microfacet formulas
+#define GGX_MIN_ALPHA 1.e-3f
+
+class GGX: public BRDF {
+    float alpha;
+    // microfacet normal distribution
+    float D (const Vector &wm) const {
+        float const cos2 = wm.Z * wm.Z;
+        if (cos2 <= 0.f) return 0.f;
+        float const tan2 = (1.f - cos2) / cos2;
+        float const e = 1.f + tan2 / (alpha * alpha);
+        return 1.f / (M_PI * alpha * alpha * cos2 * cos2 * e * e);
+    }
+    // Smith masking: G1 = 1 / (1 + Lambda)
+    float Lambda (const Vector &w) const {
+        float const cos2 = w.Z * w.Z;
+        if (cos2 <= 0.f) return 0.f;
+        float const tan2 = (1.f - cos2) / cos2;
+        return (sqrtf(1.f + alpha * alpha * tan2) - 1.f) / 2.f;
+    }
+    float G1 (const Vector &w) const { return 1.f / (1.f + Lambda(w)); }
+    float G (const Vector &wi, const Vector &wo) const { return 1.f / (1.f + Lambda(wi) + Lambda(wo)); }
+    // distribution of the normals visible from w
+    float Dvisible (const Vector &w, const Vector &wm) const {
+        if (w.Z == 0.f) return 0.f;
+        return G1(w) / fabsf(w.Z) * D(wm) * fabsf(w.dot(wm));
+    }
+    // sample a visible normal from w (w.Z > 0) given u[2]
+    Vector SampleVisibleNormal (const Vector &w, const float *u) const {
+        // stretch to the hemisphere configuration
+        Vector wh (alpha * w.X, alpha * w.Y, w.Z);
+        wh.normalize();
+        Vector T1 = (wh.Z < 0.99999f ? Vector(0.f, 0.f, 1.f).cross(wh) : Vector(1.f, 0.f, 0.f));
+        T1.normalize();
+        Vector const T2 = wh.cross(T1);
+        // uniform point on the disk, warped to the projected hemisphere
+        float const r = sqrtf(u[0]), phi = 2.f * M_PI * u[1];
+        float const px = r * cosf(phi);
+        float py = r * sinf(phi);
+        float const h = sqrtf(std::max(0.f, 1.f - px * px));
+        float const t = (1.f + wh.Z) / 2.f;
+        py = (1.f - t) * h + t * py;
+        float const pz = sqrtf(std::max(0.f, 1.f - px * px - py * py));
+        Vector const nh = px * T1 + py * T2 + pz * wh;
+        // unstretch
+        Vector wm (alpha * nh.X, alpha * nh.Y, std::max(1.e-6f, nh.Z));
+        wm.normalize();
+        return wm;
+    }
+    // Fresnel reflectance of a dielectric ; cos_i < 0 if arriving from inside
+    static float FrDielectric (float cos_i, float eta) {
+        cos_i = std::max(-1.f, std::min(1.f, cos_i));
+        if (cos_i < 0.f) { eta = 1.f / eta; cos_i = -cos_i; }
+        float const sin2_t = (1.f - cos_i * cos_i) / (eta * eta);
+        if (sin2_t >= 1.f) return 1.f;
+        float const cos_t = sqrtf(1.f - sin2_t);
+        float const r_parl = (eta * cos_i - cos_t) / (eta * cos_i + cos_t);
+        float const r_perp = (cos_i - eta * cos_t) / (cos_i + eta * cos_t);
+        return (r_parl * r_parl + r_perp * r_perp) / 2.f;
+    }
+    // Schlick approximation for conductors, with F0 = Ks
+    RGB FrSchlick (const float cos_i) const {
+        float const m = 1.f - std::max(0.f, std::min(1.f, cos_i));
+        float const m5 = m * m * m * m * m;
+        return RGB(Ks.R + (1.f - Ks.R) * m5, Ks.G + (1.f - Ks.G) * m5, Ks.B + (1.f - Ks.B) * m5);
+    }
+    bool dielectric (void) const { return !Kt.isZero(); }
+    // half vector of (wi, wo), facing +Z, and the relative index etap (1 for reflection)
+    // returns false for degenerate configurations and backfacing microfacets
+    bool HalfVector (const Vector &wi, const Vector &wo, Vector &wm, float &etap) const {
+        bool const reflect = (wi.Z * wo.Z > 0.f);
+        etap = 1.f;
+        if (!reflect) etap = (wi.Z > 0.f ? eta : 1.f / eta);
+        wm = wo * etap + wi;
+        if (wi.Z == 0.f || wo.Z == 0.f || wm.normSQ() == 0.f) return false;
+        wm.normalize();
+        if (wm.Z < 0.f) wm = -1.f * wm;
+        return (wm.dot(wi) * wi.Z >= 0.f && wm.dot(wo) * wo.Z >= 0.f);
+    }
+public:
+    // roughness in [0,1] ; alpha = roughness^2
+    GGX (const float roughness) {
+        alpha = std::max(GGX_MIN_ALPHA, roughness * roughness);
+        glossy = true;
+    }
+    // width of the distribution (about the angular spread of the lobe)
+    float Alpha (void) const { return alpha; }
+    // glossy lobes only: the diffuse one is evaluated by the shaders with Kd
+    RGB f (Vector wi, Vector wo, const BRDF_TYPES type = BRDF_ALL) {
+        Vector wm;
+        float etap;
+        if (!HalfVector(wi, wo, wm, etap)) return RGB();
+        if (!dielectric()) {
+            if (!(type & GLOSSY_REF) || wi.Z <= 0.f || wo.Z <= 0.f) return RGB();
+            return FrSchlick(wi.dot(wm)) * (D(wm) * G(wi, wo) / (4.f * wi.Z * wo.Z));
+        }
+        float const F = FrDielectric(wi.dot(wm), eta);
+        if (wi.Z * wo.Z > 0.f) {
+            if (!(type & GLOSSY_REF)) return RGB();
+            return Ks * (F * D(wm) * G(wi, wo) / fabsf(4.f * wi.Z * wo.Z));
+        }
+        if (!(type & GLOSSY_TRANS)) return RGB();
+        float const denom = (wo.dot(wm) + wi.dot(wm) / etap) * (wo.dot(wm) + wi.dot(wm) / etap) * wi.Z * wo.Z;
+        // radiance is scaled by 1/etap^2 across the interface
+        return Kt * ((1.f - F) * D(wm) * G(wi, wo) * fabsf(wo.dot(wm) * wi.dot(wm) / denom) / (etap * etap));
+    }
+    // pdf of the glossy lobes (restricted to type) or, if type has no glossy bit, of the diffuse one
+    float pdf (Vector wi, Vector wo, const BRDF_TYPES type = BRDF_ALL) {
+        if (!(type & (GLOSSY_REF | GLOSSY_TRANS))) return BRDF::pdf(wi, wo, type);
+        Vector wm;
+        float etap;
+        if (!HalfVector(wi, wo, wm, etap)) return 0.f;
+        if (!dielectric()) {
+            if (wi.Z <= 0.f || wo.Z <= 0.f) return 0.f;
+            return Dvisible(wi, wm) / (4.f * fabsf(wi.dot(wm)));
+        }
+        float const R = FrDielectric(wi.dot(wm), eta), T = 1.f - R;
+        Vector const wv = (wi.Z > 0.f ? wi : -1.f * wi);
+        if (wi.Z * wo.Z > 0.f) {
+            if (!(type & GLOSSY_REF)) return 0.f;
+            return Dvisible(wv, wm) / (4.f * fabsf(wi.dot(wm))) * R;
+        }
+        if (!(type & GLOSSY_TRANS)) return 0.f;
+        float const denom = (wo.dot(wm) + wi.dot(wm) / etap) * (wo.dot(wm) + wi.dot(wm) / etap);
+        return Dvisible(wv, wm) * fabsf(wo.dot(wm)) / denom * T;
+    }
+    // sample wo given wi and prob[3] (prob[2] selects reflection or transmission
+    // in dielectrics) ; returns f (wi, wo) and its pdf (0 if no direction was sampled)
+    RGB Sample_f (Vector wi, float *prob, Vector *wo, float &_pdf, const BRDF_TYPES type = BRDF_ALL) {
+        _pdf = 0.f;
+        if (wi.Z == 0.f) return RGB();
+        if (!dielectric()) {
+            if (wi.Z < 0.f) return RGB();
+            Vector const wm = SampleVisibleNormal(wi, prob);
+            *wo = 2.f * wi.dot(wm) * wm - wi;
+            if (wo->Z <= 0.f) return RGB();
+            _pdf = Dvisible(wi, wm) / (4.f * fabsf(wi.dot(wm)));
+            return FrSchlick(wi.dot(wm)) * (D(wm) * G(wi, *wo) / (4.f * wi.Z * wo->Z));
+        }
+        // sample from the side of wi and flip the normal back
+        float const sign = (wi.Z > 0.f ? 1.f : -1.f);
+        Vector const wv = sign * wi;
+        Vector wm = SampleVisibleNormal(wv, prob);
+        float const R = FrDielectric(wi.dot(wm), eta), T = 1.f - R;
+        wm = sign * wm;     // now facing wi
+        if (prob[2] < R) {
+            *wo = 2.f * wi.dot(wm) * wm - wi;
+            if (wi.Z * wo->Z <= 0.f) return RGB();
+            _pdf = Dvisible(wv, sign * wm) / (4.f * fabsf(wi.dot(wm))) * R;
+            return Ks * (R * D(sign * wm) * G(wi, *wo) / fabsf(4.f * wi.Z * wo->Z));
+        }
+        // refraction through wm, from the side of wi
+        float const etap = (wi.Z > 0.f ? eta : 1.f / eta);
+        float const cos_i = wi.dot(wm);
+        float const sin2_t = std::max(0.f, 1.f - cos_i * cos_i) / (etap * etap);
+        if (sin2_t >= 1.f) return RGB();
+        float const cos_t = sqrtf(1.f - sin2_t);
+        *wo = -1.f * wi / etap + (cos_i / etap - cos_t) * wm;
+        if (wi.Z * wo->Z >= 0.f) return RGB();
+        float const denom = (wo->dot(wm) + wi.dot(wm) / etap) * (wo->dot(wm) + wi.dot(wm) / etap);
+        _pdf = Dvisible(wv, sign * wm) * fabsf(wo->dot(wm)) / denom * T;
+        return Kt * (T * D(sign * wm) * G(wi, *wo) * fabsf(wo->dot(wm) * wi.dot(wm) / (denom * wi.Z * wo->Z)) / (etap * etap));
+    }
+    RGB Sample_f (Vector wi, float *prob, Vector *wo, const BRDF_TYPES type = BRDF_ALL) {
+        float _pdf;
+        return Sample_f(wi, prob, wo, _pdf, type);
+    }
+};
+
+#endif /* GGX_hpp */
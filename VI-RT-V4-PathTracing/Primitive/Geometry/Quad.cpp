@@ -0,0 +1,58 @@
+//
+//  Quad.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "Quad.hpp"
+#include "BB.hpp"
+
+// ray / plane intersection followed by the parametric coordinates of the hit point:
+// q = alpha * edge1 + beta * edge2 ; the hit is inside if both are in [0,1]
+// (as in "Ray Tracing: The Next Week", sec 6)
+bool Quad::intersect(Ray r, Intersection *isect) {
+
+    if (!bb.intersect(r)) {
+        return false;
+    }
+
+    const float par = normal.dot(r.dir);
+    if ((BackFaceCulling && par > -EPSILON) || (!BackFaceCulling && std::abs(par) < EPSILON)) {
+        return false;    // This ray is parallel to this quad (or hits its back face)
+    }
+
+    float const t = normal.dot(r.o.vec2point(v1)) / par;
+    if (t <= EPSILON) {
+        return false;
+    }
+
+    Point pHit = r.o + t * r.dir;
+    Vector const q = v1.vec2point(pHit);
+    float const alpha = w.dot(q.cross(edge2));
+    if (alpha < 0.f || alpha > 1.f) {
+        return false;
+    }
+    float const beta = w.dot(edge1.cross(q));
+    if (beta < 0.f || beta > 1.f) {
+        return false;
+    }
+
+    Vector wo = -1. * r.dir;
+    // make sure the normal points to the same side of the surface as wo
+    Vector const for_normal = normal.Faceforward(wo);
+    isect->p = pHit;
+    isect->gn = for_normal;
+    isect->sn = for_normal;
+    isect->wo = wo;
+    isect->depth = t;
+    isect->FaceID = -1;
+    isect->pix_x = r.pix_x;
+    isect->pix_y = r.pix_y;
+    isect->incident_eta = r.propagating_eta;
+
+    // bilinear interpolation of the vertices texture coordinates
+    float const a1 = (1.f-alpha)*(1.f-beta), a2 = alpha*(1.f-beta), a3 = alpha*beta, a4 = (1.f-alpha)*beta;
+    isect->TexCoord.u = a1 * uv1.u + a2 * uv2.u + a3 * uv3.u + a4 * uv4.u;
+    isect->TexCoord.v = a1 * uv1.v + a2 * uv2.v + a3 * uv3.v + a4 * uv4.v;
+
+    return true;
+}
@@ -0,0 +1,77 @@
+//
+//  Quad.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Parallelogram with vertices v1, v2, v3, v4 (in order along the perimeter,
+//  v3 = v2 + v4 - v1). A single primitive replaces the 2 triangles used for
+//  walls and rectangular emitters.
+//
+
+#ifndef Quad_hpp
+#define Quad_hpp
+
+#include "geometry.hpp"
+#include "vector.hpp"
+#include <math.h>
+
+class Quad: public Geometry {
+    Vector w;           // normal / |edge1 x edge2| : maps hit points to (alpha, beta)
+    void setup (void) {
+        type = QUAD_GEOMETRY;
+        edge1 = v1.vec2point(v2);
+        edge2 = v1.vec2point(v4);
+        Vector const n = edge1.cross(edge2);
+        w = n / n.normSQ();
+        bb.min.set(v1.X, v1.Y, v1.Z);
+        bb.max.set(v1.X, v1.Y, v1.Z);
+        bb.update(v2);
+        bb.update(v3);
+        bb.update(v4);
+    }
+public:
+    bool BackFaceCulling;
+    Point v1, v2, v3, v4;
+    Vec2 uv1, uv2, uv3, uv4;  // texture coordinates for each vertex
+    Vector normal;           // geometric normal
+    Vector edge1, edge2;     // v1->v2 and v1->v4
+    bool intersect (Ray r, Intersection *isect);
+
+    Quad(Point _v1, Point _v2, Point _v3, Point _v4, Vector _normal, bool backface=true): v1(_v1), v2(_v2), v3(_v3), v4(_v4), normal(_normal) {
+        setup();
+        BackFaceCulling = backface;
+    }
+
+    Quad(Point _v1, Point _v2, Point _v3, Point _v4, bool backface=false): BackFaceCulling(backface), v1(_v1), v2(_v2), v3(_v3), v4(_v4) {
+        setup();
+        // compute the geometric normal as the cross product of the 2 edges
+        normal = edge1.cross(edge2);
+        normal.normalize();
+    }
+
+    void set_uv (Vec2 _uv1, Vec2 _uv2, Vec2 _uv3, Vec2 _uv4) {
+        uv1=_uv1;
+        uv2=_uv2;
+        uv3=_uv3;
+        uv4=_uv4;
+        // ratio of the areas in texture and world space (shoelace on the diagonals)
+        float const uv_area = fabsf((uv3.u-uv1.u)*(uv4.v-uv2.v) - (uv4.u-uv2.u)*(uv3.v-uv1.v)) / 2.f;
+        float const A = area();
+        uv_scale = (A > 0.f ? sqrtf(uv_area / A) : 0.f);
+    }
+    float area () {
+        return edge1.cross(edge2).norm();
+    }
+    // point at the parametric coordinates (alpha, beta) in [0,1]^2
+    Point point (const float alpha, const float beta) const {
+        return v1 + edge1 * alpha + edge2 * beta;
+    }
+    // true if v1, v2, v3, v4 (in order along the perimeter) form a planar parallelogram,
+    // within a tolerance relative to the quad size
+    static bool isParallelogram (Point v1, Point v2, Point v3, Point v4) {
+        Vector d = (v1 + v3).vec2point(v2 + v4);
+        float const size = v1.vec2point(v3).norm() + v2.vec2point(v4).norm();
+        return (d.norm() <= 1.e-5f * size);
+    }
+};
+
+#endif /* Quad_hpp */
@@ -27,6 +27,8 @@ bool Sphere::intersect(Ray r, Intersection *isect) {
     
     // intersection distance along ray
     float t = h - std::sqrt(discriminant);
+    // origin inside the sphere (refracted rays): the far intersection
+    if (t <= EPSILON) t = h + std::sqrt(discriminant);
     
     if (t > EPSILON) // ray intersection
     {
@@ -17,11 +17,10 @@ public:
     Point C;
     float radius;
     float radiusSq;
-    BB bb;      // sphere bounding box
-                // this is min={0.,0.,0.} , max={0.,0.,0.} due to the Point constructor
     bool intersect (Ray r, Intersection *isect);
     
     Sphere(Point _C, float _r): C(_C), radius(_r) {
+        type = SPHERE_GEOMETRY;
         radiusSq = radius * radius;
         bb.min.set(C.X-radius, C.Y-radius, C.Z-radius);
         bb.max.set(C.X+radius, C.Y+radius, C.Z+radius);
@@ -13,10 +13,20 @@
 #include "ray.hpp"
 #include "intersection.hpp"
 
+enum GeometryType {
+    NO_GEOMETRY,
+    SPHERE_GEOMETRY,
+    TRIANGLE_GEOMETRY,
+    QUAD_GEOMETRY
+} ;
+
 class Geometry {
 public:
-    Geometry () {}
-    ~Geometry () {}
+    GeometryType type;
+    // texture units per world unit (set with the texture coordinates)
+    float uv_scale;
+    Geometry () {type=NO_GEOMETRY; uv_scale=0.f;}
+    virtual ~Geometry () {}
     // return True if r intersects this geometric primitive
     // returns data about intersection on isect
     virtual bool intersect (Ray r, Intersection *isect) {
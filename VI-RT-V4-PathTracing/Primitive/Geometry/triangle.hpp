@@ -21,12 +21,11 @@ public:
     Vec2 uv1, uv2, uv3;  // texture coordinates for each vertex
     Vector normal;           // geometric normal
     Vector edge1, edge2, edge3;
-    BB bb;      // face bounding box
-                // this is min={0.,0.,0.} , max={0.,0.,0.} due to the Point constructor
     bool intersect (Ray r, Intersection *isect);
     bool isInside(Point p);
     
     Triangle(Point _v1, Point _v2, Point _v3, Vector _normal, bool backface=true): v1(_v1), v2(_v2), v3(_v3), normal(_normal) {
+        type = TRIANGLE_GEOMETRY;
         edge1 = v1.vec2point(v2);
         edge2 = v1.vec2point(v3);
         edge3 = v2.vec2point(v3);
@@ -38,6 +37,7 @@ public:
     }
     
     Triangle(Point _v1, Point _v2, Point _v3, bool backface=false): v1(_v1), v2(_v2), v3(_v3), BackFaceCulling(backface) {
+        type = TRIANGLE_GEOMETRY;
         edge1 = v1.vec2point(v2);
         edge2 = v1.vec2point(v3);
         edge3 = v2.vec2point(v3);
@@ -56,6 +56,10 @@ public:
         uv1=_uv1;
         uv2=_uv2;
         uv3=_uv3;
+        // ratio of the areas in texture and world space
+        float const uv_area = fabsf((uv2.u-uv1.u)*(uv3.v-uv1.v) - (uv3.u-uv1.u)*(uv2.v-uv1.v)) / 2.f;
+        float const A = area();
+        uv_scale = (A > 0.f ? sqrtf(uv_area / A) : 0.f);
     }
     // Heron's formula
     // https://www.mathopenref.com/heronsformula.html
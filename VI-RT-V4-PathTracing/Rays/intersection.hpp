@@ -23,10 +23,16 @@ public:
     BRDF *f;
     int pix_x, pix_y;
     int FaceID;  // ID of the intersected face 
+    int PrimID;  // index of the intersected primitive in the scene (-1 for light sources)
     bool isLight;  // for intersections with light sources
+    int LightID;   // index (in Scene::lights) of the intersected light source
     RGB Le;         // for intersections with light sources
     float incident_eta;
+    RGB throughput;   // of the path that reached this point (from the ray)
+    bool after_diffuse;   // from the ray
     Vec2 TexCoord;    
+    float cone_width, cone_spread;  // the ray cone at p (from the ray, see Scene::trace)
+    float uv_scale;   // texture units per world unit on the surface (0: no texture coordinates)
     
     Intersection() {}
     // from pbrt book, section 2.10, pag 116
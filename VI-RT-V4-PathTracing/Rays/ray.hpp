@@ -11,12 +11,18 @@
 #include "vector.hpp"
 #include "RGB.hpp"
 
+// spread (radians) of the ray cone after a diffuse bounce: texture lookups
+// further down the path are prefiltered over a wide footprint
+#define DIFFUSE_CONE_SPREAD 0.2f
+
 typedef enum {
     PRIMARY,
     SHADOW,
     SPEC_REFL,
     SPEC_TRANS,
-    DIFF_REFL
+    DIFF_REFL,
+    GLOSS_REFL,
+    GLOSS_TRANS
 } RayType;
 
 class Ray {
@@ -29,13 +35,16 @@ public:
     RGB throughput;
     int pix_x, pix_y;
     float propagating_eta;
-    Ray () {}
-    Ray (Point o, Vector d, RayType t, RGB _throughput): o(o),dir(d), rtype(t), throughput(_throughput) {
+    // the path left a diffuse surface and then had only specular bounces
+    bool after_diffuse;
+    // ray cone: width of the footprint at o and its spread angle (radians)
+    // both 0 for rays that do not start at the camera: no footprint
+    float cone_width, cone_spread;
+    Ray (): cone_width(0.f), cone_spread(0.f) {}
+    Ray (Point o, Vector d, RayType t, RGB _throughput): o(o),dir(d), rtype(t), throughput(_throughput), after_diffuse(false), cone_width(0.f), cone_spread(0.f) {
         //invertDir();
     }
-    Ray (Point o, Vector d, RayType t): o(o),dir(d), rtype(t) {
-        Ray (o, d, t, RGB(1.0, 1.0, 1.0));
-    }
+    Ray (Point o, Vector d, RayType t): o(o),dir(d), rtype(t), throughput(1.0, 1.0, 1.0), after_diffuse(false), cone_width(0.f), cone_spread(0.f) {}
     ~Ray() {}
 
     void invertDir (void) {
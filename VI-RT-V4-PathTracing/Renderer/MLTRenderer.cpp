@@ -0,0 +1,119 @@
+//
+//  MLTRenderer.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "MLTRenderer.hpp"
+#include "AliasTable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+RGB MLTRenderer::samplePath (PrimarySample &ps, const int W, const int H, float &fx, float &fy) {
+    PrimarySample::Active() = &ps;
+    fx = ps.Next() * W;
+    fy = ps.Next() * H;
+    int const x = std::min((int)fx, W-1), y = std::min((int)fy, H-1);
+    float jitterV[2] = {fx - x, fy - y};
+    Ray primary;
+    Intersection isect;
+    cam->GenerateRay(x, y, &primary, jitterV);
+    bool const intersected = scene->trace(primary, &isect);
+    RGB const L = shd->shade(intersected, isect, 0);
+    PrimarySample::Active() = NULL;
+    return L;
+}
+
+void MLTRenderer::Render () {
+    int W=0,H=0;  // resolution
+    cam->getResolution(&W, &H);
+    int const n_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // bootstrap: the luminance of independent samples (the first, large step,
+    // iteration of a PrimarySample seeded with the sample's index)
+    std::vector<float> weights(bootstrap);
+    std::vector<std::thread> workers;
+    for (int t=0 ; t<n_threads ; t++) {
+        workers.push_back(std::thread([&, t] () {
+            for (int i=t ; i<bootstrap ; i+=n_threads) {
+                PrimarySample ps(i, sigma, large_step_prob);
+                ps.StartIteration();
+                float fx, fy;
+                weights[i] = std::max(0.f, samplePath(ps, W, H, fx, fy).Y());
+            }
+        }));
+    }
+    for (std::thread &w : workers) w.join();
+    workers.clear();
+    double b = 0.;
+    for (float const w : weights) b += w;
+    b /= bootstrap;
+    if (b <= 0.) {
+        for (int y=0 ; y< H ; y++) {
+            for (int x=0 ; x< W ; x++) img->set(x,y, RGB(0.,0.,0.));
+        }
+        return;
+    }
+    AliasTable const start(weights);
+
+    // the chains ; each thread splats onto its own image
+    long long const mutations = (long long)spp * W * H;
+    std::vector<std::vector<RGB> > accum(n_threads, std::vector<RGB>(W * H, RGB(0.,0.,0.)));
+    std::atomic<int> next_chain(0);
+    for (int t=0 ; t<n_threads ; t++) {
+        workers.push_back(std::thread([&, t] () {
+            std::vector<RGB> &acc = accum[t];
+            int c;
+            while ((c = next_chain.fetch_add(1)) < chains) {
+                if (t == 0) {
+                    fprintf (stderr,"%d\r",c);
+                    fflush (stderr);
+                }
+                std::mt19937 rng(bootstrap + c);
+                std::uniform_real_distribution<float>U_dist{0.0,1.0};
+                long long const n = mutations / chains + (c < mutations % chains ? 1 : 0);
+                // reproduce the chosen bootstrap sample
+                float pmf;
+                int const seed = start.sample(U_dist(rng), pmf);
+                PrimarySample ps(seed, sigma, large_step_prob);
+                ps.StartIteration();
+                float cx, cy;
+                RGB L = samplePath(ps, W, H, cx, cy);
+                float I = std::max(0.f, L.Y());
+                for (long long m=0 ; m<n ; m++) {
+                    ps.StartIteration();
+                    float px, py;
+                    RGB Lp = samplePath(ps, W, H, px, py);
+                    float const Ip = std::max(0.f, Lp.Y());
+                    float const accept = (I > 0.f ? std::min(1.f, Ip / I) : 1.f);
+                    // expected values: both samples contribute
+                    if (Ip > 0.f) {
+                        acc[std::min((int)py, H-1) * W + std::min((int)px, W-1)] += Lp * (accept / Ip);
+                    }
+                    if (accept < 1.f && I > 0.f) {
+                        acc[std::min((int)cy, H-1) * W + std::min((int)cx, W-1)] += L * ((1.f - accept) / I);
+                    }
+                    if (U_dist(rng) < accept) {
+                        ps.Accept();
+                        L = Lp; I = Ip; cx = px; cy = py;
+                    } else {
+                        ps.Reject();
+                    }
+                }
+            }
+        }));
+    }
+    for (std::thread &w : workers) w.join();
+
+    // each mutation carries b / (mutations / pixels) of the image
+    float const scale = (float)(b * W * H / mutations);
+    for (int y=0 ; y< H ; y++) {
+        for (int x=0 ; x< W ; x++) {
+            RGB color(0.,0.,0.);
+            for (int t=0 ; t<n_threads ; t++) color += accum[t][y*W+x];
+            img->set(x,y, color * scale);
+        }
+    }
+}
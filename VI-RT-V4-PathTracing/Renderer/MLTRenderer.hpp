@@ -0,0 +1,49 @@
+//
+//  MLTRenderer.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Primary sample space Metropolis light transport (Kelemen et al. 2002 ;
+//  pbrt book, sec 16.4) on top of any shader: the random numbers the camera
+//  and the shader draw through their RNG come from a PrimarySample, whose
+//  first two coordinates also choose the film position. Independent Markov
+//  chains, mutated with small and large steps, run on several threads ; each
+//  mutation splats both the current and the proposed path, weighted by the
+//  acceptance probability. A bootstrap pass of independent samples estimates
+//  the normalization (the average luminance) and picks the chains' first
+//  samples proportionally to their luminance.
+//  The shader must be a fixed function of the random numbers it reads: no
+//  learning (light cache, ReSTIR, guiding, radiance cache, adaptive roulette)
+//  and no splats.
+//
+
+#ifndef MLTRenderer_hpp
+#define MLTRenderer_hpp
+
+#include "renderer.hpp"
+#include "RNG.hpp"
+
+class MLTRenderer: public Renderer {
+private:
+    int spp;                // mutations per pixel (on average)
+    int chains;
+    int bootstrap;          // samples of the normalization pass
+    float sigma;            // small steps: standard deviation of the perturbations
+    float large_step_prob;
+    // radiance of the path given by the active PrimarySample ; (fx, fy) its film position
+    RGB samplePath (PrimarySample &ps, const int W, const int H, float &fx, float &fy);
+public:
+    MLTRenderer (Camera *cam, Scene * scene, Image * img, Shader *shd, int _spp, int _chains=256, int _bootstrap=100000): Renderer(cam, scene, img, shd) {
+        spp = _spp;
+        chains = (_chains > 0 ? _chains : 1);
+        bootstrap = (_bootstrap > chains ? _bootstrap : chains);
+        sigma = 0.01f;
+        large_step_prob = 0.3f;
+    }
+    void SetMutations (const float _sigma, const float _large_step_prob) {
+        sigma = _sigma;
+        large_step_prob = _large_step_prob;
+    }
+    void Render ();
+};
+
+#endif /* MLTRenderer_hpp */
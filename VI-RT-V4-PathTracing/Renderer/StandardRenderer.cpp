@@ -6,7 +6,11 @@
 //
 
 #include "StandardRenderer.hpp"
+#include <algorithm>
 #include <random>
+#include <vector>
+#include "LightAOV.hpp"
+#include "DiffuseTexture.hpp"
 
 void StandardRenderer::Render () {
     int W=0,H=0;  // resolution
@@ -24,43 +28,126 @@ void StandardRenderer::Render () {
     cam->getResolution(&W, &H);
     float const sppf = 1.f/spp;
 
-    // main rendering loop: get primary rays from the camera until done
-    for (y=0 ; y< H ; y++) {  // loop over rows
-        fprintf (stderr,"%d\r",y);
-        fflush (stderr);
-        for (x=0 ; x< W ; x++) { // loop over columns
-            RGB color(0.,0.,0.);
+    // radiance accumulated over the passes
+    std::vector<RGB> accum;
+    if (passes > 1) accum.assign(W * H, RGB(0.,0.,0.));
+
+    // radiance of each light in the current sample
+    std::vector<RGB> lights_sample(scene->numLights);
+    if (aov != NULL) LightAOV::Active() = &lights_sample;
+
+    // samples of each pixel that hit a surface (for the features)
+    std::vector<int> hits;
+    if (features != NULL) hits.assign(W * H, 0);
+
+    int done = 0, pass_spp = 1;
+    for (int pass=0 ; pass < passes && done < spp ; pass++) {
+        // the last pass also takes the samples that would not fill the next one
+        int const n = (pass == passes-1 || done + 3*pass_spp > spp ? spp - done : pass_spp);
+
+        // band of rows being rendered into the stream
+        RGB *band = NULL;
+        int band_y = 0;
+
+        // main rendering loop: get primary rays from the camera until done
+        for (y=0 ; y< H ; y++) {  // loop over rows
+            fprintf (stderr,"%d\r",y);
+            fflush (stderr);
+            if (stream != NULL && band == NULL) {
+                band = stream->Band();
+                band_y = y;
+            }
+            for (x=0 ; x< W ; x++) { // loop over columns
+                RGB color(0.,0.,0.);
             
-            for (s=0 ; s < spp; s++) {
-                Ray primary;
-                Intersection isect;
-                bool intersected;
-                // Generate Ray (camera)
-                float jitterV[2];
+                for (s=0 ; s < n; s++) {
+                    Ray primary;
+                    Intersection isect;
+                    bool intersected;
+                    // Generate Ray (camera)
+                    float jitterV[2];
                 
-                if (jitter) {
-                    jitterV[0] = U_dist(rng);
-                    jitterV[1] = U_dist(rng);
-                    cam->GenerateRay(x, y, &primary, jitterV);
-                } else {
-                    cam->GenerateRay(x, y, &primary);
-                }
+                    if (jitter) {
+                        jitterV[0] = U_dist(rng);
+                        jitterV[1] = U_dist(rng);
+                        cam->GenerateRay(x, y, &primary, jitterV);
+                    } else {
+                        cam->GenerateRay(x, y, &primary);
+                    }
                 
-                // trace ray (scene)
-                intersected = scene->trace(primary, &isect);
+                    // trace ray (scene)
+                    intersected = scene->trace(primary, &isect);
+                    if (features != NULL && intersected && !isect.isLight) {
+                        int const offset = y*W+x;
+                        BRDF *f = isect.f;
+                        RGB Kd = (f->textured ? ((DiffuseTexture *)f)->GetKd(isect) : f->Kd);
+                        features->albedo[offset] += Kd;
+                        // facing the camera: both sides of a surface look the same
+                        Vector n = isect.sn;
+                        if (n.dot(isect.wo) < 0.f) n = -1.f * n;
+                        features->normal[offset] = features->normal[offset] + n;
+                        features->depth[offset] += isect.depth;
+                        hits[offset]++;
+                    }
                 
-                // shade this intersection (shader) - remember: depth=0
-                color += shd->shade(intersected, isect, 0);
+                    // shade this intersection (shader) - remember: depth=0
+                    if (aov != NULL) std::fill(lights_sample.begin(), lights_sample.end(), RGB(0.,0.,0.));
+                    color += shd->shade(intersected, isect, 0);
+                    if (aov != NULL) {
+                        for (int l=0 ; l < scene->numLights ; l++) aov->plane(scene->lightGroup[l])[y*W+x] += lights_sample[l];
+                    }
                 
-                /*  DEBUGGING */
+                    /*  DEBUGGING */
                 
-                //if (x==100) color.set (0.,255.,0.);
-                //if (y==250) color.set (0.,255.,0.);
+                    //if (x==100) color.set (0.,255.,0.);
+                    //if (y==250) color.set (0.,255.,0.);
                 
 
-            } // multiple samples
-            // write the result into the image frame buffer (image)
-            img->set(x,y, color*sppf);
-        } // loop over columns
-    }   // loop over rows
+                } // multiple samples
+                // write the result into the image frame buffer (image)
+                if (passes > 1) accum[y*W+x] += color;
+                else if (band != NULL) band[(y-band_y)*W+x] = color*sppf;
+                else img->set(x,y, color*sppf);
+            } // loop over columns
+            // a full band (or the last rows) goes out while the next renders
+            if (band != NULL && (y-band_y+1 == stream->BandRows() || y == H-1)) {
+                stream->Commit(y-band_y+1);
+                band = NULL;
+            }
+        }   // loop over rows
+
+        done += n;
+        pass_spp *= 2;
+        shd->EndPass();
+    }   // loop over passes
+    if (passes > 1) {
+        for (y=0 ; y< H ; y++) {
+            for (x=0 ; x< W ; x++) img->set(x,y, accum[y*W+x]*sppf);
+        }
+    }
+    shd->AddSplats(img, sppf);
+    if (features != NULL) {
+        for (int i=0 ; i < W*H ; i++) {
+            if (hits[i] == 0) continue;
+            float const inv = 1.f / hits[i];
+            features->albedo[i] *= inv;
+            features->depth[i] *= inv;
+            if (features->normal[i].normSQ() > 0.f) features->normal[i].normalize();
+        }
+    }
+    if (aov != NULL) {
+        LightAOV::Active() = NULL;
+        // the rest of the image: whatever no light was credited with
+        for (y=0 ; y< H ; y++) {
+            for (x=0 ; x< W ; x++) {
+                RGB rest = img->get(x,y);
+                for (int g=0 ; g < aov->groups() ; g++) {
+                    RGB &p = aov->plane(g)[y*W+x];
+                    p *= sppf;
+                    rest = rest + p * -1.f;
+                }
+                aov->plane(-1)[y*W+x] = rest;
+            }
+        }
+    }
 }
@@ -9,19 +9,50 @@
 #define StandardRenderer_hpp
 
 #include "renderer.hpp"
+#include "ImageAOV.hpp"
+#include "ATrous.hpp"
+#include "ImageStream.hpp"
 
 class StandardRenderer: public Renderer {
 private:
     int spp;
     bool jitter;
+    int passes;     // progressive passes ; the shader learns between them (Shader::EndPass)
+    ImageAOV *aov;  // per light group AOVs (NULL: none)
+    FeatureBuffers *features;   // first hit albedo, normal and depth (NULL: none)
+    ImageStream *stream;        // rows go to the stream, not to img (NULL: img)
 public:
     StandardRenderer (Camera *cam, Scene * scene, Image * img, Shader *shd, int _spp): Renderer(cam, scene, img, shd) {
         spp = _spp;
         jitter = false;
+        passes = 1;
+        aov = NULL;
+        features = NULL;
+        stream = NULL;
     }
     StandardRenderer (Camera *cam, Scene * scene, Image * img, Shader *shd, int _spp, bool _jitter): Renderer(cam, scene, img, shd) {
         spp = _spp;
         jitter = _jitter;
+        passes = 1;
+        aov = NULL;
+        features = NULL;
+        stream = NULL;
+    }
+    // pass i takes 2^i samples per pixel, the last one all that is left of spp
+    void SetPasses (const int _passes) {
+        passes = (_passes > 1 ? _passes : 1);
+    }
+    // _aov has a group per scene->lightGroupNames ; the shader must record into LightAOV
+    void SetLightAOV (ImageAOV *_aov) {
+        aov = _aov;
+    }
+    // for the denoiser ; sized W x H
+    void SetFeatures (FeatureBuffers *_features) {
+        features = _features;
+    }
+    // open ; one pass, no AOVs, features or splats (img is not written)
+    void SetStream (ImageStream *_stream) {
+        stream = _stream;
     }
     void Render ();
 };
@@ -7,15 +7,21 @@
 
 #include "BuildScenes.hpp"
 #include "DiffuseTexture.hpp"
+#include "GGX.hpp"
 
 static int AddDiffuseMat (Scene& scene, RGB const color);
 static int AddMat (Scene& scene, RGB const Ka, RGB const Kd, RGB const Ks, RGB const Kt, float const eta=1.f);
 static int AddTextMat (Scene& scene, std::string filename, RGB const Ka, RGB const Kd, RGB const Ks, RGB const Kt, float const eta=1.f);
+// GGX microfacet material: rough conductor if Kt is zero, rough dielectric otherwise
+static int AddGGXMat (Scene& scene, float const roughness, RGB const Ks, RGB const Kt=RGB(0., 0., 0.), float const eta=1.f);
 static void AddSphere (Scene& scene, Point const C, float const radius,
                             int const mat_ndx);
 static void AddTriangle (Scene& scene,
                         Point const v1, Point const v2, Point const v3,
                         int const mat_ndx);
+static void AddQuad (Scene& scene,
+                     Point const v1, Point const v2, Point const v3, Point const v4,
+                     int const mat_ndx);
 
 
 static int AddDiffuseMat (Scene& scene, RGB const color) {
@@ -55,6 +61,18 @@ static int AddMat (Scene& scene, RGB const Ka, RGB const Kd, RGB const Ks, RGB c
     return (scene.AddMaterial(brdf));
 }
 
+static int AddGGXMat (Scene& scene, float const roughness, RGB const Ks, RGB const Kt, float const eta) {
+    GGX *brdf = new GGX(roughness);
+
+    brdf->Ka = RGB(0., 0., 0.);
+    brdf->Kd = RGB(0., 0., 0.);
+    brdf->Ks = Ks;
+    brdf->Kt = Kt;
+    brdf->eta = eta;
+
+    return (scene.AddMaterial(brdf));
+}
+
 static void AddSphere (Scene& scene, Point const C,
                              float const radius, int const mat_ndx) {
     Sphere *sphere = new Sphere(C, radius);
@@ -88,6 +106,57 @@ static void AddTriangleUV (Scene& scene,
     scene.AddPrimitive(prim);
 }
 
+// v1, v2, v3, v4 in order along the perimeter
+// a Quad if they form a parallelogram, else triangles (v1,v2,v3) and (v1,v3,v4)
+static void AddQuad (Scene& scene,
+                     Point const v1, Point const v2, Point const v3, Point const v4,
+                     int const mat_ndx) {
+    if (!Quad::isParallelogram(v1, v2, v3, v4)) {
+        AddTriangle(scene, v1, v2, v3, mat_ndx);
+        AddTriangle(scene, v1, v3, v4, mat_ndx);
+        return;
+    }
+    Quad *quad = new Quad(v1, v2, v3, v4);
+    Primitive *prim = new Primitive;
+    prim->g = quad;
+    prim->material_ndx = mat_ndx;
+    scene.AddPrimitive(prim);
+}
+
+static void AddQuadUV (Scene& scene,
+                       Point const v1, Point const v2, Point const v3, Point const v4,
+                       Vec2 const uv1, Vec2 const uv2, Vec2 const uv3, Vec2 const uv4,
+                       int const mat_ndx) {
+    if (!Quad::isParallelogram(v1, v2, v3, v4)) {
+        AddTriangleUV(scene, v1, v2, v3, uv1, uv2, uv3, mat_ndx);
+        AddTriangleUV(scene, v1, v3, v4, uv1, uv3, uv4, mat_ndx);
+        return;
+    }
+    Quad *quad = new Quad(v1, v2, v3, v4);
+    quad->set_uv(uv1, uv2, uv3, uv4);
+    Primitive *prim = new Primitive;
+    prim->g = quad;
+    prim->material_ndx = mat_ndx;
+    scene.AddPrimitive(prim);
+}
+
+// power is the total power of the quad
+// a QuadAreaLight if v1..v4 form a parallelogram, else 2 AreaLights
+static void AddQuadLight (Scene& scene, RGB power,
+                          Point const v1, Point const v2, Point const v3, Point const v4,
+                          Vector const n, bool const solidAngleSampling=false) {
+    if (Quad::isParallelogram(v1, v2, v3, v4)) {
+        scene.lights.push_back(new QuadAreaLight(power, v1, v2, v3, v4, n, solidAngleSampling));
+        scene.numLights++;
+        return;
+    }
+    Triangle t1 (v1, v2, v3, n), t2 (v1, v3, v4, n);
+    float const A1 = t1.area(), A2 = t2.area();
+    scene.lights.push_back(new AreaLight(power * (A1 / (A1 + A2)), v1, v2, v3, n, solidAngleSampling));
+    scene.lights.push_back(new AreaLight(power * (A2 / (A1 + A2)), v1, v3, v4, n, solidAngleSampling));
+    scene.numLights += 2;
+}
+
 
 // Scene with single triangle
 void SingleTriScene (Scene& scene){
@@ -152,66 +221,48 @@ void CornellBox (Scene& scene) {
     int const glass_mat = AddMat(scene, RGB (0., 0., 0.), RGB (0., 0., 0.), RGB (0.2, 0.2, 0.2), RGB (0.9, 0.9, 0.9), 1.2);
     //int const glass_mat = AddPhongMat(scene, RGB (0., 0., 0.), RGB (0., 0., 0.), RGB (0.2, 0.2, 0.2), RGB (0.9, 0.9, 0.9), 1, 0.9);
     // Floor
-    AddTriangle(scene, Point(552.8, 0.0, 0.0), Point(0.0, 0.0, 0.0), Point(0.0, 0.0, 559.2), white_mat);
-    AddTriangle(scene, Point(549.6, 0.0, 559.2), Point(552.8, 0.0, 0.0), Point(0.0, 0.0, 559.2), white_mat);
+    AddQuad(scene, Point(552.8, 0.0, 0.0), Point(0.0, 0.0, 0.0), Point(0.0, 0.0, 559.2), Point(549.6, 0.0, 559.2), white_mat);
     // Ceiling
-    AddTriangle(scene, Point(556.0, 548.8, 0.0), Point(0.0, 548.8, 0.0), Point(0.0, 548.8, 559.2), white_mat);
-    AddTriangle(scene, Point(556.0, 548.8, 559.2), Point(556.0, 548.8, 0.0), Point(0., 548.8, 559.2), white_mat);
+    AddQuad(scene, Point(556.0, 548.8, 0.0), Point(0.0, 548.8, 0.0), Point(0.0, 548.8, 559.2), Point(556.0, 548.8, 559.2), white_mat);
     // Back wall
-    AddTriangleUV (scene, Point(0.0, 0.0, 559.2), Point(549.6, 0.0, 559.2), Point(556.0, 548.8, 559.2), Vec2(1.,1.), Vec2(0.,1.), Vec2(0.,0.), text_backwall);
-    AddTriangleUV(scene, Point(0.0, 0.0, 559.2), Point(0.0, 548.8, 559.2), Point(556.0, 548.8, 559.2), Vec2(1.,1.), Vec2(1.,0.), Vec2(0.,0.), text_backwall);
+    AddQuadUV(scene, Point(0.0, 0.0, 559.2), Point(549.6, 0.0, 559.2), Point(556.0, 548.8, 559.2), Point(0.0, 548.8, 559.2), Vec2(1.,1.), Vec2(0.,1.), Vec2(0.,0.), Vec2(1.,0.), text_backwall);
     //AddTriangle(scene, Point(0.0, 0.0, 559.2), Point(549.6, 0.0, 559.2), Point(556.0, 548.8, 559.2), white_mat);
     //AddTriangle(scene, Point(0.0, 0.0, 559.2), Point(0.0, 548.8, 559.2), Point(556.0, 548.8, 559.2), white_mat);
     // Left Wall
-    AddTriangle(scene, Point(0.0, 0.0, 0.), Point(0., 0., 559.2), Point(0., 548.8, 559.2), green_mat);
-    AddTriangle(scene, Point(0.0, 0.0, 0.), Point(0., 548.8, 0.), Point(0., 548.8, 559.2), green_mat);
+    AddQuad(scene, Point(0.0, 0.0, 0.), Point(0., 0., 559.2), Point(0., 548.8, 559.2), Point(0., 548.8, 0.), green_mat);
     // Right Wall
-    AddTriangle(scene, Point(552.8, 0.0, 0.), Point(549.6, 0., 559.2), Point(549.6, 548.8, 559.2), red_mat);
-    AddTriangle(scene, Point(552.8, 0.0, 0.), Point(552.8, 548.8, 0.), Point(549.6, 548.8, 559.2), red_mat);
+    AddQuad(scene, Point(552.8, 0.0, 0.), Point(549.6, 0., 559.2), Point(549.6, 548.8, 559.2), Point(552.8, 548.8, 0.), red_mat);
     // Right Wall Mirror
-    AddTriangle(scene, Point(552, 50.0, 50.), Point(549, 50., 509.2), Point(549, 488.8, 509.2), mirror_mat);
-    AddTriangle(scene, Point(552, 50.0, 50.), Point(552, 488.8, 50.), Point(549, 488.8, 509.2), mirror_mat);
+    AddQuad(scene, Point(552, 50.0, 50.), Point(549, 50., 509.2), Point(549, 488.8, 509.2), Point(552, 488.8, 50.), mirror_mat);
     // short block
     // top
-    AddTriangleUV(scene, Point(130.0, 165.0,  65.0), Point( 82.0, 165.0, 225.0), Point(240.0, 165.0, 272.0), Vec2(0.,0.), Vec2(0.,1.), Vec2(1.,1.), uminho_text);
-    AddTriangleUV(scene, Point(130.0, 165.0,  65.0), Point( 290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), Vec2(0.,0.), Vec2(1.,0.), Vec2(1.,1.), uminho_text);
+    AddQuadUV(scene, Point(130.0, 165.0,  65.0), Point( 82.0, 165.0, 225.0), Point(240.0, 165.0, 272.0), Point( 290.0, 165.0, 114.0), Vec2(0.,0.), Vec2(0.,1.), Vec2(1.,1.), Vec2(1.,0.), uminho_text);
     //AddTriangle(scene, Point(130.0, 165.0,  65.0), Point( 82.0, 165.0, 225.0), Point(240.0, 165.0, 272.0), orange_mat);
     //AddTriangle(scene, Point(130.0, 165.0,  65.0), Point( 290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), orange_mat);
     // bottom
-    AddTriangle(scene, Point(130.0, 0.01,  65.0), Point( 82.0, 0.01, 225.0), Point(240.0, 0.01, 272.0), orange_mat);
-    AddTriangle(scene, Point(130.0, 0.01,  65.0), Point( 290.0, 0.01, 114.0), Point(240.0, 0.01, 272.0), orange_mat);
+    AddQuad(scene, Point(130.0, 0.01,  65.0), Point( 82.0, 0.01, 225.0), Point(240.0, 0.01, 272.0), Point( 290.0, 0.01, 114.0), orange_mat);
     // left
-    AddTriangle(scene, Point(290.0,   0.0, 114.0), Point(  290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), orange_mat);
-    AddTriangle(scene, Point(290.0,   0.0, 114.0), Point( 240.0,  0.0, 272.0), Point(240.0, 165.0, 272.0), orange_mat);
+    AddQuad(scene, Point(290.0,   0.0, 114.0), Point(  290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), Point( 240.0,  0.0, 272.0), orange_mat);
     // back
-    AddTriangle(scene, Point(240.0, 0.0, 272.0), Point(240.0, 165.0, 272.0), Point(82.0, 165., 225.0), orange_mat);
-    AddTriangle(scene, Point(240.0, 0.0, 272.0), Point(82.0, 0.0, 225.0), Point(82.0, 165.0, 225.0), orange_mat);
+    AddQuad(scene, Point(240.0, 0.0, 272.0), Point(240.0, 165.0, 272.0), Point(82.0, 165., 225.0), Point(82.0, 0.0, 225.0), orange_mat);
     // right
-    AddTriangle(scene, Point(82.0, 0.0, 225.0), Point(82.0, 165.0, 225.0), Point(130.0, 165.0, 65.0), orange_mat);
-    AddTriangle(scene, Point(82.0, 0.0, 225.0), Point(130.0, 0.0, 65.0), Point(130.0, 165.0, 65.0), orange_mat);
+    AddQuad(scene, Point(82.0, 0.0, 225.0), Point(82.0, 165.0, 225.0), Point(130.0, 165.0, 65.0), Point(130.0, 0.0, 65.0), orange_mat);
     // front
-    AddTriangle(scene, Point( 130.0,   0.0,  65.0), Point(130.0, 165.0, 65.0), Point(290.0, 165.0, 114.0), orange_mat);
-    AddTriangle(scene, Point( 130.0,   0.0,  65.0), Point(290.0, 0.0, 114.0), Point(290.0, 165.0, 114.0), orange_mat);
+    AddQuad(scene, Point( 130.0,   0.0,  65.0), Point(130.0, 165.0, 65.0), Point(290.0, 165.0, 114.0), Point(290.0, 0.0, 114.0), orange_mat);
 
     // tall block
     // top
-    AddTriangle(scene, Point(423.0, 330.0, 247.0), Point(265.0, 330.0, 296.0), Point(314.0, 330.0, 456.0), blue_mat);
-    AddTriangle(scene, Point(423.0, 330.0, 247.0), Point(472.0, 330.0, 406.0), Point(314.0, 330.0, 456.0), blue_mat);
+    AddQuad(scene, Point(423.0, 330.0, 247.0), Point(265.0, 330.0, 296.0), Point(314.0, 330.0, 456.0), Point(472.0, 330.0, 406.0), blue_mat);
     // bottom
-    AddTriangle(scene, Point(423.0, 0.1, 247.0), Point(265.0, 0.1, 296.0), Point(314.0, 0.1, 456.0), blue_mat);
-    AddTriangle(scene, Point(423.0, 0.1, 247.0), Point(472.0, 0.1, 406.0), Point(314.0, 0.1, 456.0), blue_mat);
+    AddQuad(scene, Point(423.0, 0.1, 247.0), Point(265.0, 0.1, 296.0), Point(314.0, 0.1, 456.0), Point(472.0, 0.1, 406.0), blue_mat);
     // left
-    AddTriangle(scene, Point(423.0, 0.0, 247.0), Point(423.0, 330.0, 247.0), Point(472.0, 330.0, 406.0), blue_mat);
-    AddTriangle(scene, Point(423.0, 0.0, 247.0), Point(472.0, 0.0, 406.0), Point(472.0, 330.0, 406.0), blue_mat);
+    AddQuad(scene, Point(423.0, 0.0, 247.0), Point(423.0, 330.0, 247.0), Point(472.0, 330.0, 406.0), Point(472.0, 0.0, 406.0), blue_mat);
     // back
-    AddTriangle(scene, Point(472.0, 0.0, 406.0), Point(472.0, 330.0, 406.0), Point(314.0, 330.0, 456.0), blue_mat);
-    AddTriangle(scene, Point(472.0, 0.0, 406.0), Point(314.0, 0.0, 406.0), Point(314.0, 330.0, 456.0), blue_mat);
+    AddQuad(scene, Point(472.0, 0.0, 406.0), Point(472.0, 330.0, 406.0), Point(314.0, 330.0, 456.0), Point(314.0, 0.0, 406.0), blue_mat);
     // right
-    AddTriangle(scene, Point(314.0, 0.0, 456.0), Point(314.0, 330.0, 456.0), Point(265.0, 330.0, 296.0), blue_mat);
-    AddTriangle(scene, Point(314.0, 0.0, 456.0), Point(265.0, 0.0, 296.0), Point(265.0, 330.0, 296.0), blue_mat);
+    AddQuad(scene, Point(314.0, 0.0, 456.0), Point(314.0, 330.0, 456.0), Point(265.0, 330.0, 296.0), Point(265.0, 0.0, 296.0), blue_mat);
     // front
-    AddTriangle(scene, Point(265.0, 0.0, 296.0), Point(265.0, 330.0, 296.0), Point(423.0, 330.0, 247.0), blue_mat);
-    AddTriangle(scene, Point(265.0, 0.0, 296.0), Point(423.0, 0.0, 247.0), Point(423.0, 330.0, 247.0), blue_mat);
+    AddQuad(scene, Point(265.0, 0.0, 296.0), Point(265.0, 330.0, 296.0), Point(423.0, 330.0, 247.0), Point(423.0, 0.0, 247.0), blue_mat);
     
     // transparent sphere
     AddSphere(scene, Point(160., 320., 225.), 90., glass_mat);
@@ -231,13 +282,9 @@ void CornellBox (Scene& scene) {
         }
     }
 #else
+    // the ceiling panels are large and close to the ceiling and walls: sample their solid angle
     for (int lll=-1 ; lll<2 ; lll++) {
-        AreaLight *a1 = new AreaLight(RGB(250000.,250000.,250000.), Point(250.+lll*150, 545., 250.+lll*150), Point(300.+lll*150, 545., 250.+lll*150), Point(300.+lll*150, 545., 300.+lll*150), Vector (0.,-1.,0.));
-            scene.lights.push_back(a1);
-            scene.numLights++;
-        AreaLight *a2 = new AreaLight(RGB(250000.,250000.,250000.), Point(250.+lll*150, 545., 250.+lll*150), Point(250.+lll*150, 545., 300.+lll*150), Point(300.+lll*150, 545., 300.+lll*150), Vector (0.,-1.,0.));
-            scene.lights.push_back(a2);
-            scene.numLights++;
+        AddQuadLight(scene, RGB(500000., 500000., 500000.), Point(250.+lll*150, 545., 250.+lll*150), Point(300.+lll*150, 545., 250.+lll*150), Point(300.+lll*150, 545., 300.+lll*150), Point(250.+lll*150, 545., 300.+lll*150), Vector (0.,-1.,0.), true);
     }
 #endif
     return ;
@@ -253,64 +300,47 @@ void DiffuseCornellBox (Scene& scene) {
     int const blue_mat = AddMat(scene, RGB (0., 0., 0.1), RGB (0., 0., 0.6), RGB (0., 0., 0.), RGB (0., 0., 0.));
     int const orange_mat = AddMat(scene, RGB (0.37, 0.24, 0.), RGB (0.66, 0.44, 0.), RGB (0., 0., 0.), RGB (0., 0., 0.));
     // Floor
-    AddTriangle(scene, Point(552.8, 0.0, 0.0), Point(0.0, 0.0, 0.0), Point(0.0, 0.0, 559.2), white_mat);
-    AddTriangle(scene, Point(549.6, 0.0, 559.2), Point(552.8, 0.0, 0.0), Point(0.0, 0.0, 559.2), white_mat);
+    AddQuad(scene, Point(552.8, 0.0, 0.0), Point(0.0, 0.0, 0.0), Point(0.0, 0.0, 559.2), Point(549.6, 0.0, 559.2), white_mat);
     // Ceiling
-    AddTriangle(scene, Point(556.0, 548.8, 0.0), Point(0.0, 548.8, 0.0), Point(0.0, 548.8, 559.2), white_mat);
-    AddTriangle(scene, Point(556.0, 548.8, 559.2), Point(556.0, 548.8, 0.0), Point(0., 548.8, 559.2), white_mat);
+    AddQuad(scene, Point(556.0, 548.8, 0.0), Point(0.0, 548.8, 0.0), Point(0.0, 548.8, 559.2), Point(556.0, 548.8, 559.2), white_mat);
     // Back wall
-    AddTriangleUV (scene, Point(0.0, 0.0, 559.2), Point(549.6, 0.0, 559.2), Point(556.0, 548.8, 559.2), Vec2(1.,1.), Vec2(0.,1.), Vec2(0.,0.), text_backwall);
-    AddTriangleUV(scene, Point(0.0, 0.0, 559.2), Point(0.0, 548.8, 559.2), Point(556.0, 548.8, 559.2), Vec2(1.,1.), Vec2(1.,0.), Vec2(0.,0.), text_backwall);
+    AddQuadUV(scene, Point(0.0, 0.0, 559.2), Point(549.6, 0.0, 559.2), Point(556.0, 548.8, 559.2), Point(0.0, 548.8, 559.2), Vec2(1.,1.), Vec2(0.,1.), Vec2(0.,0.), Vec2(1.,0.), text_backwall);
     //AddTriangle (scene, Point(0.0, 0.0, 559.2), Point(549.6, 0.0, 559.2), Point(556.0, 548.8, 559.2), white_mat);
     //AddTriangle(scene, Point(0.0, 0.0, 559.2), Point(0.0, 548.8, 559.2), Point(556.0, 548.8, 559.2), white_mat);
     // Left Wall
-    AddTriangle(scene, Point(0.0, 0.0, 0.), Point(0., 0., 559.2), Point(0., 548.8, 559.2), green_mat);
-    AddTriangle(scene, Point(0.0, 0.0, 0.), Point(0., 548.8, 0.), Point(0., 548.8, 559.2), green_mat);
+    AddQuad(scene, Point(0.0, 0.0, 0.), Point(0., 0., 559.2), Point(0., 548.8, 559.2), Point(0., 548.8, 0.), green_mat);
     // Right Wall
-    AddTriangle(scene, Point(552.8, 0.0, 0.), Point(549.6, 0., 559.2), Point(549.6, 548.8, 559.2), red_mat);
-    AddTriangle(scene, Point(552.8, 0.0, 0.), Point(552.8, 548.8, 0.), Point(549.6, 548.8, 559.2), red_mat);
+    AddQuad(scene, Point(552.8, 0.0, 0.), Point(549.6, 0., 559.2), Point(549.6, 548.8, 559.2), Point(552.8, 548.8, 0.), red_mat);
 
     // short block
     // top
-    AddTriangleUV(scene, Point(130.0, 165.0,  65.0), Point( 82.0, 165.0, 225.0), Point(240.0, 165.0, 272.0), Vec2(0.,0.), Vec2(0.,1.), Vec2(1.,1.), uminho_text);
-    AddTriangleUV(scene, Point(130.0, 165.0,  65.0), Point( 290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), Vec2(0.,0.), Vec2(1.,0.), Vec2(1.,1.), uminho_text);
+    AddQuadUV(scene, Point(130.0, 165.0,  65.0), Point( 82.0, 165.0, 225.0), Point(240.0, 165.0, 272.0), Point( 290.0, 165.0, 114.0), Vec2(0.,0.), Vec2(0.,1.), Vec2(1.,1.), Vec2(1.,0.), uminho_text);
     //AddTriangle(scene, Point(130.0, 165.0,  65.0), Point( 82.0, 165.0, 225.0), Point(240.0, 165.0, 272.0), orange_mat);
     //AddTriangle(scene, Point(130.0, 165.0,  65.0), Point( 290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), orange_mat);
     // bottom
-    AddTriangle(scene, Point(130.0, 0.01,  65.0), Point( 82.0, 0.01, 225.0), Point(240.0, 0.01, 272.0), orange_mat);
-    AddTriangle(scene, Point(130.0, 0.01,  65.0), Point( 290.0, 0.01, 114.0), Point(240.0, 0.01, 272.0), orange_mat);
+    AddQuad(scene, Point(130.0, 0.01,  65.0), Point( 82.0, 0.01, 225.0), Point(240.0, 0.01, 272.0), Point( 290.0, 0.01, 114.0), orange_mat);
     // left
-    AddTriangle(scene, Point(290.0,   0.0, 114.0), Point(  290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), orange_mat);
-    AddTriangle(scene, Point(290.0,   0.0, 114.0), Point( 240.0,  0.0, 272.0), Point(240.0, 165.0, 272.0), orange_mat);
+    AddQuad(scene, Point(290.0,   0.0, 114.0), Point(  290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), Point( 240.0,  0.0, 272.0), orange_mat);
     // back
-    AddTriangle(scene, Point(240.0, 0.0, 272.0), Point(240.0, 165.0, 272.0), Point(82.0, 165., 225.0), orange_mat);
-    AddTriangle(scene, Point(240.0, 0.0, 272.0), Point(82.0, 0.0, 225.0), Point(82.0, 165.0, 225.0), orange_mat);
+    AddQuad(scene, Point(240.0, 0.0, 272.0), Point(240.0, 165.0, 272.0), Point(82.0, 165., 225.0), Point(82.0, 0.0, 225.0), orange_mat);
     // right
-    AddTriangle(scene, Point(82.0, 0.0, 225.0), Point(82.0, 165.0, 225.0), Point(130.0, 165.0, 65.0), orange_mat);
-    AddTriangle(scene, Point(82.0, 0.0, 225.0), Point(130.0, 0.0, 65.0), Point(130.0, 165.0, 65.0), orange_mat);
+    AddQuad(scene, Point(82.0, 0.0, 225.0), Point(82.0, 165.0, 225.0), Point(130.0, 165.0, 65.0), Point(130.0, 0.0, 65.0), orange_mat);
     // front
-    AddTriangle(scene, Point( 130.0,   0.0,  65.0), Point(130.0, 165.0, 65.0), Point(290.0, 165.0, 114.0), orange_mat);
-    AddTriangle(scene, Point( 130.0,   0.0,  65.0), Point(290.0, 0.0, 114.0), Point(290.0, 165.0, 114.0), orange_mat);
+    AddQuad(scene, Point( 130.0,   0.0,  65.0), Point(130.0, 165.0, 65.0), Point(290.0, 165.0, 114.0), Point(290.0, 0.0, 114.0), orange_mat);
 
     // tall block
     // top
-    AddTriangle(scene, Point(423.0, 330.0, 247.0), Point(265.0, 330.0, 296.0), Point(314.0, 330.0, 456.0), blue_mat);
-    AddTriangle(scene, Point(423.0, 330.0, 247.0), Point(472.0, 330.0, 406.0), Point(314.0, 330.0, 456.0), blue_mat);
+    AddQuad(scene, Point(423.0, 330.0, 247.0), Point(265.0, 330.0, 296.0), Point(314.0, 330.0, 456.0), Point(472.0, 330.0, 406.0), blue_mat);
     // bottom
-    AddTriangle(scene, Point(423.0, 0.1, 247.0), Point(265.0, 0.1, 296.0), Point(314.0, 0.1, 456.0), blue_mat);
-    AddTriangle(scene, Point(423.0, 0.1, 247.0), Point(472.0, 0.1, 406.0), Point(314.0, 0.1, 456.0), blue_mat);
+    AddQuad(scene, Point(423.0, 0.1, 247.0), Point(265.0, 0.1, 296.0), Point(314.0, 0.1, 456.0), Point(472.0, 0.1, 406.0), blue_mat);
     // left
-    AddTriangle(scene, Point(423.0, 0.0, 247.0), Point(423.0, 330.0, 247.0), Point(472.0, 330.0, 406.0), blue_mat);
-    AddTriangle(scene, Point(423.0, 0.0, 247.0), Point(472.0, 0.0, 406.0), Point(472.0, 330.0, 406.0), blue_mat);
+    AddQuad(scene, Point(423.0, 0.0, 247.0), Point(423.0, 330.0, 247.0), Point(472.0, 330.0, 406.0), Point(472.0, 0.0, 406.0), blue_mat);
     // back
-    AddTriangle(scene, Point(472.0, 0.0, 406.0), Point(472.0, 330.0, 406.0), Point(314.0, 330.0, 456.0), blue_mat);
-    AddTriangle(scene, Point(472.0, 0.0, 406.0), Point(314.0, 0.0, 406.0), Point(314.0, 330.0, 456.0), blue_mat);
+    AddQuad(scene, Point(472.0, 0.0, 406.0), Point(472.0, 330.0, 406.0), Point(314.0, 330.0, 456.0), Point(314.0, 0.0, 406.0), blue_mat);
     // right
-    AddTriangle(scene, Point(314.0, 0.0, 456.0), Point(314.0, 330.0, 456.0), Point(265.0, 330.0, 296.0), blue_mat);
-    AddTriangle(scene, Point(314.0, 0.0, 456.0), Point(265.0, 0.0, 296.0), Point(265.0, 330.0, 296.0), blue_mat);
+    AddQuad(scene, Point(314.0, 0.0, 456.0), Point(314.0, 330.0, 456.0), Point(265.0, 330.0, 296.0), Point(265.0, 0.0, 296.0), blue_mat);
     // front
-    AddTriangle(scene, Point(265.0, 0.0, 296.0), Point(265.0, 330.0, 296.0), Point(423.0, 330.0, 247.0), blue_mat);
-    AddTriangle(scene, Point(265.0, 0.0, 296.0), Point(423.0, 0.0, 247.0), Point(423.0, 330.0, 247.0), blue_mat);
+    AddQuad(scene, Point(265.0, 0.0, 296.0), Point(265.0, 330.0, 296.0), Point(423.0, 330.0, 247.0), Point(423.0, 0.0, 247.0), blue_mat);
 
 
     // add an ambient light to the scene
@@ -319,7 +349,10 @@ void DiffuseCornellBox (Scene& scene) {
     //scene.lights.push_back(ambient);
     //scene.numLights++;
 #define AREA
-#ifndef AREA
+//#define RING_LIGHT
+#if defined(RING_LIGHT)
+    CornellRingLight(scene, 1.2f);
+#elif !defined(AREA)
     for (int x=-1 ; x<2 ; x++) {
         for (int z=-1 ; z<2 ; z++) {
             PointLight *p = new PointLight(RGB(0.16,0.16,0.16),Point(278.+x*150.,545.,280.+z*150));
@@ -328,18 +361,42 @@ void DiffuseCornellBox (Scene& scene) {
         }
     }
 #else
+    // the ceiling panels are large and close to the ceiling and walls: sample their solid angle
     for (int lll=-1 ; lll<2 ; lll++) {
-        AreaLight *a1 = new AreaLight(RGB(.2,.2,.2), Point(250.+lll*150, 545., 250.+lll*150), Point(300.+lll*150, 545., 250.+lll*150), Point(300.+lll*150, 545., 300.+lll*150), Vector (0.,-1.,0.));
-            scene.lights.push_back(a1);
-            scene.numLights++;
-        AreaLight *a2 = new AreaLight(RGB(.2,.2,.2), Point(250.+lll*150, 545., 250.+lll*150), Point(250.+lll*150, 545., 300.+lll*150), Point(300.+lll*150, 545., 300.+lll*150), Vector (0.,-1.,0.));
-            scene.lights.push_back(a2);
-            scene.numLights++;
+        AddQuadLight(scene, RGB(0.4, 0.4, 0.4), Point(250.+lll*150, 545., 250.+lll*150), Point(300.+lll*150, 545., 250.+lll*150), Point(300.+lll*150, 545., 300.+lll*150), Point(250.+lll*150, 545., 300.+lll*150), Vector (0.,-1.,0.), true);
     }
 #endif
     return ;
 }
 
+// ring shaped light strip under the ceiling of the Cornell box scenes: a single
+// MeshLight with 2*64 triangles, brighter towards +X
+void CornellRingLight (Scene& scene, float const power) {
+    int const N = 64;
+    float const r0 = 150.f, r1 = 165.f;
+    // mean radiance ; the +X modulation averages to 1 around the ring
+    float const Lmean = power / (M_PI * (r1*r1 - r0*r0));
+    std::vector<Point> vertices;
+    std::vector<int> indices;
+    std::vector<RGB> radiance;
+    for (int i=0 ; i<N ; i++) {
+        float const phi = 2.f * M_PI * i / N;
+        vertices.push_back(Point(278.+r0*cosf(phi), 545., 280.+r0*sinf(phi)));
+        vertices.push_back(Point(278.+r1*cosf(phi), 545., 280.+r1*sinf(phi)));
+    }
+    for (int i=0 ; i<N ; i++) {
+        int const a = 2*i, b = 2*i+1, c = 2*((i+1)%N), d = 2*((i+1)%N)+1;
+        // vertex order such that the triangles face down
+        int const tri[6] = {a, b, c, b, d, c};
+        indices.insert(indices.end(), tri, tri+6);
+        float const Le = Lmean * (1.f + 0.5f * cosf(2.f * M_PI * (i+0.5f) / N));
+        radiance.push_back(RGB(Le, Le, Le));
+        radiance.push_back(RGB(Le, Le, Le));
+    }
+    scene.lights.push_back(new MeshLight(vertices, indices, radiance));
+    scene.numLights++;
+}
+
 // DLight Challenge
 void DLightChallenge (Scene& scene) {
     int const text_backwall = AddTextMat(scene, "Dog.ppm", RGB (0.3, 0.3, 0.3), RGB (0.8, 0.8, 0.8), RGB (0., 0., 0.), RGB (0., 0., 0.));
@@ -350,120 +407,84 @@ void DLightChallenge (Scene& scene) {
     int const blue_mat = AddMat(scene, RGB (0., 0., 0.1), RGB (0., 0., 0.6), RGB (0., 0., 0.), RGB (0., 0., 0.));
     int const orange_mat = AddMat(scene, RGB (0.37, 0.24, 0.), RGB (0.66, 0.44, 0.), RGB (0., 0., 0.), RGB (0., 0., 0.));
     // Floor
-    AddTriangle(scene, Point(552.8, 0.0, 0.0), Point(-100.0, 0.0, 0.0), Point(-100.0, 0.0, 859.2), white_mat);
-    AddTriangle(scene, Point(549.6, 0.0, 859.2), Point(552.8, 0.0, 0.0), Point(-100.0, 0.0, 859.2), white_mat);
+    AddQuad(scene, Point(552.8, 0.0, 0.0), Point(-100.0, 0.0, 0.0), Point(-100.0, 0.0, 859.2), Point(549.6, 0.0, 859.2), white_mat);
     // Ceiling
-    AddTriangle(scene, Point(556.0, 548.8, 0.0), Point(-100.0, 548.8, 0.0), Point(-100.0, 548.8, 859.2), white_mat);
-    AddTriangle(scene, Point(556.0, 548.8, 859.2), Point(556.0, 548.8, 0.0), Point(-100., 548.8, 859.2), white_mat);
+    AddQuad(scene, Point(556.0, 548.8, 0.0), Point(-100.0, 548.8, 0.0), Point(-100.0, 548.8, 859.2), Point(556.0, 548.8, 859.2), white_mat);
     // Back wall
-    AddTriangleUV (scene, Point(-100.0, 0.0, 859.2), Point(549.6, 0.0, 859.2), Point(556.0, 548.8, 859.2), Vec2(1.,1.), Vec2(0.,1.), Vec2(0.,0.), text_backwall);
-    AddTriangleUV(scene, Point(-100.0, 0.0, 859.2), Point(-100.0, 548.8, 859.2), Point(556.0, 548.8, 859.2), Vec2(1.,1.), Vec2(1.,0.), Vec2(0.,0.), text_backwall);
+    AddQuadUV(scene, Point(-100.0, 0.0, 859.2), Point(549.6, 0.0, 859.2), Point(556.0, 548.8, 859.2), Point(-100.0, 548.8, 859.2), Vec2(1.,1.), Vec2(0.,1.), Vec2(0.,0.), Vec2(1.,0.), text_backwall);
     // Left Wall
-    AddTriangle(scene, Point(0.0, 0.0, 0.), Point(0., 0., 459.2), Point(0., 548.8, 459.2), green_mat);
-    AddTriangle(scene, Point(0.0, 0.0, 0.), Point(0., 548.8, 0.), Point(0., 548.8, 459.2), green_mat);
+    AddQuad(scene, Point(0.0, 0.0, 0.), Point(0., 0., 459.2), Point(0., 548.8, 459.2), Point(0., 548.8, 0.), green_mat);
     // L walls
-    AddTriangle(scene, Point(-100.0, 0.0, 459.2), Point(-100., 0., 859.2), Point(-100., 548.8, 859.2), white_mat);
-    AddTriangle(scene, Point(-100.0, 0.0, 459.2), Point(-100., 548.8, 459.2), Point(-100., 548.8, 859.2), white_mat);
-    AddTriangle (scene, Point(-100.0, 0.0, 459.2), Point(0., 0.0, 459.2), Point(0., 548.8, 459.2),  white_mat);
-    AddTriangle(scene, Point(-100.0, 0.0, 459.2), Point(-100.0, 548.8, 459.2), Point(0., 548.8, 459.2), white_mat);
+    AddQuad(scene, Point(-100.0, 0.0, 459.2), Point(-100., 0., 859.2), Point(-100., 548.8, 859.2), Point(-100., 548.8, 459.2), white_mat);
+    AddQuad(scene, Point(-100.0, 0.0, 459.2), Point(0., 0.0, 459.2), Point(0., 548.8, 459.2), Point(-100.0, 548.8, 459.2), white_mat);
     // Right Wall
     
-    AddTriangle(scene, Point(552.8, 0.0, 0.0), Point(549.6, 0., 859.2), Point(549.6, 548.8, 859.2), red_mat);
-    AddTriangle(scene, Point(552.8, 0.0, 0.0), Point(552.8, 548.8, 0.0), Point(549.6, 548.8, 859.2), red_mat);
+    AddQuad(scene, Point(552.8, 0.0, 0.0), Point(549.6, 0., 859.2), Point(549.6, 548.8, 859.2), Point(552.8, 548.8, 0.0), red_mat);
 
     // short block
     // top
-    AddTriangleUV(scene, Point(130.0, 165.0,  65.0), Point( 82.0, 165.0, 225.0), Point(240.0, 165.0, 272.0), Vec2(0.,0.), Vec2(0.,1.), Vec2(1.,1.), uminho_text);
-    AddTriangleUV(scene, Point(130.0, 165.0,  65.0), Point( 290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), Vec2(0.,0.), Vec2(1.,0.), Vec2(1.,1.), uminho_text);
+    AddQuadUV(scene, Point(130.0, 165.0,  65.0), Point( 82.0, 165.0, 225.0), Point(240.0, 165.0, 272.0), Point( 290.0, 165.0, 114.0), Vec2(0.,0.), Vec2(0.,1.), Vec2(1.,1.), Vec2(1.,0.), uminho_text);
     //AddTriangle(scene, Point(130.0, 165.0,  65.0), Point( 82.0, 165.0, 225.0), Point(240.0, 165.0, 272.0), orange_mat);
     //AddTriangle(scene, Point(130.0, 165.0,  65.0), Point( 290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), orange_mat);
     // bottom
-    AddTriangle(scene, Point(130.0, 0.01,  65.0), Point( 82.0, 0.01, 225.0), Point(240.0, 0.01, 272.0), orange_mat);
-    AddTriangle(scene, Point(130.0, 0.01,  65.0), Point( 290.0, 0.01, 114.0), Point(240.0, 0.01, 272.0), orange_mat);
+    AddQuad(scene, Point(130.0, 0.01,  65.0), Point( 82.0, 0.01, 225.0), Point(240.0, 0.01, 272.0), Point( 290.0, 0.01, 114.0), orange_mat);
     // left
-    AddTriangle(scene, Point(290.0,   0.0, 114.0), Point(  290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), orange_mat);
-    AddTriangle(scene, Point(290.0,   0.0, 114.0), Point( 240.0,  0.0, 272.0), Point(240.0, 165.0, 272.0), orange_mat);
+    AddQuad(scene, Point(290.0,   0.0, 114.0), Point(  290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), Point( 240.0,  0.0, 272.0), orange_mat);
     // back
-    AddTriangle(scene, Point(240.0, 0.0, 272.0), Point(240.0, 165.0, 272.0), Point(82.0, 165., 225.0), orange_mat);
-    AddTriangle(scene, Point(240.0, 0.0, 272.0), Point(82.0, 0.0, 225.0), Point(82.0, 165.0, 225.0), orange_mat);
+    AddQuad(scene, Point(240.0, 0.0, 272.0), Point(240.0, 165.0, 272.0), Point(82.0, 165., 225.0), Point(82.0, 0.0, 225.0), orange_mat);
     // right
-    AddTriangle(scene, Point(82.0, 0.0, 225.0), Point(82.0, 165.0, 225.0), Point(130.0, 165.0, 65.0), orange_mat);
-    AddTriangle(scene, Point(82.0, 0.0, 225.0), Point(130.0, 0.0, 65.0), Point(130.0, 165.0, 65.0), orange_mat);
+    AddQuad(scene, Point(82.0, 0.0, 225.0), Point(82.0, 165.0, 225.0), Point(130.0, 165.0, 65.0), Point(130.0, 0.0, 65.0), orange_mat);
     // front
-    AddTriangle(scene, Point( 130.0,   0.0,  65.0), Point(130.0, 165.0, 65.0), Point(290.0, 165.0, 114.0), orange_mat);
-    AddTriangle(scene, Point( 130.0,   0.0,  65.0), Point(290.0, 0.0, 114.0), Point(290.0, 165.0, 114.0), orange_mat);
+    AddQuad(scene, Point( 130.0,   0.0,  65.0), Point(130.0, 165.0, 65.0), Point(290.0, 165.0, 114.0), Point(290.0, 0.0, 114.0), orange_mat);
 
     // tall block
     // top
-    AddTriangle(scene, Point(423.0, 330.0, 247.0), Point(265.0, 330.0, 296.0), Point(314.0, 330.0, 456.0), blue_mat);
-    AddTriangle(scene, Point(423.0, 330.0, 247.0), Point(472.0, 330.0, 406.0), Point(314.0, 330.0, 456.0), blue_mat);
+    AddQuad(scene, Point(423.0, 330.0, 247.0), Point(265.0, 330.0, 296.0), Point(314.0, 330.0, 456.0), Point(472.0, 330.0, 406.0), blue_mat);
     // bottom
-    AddTriangle(scene, Point(423.0, 0.1, 247.0), Point(265.0, 0.1, 296.0), Point(314.0, 0.1, 456.0), blue_mat);
-    AddTriangle(scene, Point(423.0, 0.1, 247.0), Point(472.0, 0.1, 406.0), Point(314.0, 0.1, 456.0), blue_mat);
+    AddQuad(scene, Point(423.0, 0.1, 247.0), Point(265.0, 0.1, 296.0), Point(314.0, 0.1, 456.0), Point(472.0, 0.1, 406.0), blue_mat);
     // left
-    AddTriangle(scene, Point(423.0, 0.0, 247.0), Point(423.0, 330.0, 247.0), Point(472.0, 330.0, 406.0), blue_mat);
-    AddTriangle(scene, Point(423.0, 0.0, 247.0), Point(472.0, 0.0, 406.0), Point(472.0, 330.0, 406.0), blue_mat);
+    AddQuad(scene, Point(423.0, 0.0, 247.0), Point(423.0, 330.0, 247.0), Point(472.0, 330.0, 406.0), Point(472.0, 0.0, 406.0), blue_mat);
     // back
-    AddTriangle(scene, Point(472.0, 0.0, 406.0), Point(472.0, 330.0, 406.0), Point(314.0, 330.0, 456.0), blue_mat);
-    AddTriangle(scene, Point(472.0, 0.0, 406.0), Point(314.0, 0.0, 406.0), Point(314.0, 330.0, 456.0), blue_mat);
+    AddQuad(scene, Point(472.0, 0.0, 406.0), Point(472.0, 330.0, 406.0), Point(314.0, 330.0, 456.0), Point(314.0, 0.0, 406.0), blue_mat);
     // right
-    AddTriangle(scene, Point(314.0, 0.0, 456.0), Point(314.0, 330.0, 456.0), Point(265.0, 330.0, 296.0), blue_mat);
-    AddTriangle(scene, Point(314.0, 0.0, 456.0), Point(265.0, 0.0, 296.0), Point(265.0, 330.0, 296.0), blue_mat);
+    AddQuad(scene, Point(314.0, 0.0, 456.0), Point(314.0, 330.0, 456.0), Point(265.0, 330.0, 296.0), Point(265.0, 0.0, 296.0), blue_mat);
     // front
-    AddTriangle(scene, Point(265.0, 0.0, 296.0), Point(265.0, 330.0, 296.0), Point(423.0, 330.0, 247.0), blue_mat);
-    AddTriangle(scene, Point(265.0, 0.0, 296.0), Point(423.0, 0.0, 247.0), Point(423.0, 330.0, 247.0), blue_mat);
+    AddQuad(scene, Point(265.0, 0.0, 296.0), Point(265.0, 330.0, 296.0), Point(423.0, 330.0, 247.0), Point(423.0, 0.0, 247.0), blue_mat);
     
-  
+    // emitters are quads: each power is the total of the 2 triangles previously used
+    // each set of emitters is a light group (per light AOVs)
+    int first = scene.numLights;
     for (int llz=-1 ; llz<2 ; llz++) {
         for (int llx=-1 ; llx<2 ; llx++) {
-            AreaLight *a1 = new AreaLight(RGB(5000.-(llx+llz)*2000.,5000. -(llx+llz)*2000.,5000.-(llx+llz)*2000.), Point(250.+llx*150, 545., 250.+llz*150), Point(300.+llx*150, 545., 250.+llz*150), Point(300.+llx*150, 545., 300.+llz*150), Vector (0.,-1.,0.));
-            scene.lights.push_back(a1);
-            scene.numLights++;
-            AreaLight *a2 = new AreaLight(RGB(5000.-(llx+llz)*2000.,5000.-(llx+llz)*2000.,5000.-(llx+llz)*2000.), Point(250.+llx*150, 545., 250.+llz*150), Point(250.+llx*150, 545., 300.+llz*150), Point(300.+llx*150, 545., 300.+llz*150), Vector (0.,-1.,0.));
-            scene.lights.push_back(a2);
-            scene.numLights++;
+            AddQuadLight(scene, RGB(2.*(5000.-(llx+llz)*2000.), 2.*(5000. -(llx+llz)*2000.), 2.*(5000.-(llx+llz)*2000.)), Point(250.+llx*150, 545., 250.+llz*150), Point(300.+llx*150, 545., 250.+llz*150), Point(300.+llx*150, 545., 300.+llz*150), Point(250.+llx*150, 545., 300.+llz*150), Vector (0.,-1.,0.));
         }
     }
+    scene.AddLightGroup("ceiling", first);
+    first = scene.numLights;
     for (int lll=0 ; lll<2 ; lll++) {
-        AreaLight *a1 = new AreaLight(RGB(15000.+lll*4000,15000.+lll*4000,15000.+lll*4000), Point(-10., 20.+250*lll, 459.3), Point(-10., 90.+250*lll, 459.3), Point(-90, 90.+250*lll, 459.3), Vector (0.,0.,1.));
-            scene.lights.push_back(a1);
-            scene.numLights++;
-        AreaLight *a2 = new AreaLight(RGB(15000.+lll*4000,15000.+lll*4000,15000.+lll*4000), Point(-10., 20.+250*lll, 459.3), Point(-90., 20.+250*lll, 459.3), Point(-90, 90.+250*lll, 459.3), Vector (0.,0.,1.));
-            scene.lights.push_back(a2);
-            scene.numLights++;
+        AddQuadLight(scene, RGB(2.*(15000.+lll*4000), 2.*(15000.+lll*4000), 2.*(15000.+lll*4000)), Point(-10., 20.+250*lll, 459.3), Point(-10., 90.+250*lll, 459.3), Point(-90, 90.+250*lll, 459.3), Point(-90., 20.+250*lll, 459.3), Vector (0.,0.,1.));
     }
+    scene.AddLightGroup("corridor", first);
+    first = scene.numLights;
     for (int lll=0 ; lll<2 ; lll++) {
-        AreaLight *a1 = new AreaLight(RGB(2000.-lll*500,2000.-lll*500.,1000. -lll*500), Point(0.01, 20., 20.+lll*200.), Point(0.01, 20., 100.+lll*200.), Point(0.01, 30., 100.+lll*200.), Vector (1.,0.,0.));
-            scene.lights.push_back(a1);
-            scene.numLights++;
-        AreaLight *a2 = new AreaLight(RGB(2000.-lll*500,2000.-lll*500,1000. -lll*500), Point(0.01, 20., 20.+lll*200.), Point(0.01, 30., 20.+lll*200.), Point(0.01, 30., 100.+lll*200.), Vector (1.,0.,0.));
-            scene.lights.push_back(a2);
-            scene.numLights++;
+        AddQuadLight(scene, RGB(2.*(2000.-lll*500), 2.*(2000.-lll*500.), 2.*(1000. -lll*500)), Point(0.01, 20., 20.+lll*200.), Point(0.01, 20., 100.+lll*200.), Point(0.01, 30., 100.+lll*200.), Point(0.01, 30., 20.+lll*200.), Vector (1.,0.,0.));
     }
+    scene.AddLightGroup("green_wall_strips", first);
+    first = scene.numLights;
     for (int lll=0 ; lll<4 ; lll++) {
-        AreaLight *a1 = new AreaLight(RGB(2000.-lll*450,2000.-lll*450.,1000. -lll*300), Point(549.59, 20., 20.+lll*200.), Point(549.59, 20., 100.+lll*200.), Point(549.59, 30., 100.+lll*200.), Vector (-1.,0.,0.));
-            scene.lights.push_back(a1);
-            scene.numLights++;
-        AreaLight *a2 = new AreaLight(RGB(2000.-lll*450,2000.-lll*450,1000. -lll*300), Point(549.59, 20., 20.+lll*200.), Point(549.59, 30., 20.+lll*200.), Point(549.59, 30., 100.+lll*200.), Vector (-1.,0.,0.));
-            scene.lights.push_back(a2);
-            scene.numLights++;
+        AddQuadLight(scene, RGB(2.*(2000.-lll*450), 2.*(2000.-lll*450.), 2.*(1000. -lll*300)), Point(549.59, 20., 20.+lll*200.), Point(549.59, 20., 100.+lll*200.), Point(549.59, 30., 100.+lll*200.), Point(549.59, 30., 20.+lll*200.), Vector (-1.,0.,0.));
     }
+    scene.AddLightGroup("red_wall_strips", first);
+    first = scene.numLights;
     { // blue block light
-        AreaLight *a1 = new AreaLight(RGB(4000.,4000.0,10000.), Point(340.0, 0.01, 220.0), Point(340.0, 0.01, 230.0), Point(350.0, 0.01, 230.0), Vector (0.,1.,0.));
-            scene.lights.push_back(a1);
-            scene.numLights++;
-        AreaLight *a2 = new AreaLight(RGB(4000.,4000.0,10000.), Point(340.0, 0.01, 220.0), Point(350.0, 0.01, 220.0), Point(350.0, 0.01, 230.0), Vector (0.,1.,0.));
-            scene.lights.push_back(a2);
-            scene.numLights++;
+        AddQuadLight(scene, RGB(8000., 8000., 20000.), Point(340.0, 0.01, 220.0), Point(340.0, 0.01, 230.0), Point(350.0, 0.01, 230.0), Point(350.0, 0.01, 220.0), Vector (0.,1.,0.));
     }
+    scene.AddLightGroup("blue_block", first);
+    first = scene.numLights;
     { // orange block light
-        AreaLight *a1 = new AreaLight(RGB(4000.,4000.0,10000.), Point(210.0, 0.01, 60.0), Point(210., 0.01, 70.0), Point(220., 0.01, 70.0), Vector (0.,1.,0.));
-            scene.lights.push_back(a1);
-            scene.numLights++;
-        AreaLight *a2 = new AreaLight(RGB(4000.,4000.0,10000.), Point(210., 0.01, 60.0), Point(220., 0.01, 60.0), Point(220., 0.01, 70.0), Vector (0.,1.,0.));
-            scene.lights.push_back(a2);
-            scene.numLights++;
+        AddQuadLight(scene, RGB(8000., 8000., 20000.), Point(210.0, 0.01, 60.0), Point(210., 0.01, 70.0), Point(220., 0.01, 70.0), Point(220., 0.01, 60.0), Vector (0.,1.,0.));
     }
+    scene.AddLightGroup("orange_block", first);
     return ;
 }
 
@@ -474,8 +495,7 @@ void DeFocusTriScene (Scene& scene) {
     int const green_mat = AddDiffuseMat(scene, RGB (0.1, 0.9, 0.1));
     int const brown_mat = AddDiffuseMat(scene, RGB (210./256.,105./256.,30./256.));
     // floor
-    AddTriangle(scene, Point(-20., -0.1, -20.), Point(-20., -0.1, 20.), Point(20., -0.1, 20.),brown_mat);
-    AddTriangle(scene, Point(-20., -0.1, -20.), Point(20., -0.1, -20.), Point(20., -0.1, 20.),brown_mat);
+    AddQuad(scene, Point(-20., -0.1, -20.), Point(-20., -0.1, 20.), Point(20., -0.1, 20.), Point(20., -0.1, -20.), brown_mat);
 
     float const Xbase=0.;
     float const Zbase=10.;
@@ -494,3 +514,29 @@ void DeFocusTriScene (Scene& scene) {
     scene.numLights++;
     return ;
 }
+
+// Spheres over a floor lit only by an environment map
+void EnvironmentScene (Scene& scene, std::string filename, float const scale) {
+    int const white_mat = AddDiffuseMat(scene, RGB (0.5, 0.5, 0.5));
+    int const red_mat = AddMat(scene, RGB (0., 0., 0.), RGB (0.5, 0.05, 0.05), RGB (0., 0., 0.), RGB (0., 0., 0.));
+    int const mirror_mat = AddMat(scene, RGB (0., 0., 0.), RGB (0., 0., 0.), RGB (0.9, 0.9, 0.9), RGB (0., 0., 0.));
+    int const glass_mat = AddMat(scene, RGB (0., 0., 0.), RGB (0., 0., 0.), RGB (0.1, 0.1, 0.1), RGB (0.9, 0.9, 0.9), 1.5);
+    int const gold_mat = AddGGXMat(scene, 0.35, RGB (1., 0.78, 0.34));
+    int const frosted_mat = AddGGXMat(scene, 0.25, RGB (1., 1., 1.), RGB (1., 1., 1.), 1.5);
+    // floor
+    AddQuad(scene, Point(-20., 0., -20.), Point(-20., 0., 20.), Point(20., 0., 20.), Point(20., 0., -20.), white_mat);
+    AddSphere(scene, Point(-2.2, 1., 6.), 1., red_mat);
+    AddSphere(scene, Point(0., 1., 7.), 1., mirror_mat);
+    AddSphere(scene, Point(2.2, 1., 6.), 1., glass_mat);
+    AddSphere(scene, Point(-1.1, 0.5, 4.), 0.5, gold_mat);
+    AddSphere(scene, Point(1.1, 0.5, 4.), 0.5, frosted_mat);
+
+    EnvironmentLight *env = new EnvironmentLight(filename, scale);
+    if (env->W() > 0) {
+        scene.lights.push_back(env);
+        scene.numLights++;
+    } else {
+        delete env;
+    }
+    return ;
+}
@@ -12,8 +12,12 @@
 #include "AmbientLight.hpp"
 #include "PointLight.hpp"
 #include "AreaLight.hpp"
+#include "QuadAreaLight.hpp"
+#include "MeshLight.hpp"
+#include "EnvironmentLight.hpp"
 #include "Sphere.hpp"
 #include "triangle.hpp"
+#include "Quad.hpp"
 #include "BRDF.hpp"
 
  void SpheresScene (Scene& scene, int const N_spheres);
@@ -23,5 +27,9 @@ void DeFocusTriScene (Scene& scene);
 void CornellBox (Scene& scene);
 void DiffuseCornellBox (Scene& scene);
 void DLightChallenge (Scene& scene);
+// adds a ring shaped MeshLight with about this total power under the ceiling of the Cornell box scenes
+void CornellRingLight (Scene& scene, float const power);
+// filename: latitude-longitude image (.ppm or .pfm) ; scale multiplies its values
+void EnvironmentScene (Scene& scene, std::string filename, float const scale=1.f);
 
 #endif /* BuildScenes_hpp */
@@ -10,12 +10,94 @@
 #include "primitive.hpp"
 #include "BRDF.hpp"
 #include "AreaLight.hpp"
+#include "QuadAreaLight.hpp"
+#include "MeshLight.hpp"
+#include "EnvironmentLight.hpp"
+#include "PointLight.hpp"
 
 #include <iostream>
 #include <set>
 #include <vector>
 
 
+bool Scene::SetLights (void) {
+    lightTable.resize(numLights);
+    environment = NULL;
+    lightGroup.resize(numLights, -1);
+    for (int l = 0 ; l < numLights ; l++) {
+        if (lightGroup[l] < 0) {
+            lightGroupNames.push_back("light" + std::to_string(l));
+            lightGroup[l] = (int)lightGroupNames.size() - 1;
+        }
+    }
+    for (int l = 0 ; l < numLights ; l++) {
+        switch (lights[l]->type) {
+            case POINT_LIGHT: {
+                PointLight *pl = (PointLight *)lights[l];
+                lightTable.cx[l] = pl->pos.X;
+                lightTable.cy[l] = pl->pos.Y;
+                lightTable.cz[l] = pl->pos.Z;
+                lightTable.cosOffset[l] = 1.f;
+                lightTable.area[l] = 1.f;
+                lightTable.lum[l] = pl->color.Y();
+                lightTable.positional[l] = 1.f;
+                break;
+            }
+            case AREA_LIGHT: {
+                AreaLight *al = (AreaLight *)lights[l];
+                Point const C = (al->gem->v1 + al->gem->v2 + al->gem->v3) * (1.f / 3.f);
+                lightTable.cx[l] = C.X;
+                lightTable.cy[l] = C.Y;
+                lightTable.cz[l] = C.Z;
+                lightTable.nx[l] = al->gem->normal.X;
+                lightTable.ny[l] = al->gem->normal.Y;
+                lightTable.nz[l] = al->gem->normal.Z;
+                lightTable.area[l] = al->gem->area();
+                lightTable.lum[l] = al->intensity.Y();
+                lightTable.positional[l] = 1.f;
+                break;
+            }
+            case QUAD_AREA_LIGHT: {
+                QuadAreaLight *ql = (QuadAreaLight *)lights[l];
+                Point const C = ql->gem->point(0.5f, 0.5f);
+                lightTable.cx[l] = C.X;
+                lightTable.cy[l] = C.Y;
+                lightTable.cz[l] = C.Z;
+                lightTable.nx[l] = ql->gem->normal.X;
+                lightTable.ny[l] = ql->gem->normal.Y;
+                lightTable.nz[l] = ql->gem->normal.Z;
+                lightTable.area[l] = ql->gem->area();
+                lightTable.lum[l] = ql->intensity.Y();
+                lightTable.positional[l] = 1.f;
+                break;
+            }
+            case MESH_LIGHT: {
+                // treated as omnidirectional (as a point light) at the mesh centroid
+                MeshLight *ml = (MeshLight *)lights[l];
+                lightTable.cx[l] = ml->centroid.X;
+                lightTable.cy[l] = ml->centroid.Y;
+                lightTable.cz[l] = ml->centroid.Z;
+                lightTable.cosOffset[l] = 1.f;
+                lightTable.area[l] = ml->area;
+                lightTable.lum[l] = (ml->area > 0.f ? ml->power.Y() / ml->area : 0.f);
+                lightTable.positional[l] = 1.f;
+                break;
+            }
+            case ENVIRONMENT_LIGHT: {
+                // irradiance of an unoccluded surface under a uniform environment
+                EnvironmentLight *el = (EnvironmentLight *)lights[l];
+                lightTable.constant[l] = M_PI * el->AverageLuminance();
+                lightTable.infinite.push_back(l);
+                environment = el;
+                break;
+            }
+            default:    // ambient lights do not take part in light selection
+                break;
+        }
+    }
+    return true;
+}
+
 bool Scene::trace (Ray r, Intersection *isect) {
     Intersection curr_isect;
     bool intersection = false;    
@@ -27,6 +109,8 @@ bool Scene::trace (Ray r, Intersection *isect) {
         
     curr_isect.pix_x = isect->pix_x = r.pix_x;
     curr_isect.pix_y = isect->pix_y = r.pix_y;
+    // if nothing is hit wo still gives the direction of the environment
+    isect->wo = -1.f * r.dir;
 
     if (numPrimitives==0) return false;
     
@@ -41,37 +125,70 @@ bool Scene::trace (Ray r, Intersection *isect) {
                 intersection = true;
                 *isect = curr_isect;
                 isect->f = BRDFs[(*prim_itr)->material_ndx];
+                isect->PrimID = (int)(prim_itr - prims.begin());
+                isect->uv_scale = (*prim_itr)->g->uv_scale;
             }
             else if (curr_isect.depth < isect->depth) {
                 *isect = curr_isect;
                 isect->f = BRDFs[(*prim_itr)->material_ndx];
+                isect->PrimID = (int)(prim_itr - prims.begin());
+                isect->uv_scale = (*prim_itr)->g->uv_scale;
             }
         }
     }
     isect->isLight = false;
+    isect->LightID = -1;
 
     // now iterate over light sources and intersect with those that have geometry
     for (auto l = lights.begin() ; l != lights.end() ; l++) {
-        if ((*l)->type == AREA_LIGHT) {
-            AreaLight *al = (AreaLight *)*l;
-            if (al->gem->intersect(r, &curr_isect)) {
-                if (!intersection) { // first intersection
-                    intersection = true;
-                    *isect = curr_isect;
-                    isect->isLight = true;
-                    //isect->Le = RGB(2.,2.,2.);
-                    isect->Le = al->L();
-                }
-                else if (curr_isect.depth < isect->depth) {
-                    *isect = curr_isect;
-                    isect->isLight = true;
-                    isect->Le = al->L();
-                    //isect->Le = RGB(2.,2.,2.);
-                }
+        bool hit = false;
+        RGB Le;
+        switch ((*l)->type) {
+            case AREA_LIGHT: {
+                hit = ((AreaLight *)*l)->gem->intersect(r, &curr_isect);
+                Le = ((AreaLight *)*l)->intensity;
+                break;
+            }
+            case QUAD_AREA_LIGHT: {
+                hit = ((QuadAreaLight *)*l)->gem->intersect(r, &curr_isect);
+                Le = ((QuadAreaLight *)*l)->intensity;
+                break;
+            }
+            case MESH_LIGHT: {
+                hit = ((MeshLight *)*l)->intersect(r, &curr_isect, Le);
+                break;
+            }
+            default:    // lights without geometry
+                break;
+        }
+        if (hit) {
+            if (!intersection) { // first intersection
+                intersection = true;
+                *isect = curr_isect;
+                isect->isLight = true;
+                isect->PrimID = -1;
+                isect->LightID = (int)(l - lights.begin());
+                isect->uv_scale = 0.f;
+                //isect->Le = RGB(2.,2.,2.);
+                isect->Le = Le;
+            }
+            else if (curr_isect.depth < isect->depth) {
+                *isect = curr_isect;
+                isect->isLight = true;
+                isect->PrimID = -1;
+                isect->LightID = (int)(l - lights.begin());
+                isect->uv_scale = 0.f;
+                isect->Le = Le;
+                //isect->Le = RGB(2.,2.,2.);
             }
         }
     }
     isect->r_type = r.rtype;
+    isect->throughput = r.throughput;
+    isect->after_diffuse = r.after_diffuse;
+    // the cone grows linearly with the distance travelled
+    isect->cone_spread = r.cone_spread;
+    isect->cone_width = (intersection ? r.cone_width + r.cone_spread * isect->depth : r.cone_width);
     
     return intersection;
 }
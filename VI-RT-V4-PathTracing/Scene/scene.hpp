@@ -13,6 +13,7 @@
 #include <vector>
 #include "primitive.hpp"
 #include "light.hpp"
+#include "LightTable.hpp"
 #include "ray.hpp"
 #include "intersection.hpp"
 #include "BRDF.hpp"
@@ -23,9 +24,17 @@ class Scene {
 public:
     std::vector <Light *> lights;
     int numPrimitives, numLights, numBRDFs;
+    BB bb;      // scene bounding box (union of the primitives' bounding boxes)
+    LightTable lightTable;  // SoA copy of the lights for the light selection strategies
+    Light *environment;     // the ENVIRONMENT_LIGHT (radiance of the rays that miss), if any
+    // named groups of lights (per light AOVs) ; SetLights gives each light without one a group of its own
+    std::vector<std::string> lightGroupNames;
+    std::vector<int> lightGroup;    // per light
 
-    Scene (): numPrimitives(0), numLights(0), numBRDFs(0) {}
-    bool SetLights (void) { return true; };
+    Scene (): numPrimitives(0), numLights(0), numBRDFs(0), environment(NULL) {}
+    // (re)build the light table and find the environment ; must be called after all lights are
+    // added and before rendering (the shaders only read the table: it is shared by the threads)
+    bool SetLights (void);
     bool trace (Ray r, Intersection *isect);
     bool visibility (Ray s, const float maxL);
     int AddMaterial (BRDF *mat) {
@@ -33,11 +42,26 @@ public:
         numBRDFs++;
         return (numBRDFs-1);  // the material (BRDF) index is required to the primitive
     }
+    // the lights added since first (lights[first..numLights-1]) form the group name
+    int AddLightGroup (std::string name, const int first) {
+        lightGroupNames.push_back(name);
+        lightGroup.resize(numLights, -1);
+        for (int l=first ; l<numLights ; l++) lightGroup[l] = (int)lightGroupNames.size() - 1;
+        return ((int)lightGroupNames.size() - 1);
+    }
     void AddPrimitive (Primitive *prim) {
         // add primitive to scene
         prims.push_back(prim);
+        if (numPrimitives==0) bb = prim->g->bb;
+        else {
+            bb.update(prim->g->bb.min);
+            bb.update(prim->g->bb.max);
+        }
         numPrimitives++;
     }
+    // read only access for the view independent solvers (radiosity)
+    Primitive *GetPrimitive (const int p) { return prims[p]; }
+    BRDF *GetMaterial (const int m) { return BRDFs[m]; }
     void printSummary(void) {
         std::cout << "#primitives = " << numPrimitives << " ; ";
         std::cout << "#lights = " << numLights << " ; ";
@@ -0,0 +1,523 @@
+//
+//  BDPTShader.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "BDPTShader.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+#include "EnvironmentLight.hpp"
+#include "DiffuseTexture.hpp"
+#include "GGX.hpp"
+#include "LightPaths.hpp"
+
+// emitting side of area and quad lights (zero for the others)
+static Vector lightNormal (Light *light) {
+    Vector n;
+    if (light->type == AREA_LIGHT) n = ((AreaLight *)light)->gem->normal;
+    else if (light->type == QUAD_AREA_LIGHT) n = ((QuadAreaLight *)light)->gem->normal;
+    n.normalize();
+    return n;
+}
+
+// pdf (solid angle) converted to the area at to
+static float toArea (const float pdf, const Point &from, const Point &to, const Vector &to_n) {
+    Point f = from;
+    Vector d = f.vec2point(to);
+    float const d2 = d.normSQ();
+    if (d2 <= 0.f) return 0.f;
+    float p = pdf / d2;
+    if (to_n.normSQ() > 0.f) {
+        d.normalize();
+        p *= fabsf(to_n.dot(d));
+    }
+    return p;
+}
+
+// the ratios of 2 pdfs of a Dirac delta are taken as 1 (pbrt book, sec 16.3.4)
+static float remap0 (const float f) {
+    return (f != 0.f ? f : 1.f);
+}
+
+BDPT::BDPT (Scene *scene, Camera *cam, RGB bg, const int W, const int H, const int max_depth): Shader(scene), background(bg), cam(cam), W(W), H(H), max_depth(max_depth), splat(3 * W * H), light_paths(0), light_tracing(true) {
+    for (std::atomic<float> &v : splat) v.store(0.f, std::memory_order_relaxed);
+    float const total = lightFluxCdf(scene, lightCdf);
+    if (total > 0.f) {
+        for (float &c : lightCdf) c /= total;
+    } else {
+        lightCdf.clear();
+    }
+}
+
+float BDPT::lightSelectPdf (const int l) const {
+    if (l < 0 || l >= (int)lightCdf.size()) return 0.f;
+    return lightCdf[l] - (l > 0 ? lightCdf[l-1] : 0.f);
+}
+
+bool BDPT::sampleLight (PathVertex &v) {
+    if (lightCdf.empty()) return false;
+    float select;
+    int const l = sampleLightFlux(lightCdf, 1.f, U_dist(rng), select);
+    if (select <= 0.f) return false;
+    Light *light = scene->lights[l];
+    float r[2] = {U_dist(rng), U_dist(rng)};
+    v.type = LIGHT_VERTEX;
+    v.light = l;
+    v.f = NULL;
+    v.nd = 0;
+    v.pdfRev = 0.f;
+    v.n = lightNormal(light);
+    switch (light->type) {
+        case POINT_LIGHT:
+            v.p = ((PointLight *)light)->pos;
+            v.Le = ((PointLight *)light)->color;
+            v.delta = true;
+            v.pdfFwd = select;
+            break;
+        case AREA_LIGHT:
+            v.Le = ((AreaLight *)light)->Sample_L(r, &v.p);
+            v.delta = false;
+            v.pdfFwd = select * ((AreaLight *)light)->pdf;
+            break;
+        case QUAD_AREA_LIGHT:
+            v.Le = ((QuadAreaLight *)light)->Sample_L(r, &v.p);
+            v.delta = false;
+            v.pdfFwd = select * ((QuadAreaLight *)light)->pdf;
+            break;
+        default:
+            return false;
+    }
+    v.beta = v.Le;
+    return true;
+}
+
+RGB BDPT::f (const PathVertex &v, const Vector &wi) {
+    RGB fr(0., 0., 0.);
+    BRDF *mat = v.f;
+    // the diffuse lobe reflects only
+    if (!mat->Kd.isZero() && v.n.dot(v.wo) * v.n.dot(wi) > 0.f) {
+        if (mat->textured) {
+            DiffuseTexture *df = (DiffuseTexture *)mat;
+            fr += df->GetKd(v.TexCoord, v.uv_width);
+        } else {
+            fr += mat->Kd;
+        }
+    }
+    if (mat->glossy) {
+        // outwards normal (as in PathTracing::glossyScattering)
+        Vector const N = (v.incident_eta != 1.f ? -1.f * v.n : v.n);
+        fr += ((GGX *)mat)->f(WorldToLocal(v.wo, N), WorldToLocal(wi, N));
+    }
+    return fr;
+}
+
+float BDPT::pdfDir (const PathVertex &v, const Vector &wo, const Vector &wi) {
+    switch (v.type) {
+        case CAMERA_VERTEX: {
+            int x, y;
+            Point eye;
+            float We, pdf;
+            Point const q = v.p + wi;
+            return (cam->Project(q, &x, &y, &eye, &We, &pdf) ? pdf : 0.f);
+        }
+        case LIGHT_VERTEX: {
+            Light *light = scene->lights[v.light];
+            if (light->type == POINT_LIGHT) return 1.f / (4.f * M_PI);
+            if (light->type != AREA_LIGHT && light->type != QUAD_AREA_LIGHT) return 0.f;
+            // cosine distributed around the normal
+            float const cos_l = lightNormal(light).dot(wi);
+            return (cos_l > 0.f ? cos_l / M_PI : 0.f);
+        }
+        default:
+            break;
+    }
+    // lobes selected as in PathTracing::shade
+    BRDF *mat = v.f;
+    float const pS = mat->Ks.Y(), pT = mat->Kt.Y(), pD = mat->Kd.Y();
+    float const sum = pS + pT + pD;
+    if (sum <= 0.f) return 0.f;
+    float pdf = 0.f;
+    float const co = v.n.dot(wo), ci = v.n.dot(wi);
+    if (!mat->Kd.isZero() && co * ci > 0.f) pdf += (pD / sum) * fabsf(ci) / M_PI;
+    if (mat->glossy) {
+        Vector const N = (v.incident_eta != 1.f ? -1.f * v.n : v.n);
+        pdf += ((pS + pT) / sum) * ((GGX *)mat)->pdf(WorldToLocal(wo, N), WorldToLocal(wi, N));
+    }
+    return pdf;
+}
+
+float BDPT::pdfArea (const PathVertex *prev, const PathVertex &v, const PathVertex &next) {
+    Point p = v.p;
+    Vector wn = p.vec2point(next.p);
+    wn.normalize();
+    Vector wp = v.wo;
+    if (prev != NULL) {
+        wp = p.vec2point(prev->p);
+        wp.normalize();
+    }
+    return toArea(pdfDir(v, wp, wn), v.p, next.p, next.n);
+}
+
+float BDPT::pdfLightOrigin (const PathVertex &v) const {
+    Light *light = scene->lights[v.light];
+    float const select = lightSelectPdf(v.light);
+    switch (light->type) {
+        case POINT_LIGHT:
+            return select;
+        case AREA_LIGHT:
+            return select * ((AreaLight *)light)->pdf;
+        case QUAD_AREA_LIGHT:
+            return select * ((QuadAreaLight *)light)->pdf;
+        default:
+            return 0.f;
+    }
+}
+
+RGB BDPT::emitted (const PathVertex &v, const Vector &w) const {
+    Light *light = scene->lights[v.light];
+    // area and quad lights emit towards their normal only
+    if ((light->type == AREA_LIGHT || light->type == QUAD_AREA_LIGHT) && lightNormal(light).dot(w) <= 0.f) return RGB();
+    return v.Le;
+}
+
+bool BDPT::connectible (const PathVertex &v) const {
+    switch (v.type) {
+        case CAMERA_VERTEX:
+            return true;
+        case LIGHT_VERTEX:
+            return (pdfLightOrigin(v) > 0.f);
+        default:
+            return (!v.f->Kd.isZero() || v.f->glossy);
+    }
+}
+
+float BDPT::G (const PathVertex &a, const PathVertex &b) const {
+    Point p = a.p;
+    Vector d = p.vec2point(b.p);
+    float const d2 = d.normSQ();
+    if (d2 <= 0.f) return 0.f;
+    d.normalize();
+    float g = 1.f / d2;
+    if (a.n.normSQ() > 0.f) g *= fabsf(a.n.dot(d));
+    if (b.n.normSQ() > 0.f) g *= fabsf(b.n.dot(d));
+    return g;
+}
+
+bool BDPT::visible (const PathVertex &a, const PathVertex &b) {
+    // leave from a surface (the camera and point lights have no normal)
+    PathVertex const &o = (a.n.normSQ() > 0.f ? a : b);
+    PathVertex const &e = (a.n.normSQ() > 0.f ? b : a);
+    Point p = o.p;
+    Vector dir = p.vec2point(e.p);
+    float const dist = dir.norm();
+    dir.normalize();
+    Ray shadow(o.p, dir, SHADOW);
+    shadow.adjustOrigin(o.n);
+    return scene->visibility(shadow, dist - EPSILON);
+}
+
+int BDPT::randomWalk (Ray ray, bool intersected, Intersection isect, RGB beta, float pdf_dir, PathVertex *path, int n, const bool camera, RGB &Lesc) {
+    while (n < BDPT_MAX_VERTICES) {
+        PathVertex &prev = path[n-1];
+        if (!intersected) {
+            // the background is only reached by the camera subpaths: no other strategy
+            if (camera) {
+                if (scene->environment != NULL) Lesc += beta * ((EnvironmentLight *)scene->environment)->Le(ray.dir);
+                else Lesc += beta * background;
+            }
+            break;
+        }
+        PathVertex &v = path[n];
+        v.p = isect.p;
+        v.wo = isect.wo;
+        v.wo.normalize();
+        v.n = isect.gn;
+        v.beta = beta;
+        v.delta = false;
+        v.nd = prev.nd + (prev.type == SURFACE_VERTEX && !prev.delta ? 1 : 0);
+        v.pdfFwd = toArea(pdf_dir, prev.p, v.p, v.n);
+        v.pdfRev = 0.f;
+        if (isect.isLight) {
+            // lights do not scatter: the light subpaths end before them
+            if (!camera) break;
+            v.type = LIGHT_VERTEX;
+            v.light = isect.LightID;
+            v.Le = isect.Le;
+            v.f = NULL;
+            n++;
+            break;
+        }
+        v.type = SURFACE_VERTEX;
+        v.f = isect.f;
+        v.TexCoord = isect.TexCoord;
+        v.uv_width = ConeFootprint(isect);
+        v.incident_eta = isect.incident_eta;
+        n++;
+        if (n >= BDPT_MAX_VERTICES) break;
+
+        // select a lobe as PathTracing::shade
+        BRDF *mat = v.f;
+        float const pS = mat->Ks.Y(), pT = mat->Kt.Y(), pD = mat->Kd.Y();
+        float const sum = pS + pT + pD;
+        if (sum <= 0.f) break;
+        float const rnd = U_dist(rng) * sum;
+        Ray next;
+        float pdf_rev = 0.f;
+        if (!mat->glossy && rnd < pS) {
+            next = Ray(v.p, reflect(v.wo, v.n), SPEC_REFL);
+            next.adjustOrigin(v.n);
+            next.propagating_eta = v.incident_eta;
+            beta = beta * mat->Ks * (sum / pS);
+            v.delta = true;
+            pdf_dir = 0.f;
+        } else if (!mat->glossy && rnd < pS + pT) {
+            next = specularRefraction(v.p, v.wo, v.n, v.n, v.incident_eta, mat->eta);
+            beta = beta * mat->Kt * (sum / pT);
+            v.delta = true;
+            pdf_dir = 0.f;
+        } else {
+            // diffuse or glossy: the path would get one more non specular bounce
+            if (v.nd + 1 > max_depth) break;
+            float r[3] = {U_dist(rng), U_dist(rng), U_dist(rng)};
+            Vector dir;
+            RayType type = DIFF_REFL;
+            // glossy materials have no specular lobes: rnd selects among all of them
+            if (!mat->glossy || rnd >= pS + pT) {
+                Vector D_around_Z;
+                CosineHemiSphereSample(r, D_around_Z);
+                Vector N = v.n, Rx, Ry;
+                N.CoordinateSystem(&Rx, &Ry);
+                dir = D_around_Z.Rotate(Rx, Ry, N);
+            } else {
+                Vector const N = (v.incident_eta != 1.f ? -1.f * v.n : v.n);
+                Vector wo;
+                float gpdf;
+                ((GGX *)mat)->Sample_f(WorldToLocal(v.wo, N), r, &wo, gpdf);
+                if (gpdf <= 0.f) break;
+                dir = LocalToWorld(wo, N);
+                type = (v.n.dot(v.wo) * v.n.dot(dir) < 0.f ? GLOSS_TRANS : GLOSS_REFL);
+            }
+            dir.normalize();
+            // one sample MIS over the non specular lobes: the pdf of their mixture
+            pdf_dir = pdfDir(v, v.wo, dir);
+            RGB const fr = f(v, dir);
+            if (pdf_dir <= 0.f || fr.isZero()) break;
+            beta = beta * fr * (fabsf(v.n.dot(dir)) / pdf_dir);
+            pdf_rev = pdfDir(v, dir, v.wo);
+            next = Ray(v.p, dir, type);
+            next.adjustOrigin(v.n);
+            bool const inside = (v.incident_eta != 1.0f);
+            next.propagating_eta = (type == GLOSS_TRANS ? (inside ? 1.f : mat->eta) : v.incident_eta);
+        }
+        prev.pdfRev = toArea(pdf_rev, v.p, prev.p, prev.n);
+        if (beta.isZero()) break;
+        next.FaceID = isect.FaceID;
+        // the camera subpath carries its ray cone as PathTracing: kept by the specular
+        // bounces, opened by the diffuse ones and by the glossy ones with their roughness
+        if (camera) {
+            next.cone_width = isect.cone_width;
+            next.cone_spread = isect.cone_spread;
+            if (next.rtype == DIFF_REFL) next.cone_spread = std::max(isect.cone_spread, DIFFUSE_CONE_SPREAD);
+            else if (next.rtype != SPEC_REFL && next.rtype != SPEC_TRANS) next.cone_spread = std::max(isect.cone_spread, std::min(((GGX *)mat)->Alpha(), DIFFUSE_CONE_SPREAD));
+        }
+        ray = next;
+        intersected = scene->trace(ray, &isect);
+    }
+    return n;
+}
+
+float BDPT::misWeight (PathVertex *light, PathVertex *camera, PathVertex &sampled, const int s, const int t) {
+    if (s + t == 2) return 1.f;
+    // lights outside the light selection are only found by the camera subpaths
+    if (s == 0 && pdfLightOrigin(camera[t-1]) <= 0.f) return 1.f;
+    PathVertex *qs = (s > 0 ? &light[s-1] : NULL), *pt = (t > 0 ? &camera[t-1] : NULL);
+    PathVertex *qsMinus = (s > 1 ? &light[s-2] : NULL), *ptMinus = (t > 1 ? &camera[t-2] : NULL);
+    // the vertices around the connection are changed while the weight is computed
+    PathVertex *changed[4] = {qs, pt, qsMinus, ptMinus};
+    PathVertex saved[4];
+    for (int i=0 ; i<4 ; i++) if (changed[i] != NULL) saved[i] = *changed[i];
+
+    if (s == 1) *qs = sampled;
+    else if (t == 1) *pt = sampled;
+    // the connection vertices are never specular
+    if (pt != NULL) pt->delta = false;
+    if (qs != NULL) qs->delta = false;
+    // densities of sampling each of them from the other side
+    if (pt != NULL) pt->pdfRev = (s > 0 ? pdfArea(qsMinus, *qs, *pt) : pdfLightOrigin(*pt));
+    if (ptMinus != NULL) ptMinus->pdfRev = pdfArea(qs, *pt, *ptMinus);
+    if (qs != NULL) qs->pdfRev = pdfArea(ptMinus, *pt, *qs);
+    if (qsMinus != NULL) qsMinus->pdfRev = pdfArea(pt, *qs, *qsMinus);
+
+    // ratios of the pdfs of the other strategies to the one used (power heuristic)
+    float sumRi = 0.f, ri = 1.f;
+    for (int i=t-1 ; i>0 ; i--) {
+        ri *= remap0(camera[i].pdfRev) / remap0(camera[i].pdfFwd);
+        if (!camera[i].delta && !camera[i-1].delta) sumRi += ri * ri;
+    }
+    ri = 1.f;
+    for (int i=s-1 ; i>=0 ; i--) {
+        ri *= remap0(light[i].pdfRev) / remap0(light[i].pdfFwd);
+        bool const delta_light = (i > 0 ? light[i-1].delta : scene->lights[light[0].light]->type == POINT_LIGHT);
+        if (!light[i].delta && !delta_light) sumRi += ri * ri;
+    }
+
+    for (int i=0 ; i<4 ; i++) if (changed[i] != NULL) *changed[i] = saved[i];
+    return 1.f / (1.f + sumRi);
+}
+
+RGB BDPT::connect (PathVertex *light, PathVertex *camera, const int s, const int t, int &x, int &y) {
+    RGB L(0., 0., 0.);
+    PathVertex sampled;
+    // non specular interior vertices of the path (the connected ones are not specular)
+    int const nd = (s == 0 ? camera[t-1].nd : (t == 1 ? light[s-1].nd + 1 : (s == 1 ? camera[t-1].nd + 1 : camera[t-1].nd + light[s-1].nd + 2)));
+    if (nd > max_depth) return L;
+
+    if (s == 0) {
+        // the camera subpath reached a light
+        PathVertex &pt = camera[t-1];
+        if (pt.type != LIGHT_VERTEX) return L;
+        L = pt.beta * emitted(pt, pt.wo);
+    } else if (t == 1) {
+        // light tracing: connect to the camera
+        PathVertex &qs = light[s-1];
+        if (qs.type != SURFACE_VERTEX || !connectible(qs)) return L;
+        float We, pdf_dir;
+        if (!cam->Project(qs.p, &x, &y, &sampled.p, &We, &pdf_dir)) return L;
+        sampled.type = CAMERA_VERTEX;
+        sampled.n = Vector(0., 0., 0.);
+        sampled.delta = false;
+        sampled.nd = 0;
+        sampled.pdfFwd = sampled.pdfRev = 0.f;
+        // importance towards qs, with the cosine at the camera (pdf_dir / We)
+        sampled.beta = RGB(1., 1., 1.) * pdf_dir;
+        Vector wi = qs.p.vec2point(sampled.p);
+        wi.normalize();
+        L = qs.beta * f(qs, wi) * sampled.beta * G(qs, sampled);
+        if (!L.isZero() && !visible(qs, sampled)) L = RGB();
+    } else if (s == 1) {
+        // sample a point on a light (next event estimation)
+        PathVertex &pt = camera[t-1];
+        if (pt.type != SURFACE_VERTEX || !connectible(pt)) return L;
+        if (!sampleLight(sampled)) return L;
+        Vector wi = pt.p.vec2point(sampled.p);
+        wi.normalize();
+        sampled.beta = emitted(sampled, -1.f * wi) / sampled.pdfFwd;
+        L = pt.beta * f(pt, wi) * sampled.beta * G(pt, sampled);
+        if (!L.isZero() && !visible(pt, sampled)) L = RGB();
+    } else {
+        PathVertex &qs = light[s-1], &pt = camera[t-1];
+        if (qs.type != SURFACE_VERTEX || pt.type != SURFACE_VERTEX || !connectible(qs) || !connectible(pt)) return L;
+        Vector d = pt.p.vec2point(qs.p);
+        d.normalize();
+        L = qs.beta * f(qs, -1.f * d) * f(pt, d) * pt.beta * G(qs, pt);
+        if (!L.isZero() && !visible(qs, pt)) L = RGB();
+    }
+    if (L.isZero()) return L;
+    return L * misWeight(light, camera, sampled, s, t);
+}
+
+RGB BDPT::shade (bool intersected, Intersection isect, int depth) {
+    if (!intersected) {
+        if (scene->environment != NULL) return ((EnvironmentLight *)scene->environment)->Le(-1.f * isect.wo);
+        return (background);
+    }
+    RGB color(0., 0., 0.), Lesc(0., 0., 0.);
+    PathVertex camera[BDPT_MAX_VERTICES], light[BDPT_MAX_VERTICES];
+
+    // camera subpath: the renderer traced its first ray
+    PathVertex &c = camera[0];
+    int x, y;
+    float We, pdf_dir;
+    bool const pinhole = cam->Project(isect.p, &x, &y, &c.p, &We, &pdf_dir);
+    if (!pinhole) {
+        // not a pinhole: no strategy reaches the camera, its pdf is not needed
+        c.p = isect.p + isect.wo * isect.depth;
+        pdf_dir = 1.f;
+    }
+    c.type = CAMERA_VERTEX;
+    c.n = Vector(0., 0., 0.);
+    c.beta = RGB(1., 1., 1.);
+    c.delta = !(pinhole && light_tracing);
+    c.nd = 0;
+    c.pdfFwd = 1.f;
+    c.pdfRev = 0.f;
+    Ray primary(c.p, -1.f * isect.wo, PRIMARY);
+    int const nc = randomWalk(primary, true, isect, c.beta, pdf_dir, camera, 1, true, Lesc);
+    color += Lesc;
+
+    // light subpath
+    int nl = 0;
+    if (!c.delta) light_paths.fetch_add(1, std::memory_order_relaxed);
+    if (sampleLight(light[0])) {
+        PathVertex &l0 = light[0];
+        float r[2] = {U_dist(rng), U_dist(rng)};
+        Vector dir;
+        float pdf, cos_l = 1.f;
+        if (l0.delta) {
+            // uniform direction over the sphere
+            float const z = 1.f - 2.f * r[0], s = sqrtf(std::max(0.f, 1.f - z * z));
+            dir = Vector(s * cosf(2.f * M_PI * r[1]), s * sinf(2.f * M_PI * r[1]), z);
+            pdf = 1.f / (4.f * M_PI);
+        } else {
+            // cosine distributed around the normal
+            Vector D_around_Z;
+            pdf = CosineHemiSphereSample(r, D_around_Z);
+            Vector N = l0.n, Rx, Ry;
+            N.CoordinateSystem(&Rx, &Ry);
+            dir = D_around_Z.Rotate(Rx, Ry, N);
+            dir.normalize();
+            cos_l = D_around_Z.Z;
+        }
+        if (pdf > 0.f) {
+            Ray ray(l0.p, dir, PRIMARY);
+            ray.FaceID = -1;
+            ray.propagating_eta = 1.f;
+            if (!l0.delta) ray.adjustOrigin(l0.n);
+            Intersection l_isect;
+            bool const hit = scene->trace(ray, &l_isect);
+            RGB const beta = l0.Le * (cos_l / (l0.pdfFwd * pdf));
+            nl = randomWalk(ray, hit, l_isect, beta, pdf, light, 1, false, Lesc);
+        } else {
+            nl = 1;
+        }
+    }
+
+    // all the connections
+    for (int t=1 ; t<=nc ; t++) {
+        for (int s=0 ; s<=nl ; s++) {
+            if (s + t < 2 || (s == 1 && t == 1) || s + t > BDPT_MAX_VERTICES) continue;
+            if (t == 1 && c.delta) continue;
+            RGB L = connect(light, camera, s, t, x, y);
+            if (L.isZero()) continue;
+            if (t == 1) {
+                // splat: there is no float atomic add
+                float const v[3] = {L.R, L.G, L.B};
+                for (int i=0 ; i<3 ; i++) {
+                    std::atomic<float> &a = splat[3 * (y * W + x) + i];
+                    float old = a.load(std::memory_order_relaxed);
+                    while (!a.compare_exchange_weak(old, old + v[i], std::memory_order_relaxed)) ;
+                }
+            } else {
+                color += L;
+            }
+        }
+    }
+    return color;
+}
+
+// the splats estimate the image with light_paths light subpaths over the whole image:
+// camera rays that miss the scene start none, so scale (1/spp) is not used
+void BDPT::AddSplats (Image *img, const float scale) {
+    long const n = light_paths.load(std::memory_order_relaxed);
+    if (n <= 0) return;
+    float const s = (float)W * (float)H / (float)n;
+    for (int y=0 ; y<H ; y++) {
+        for (int x=0 ; x<W ; x++) {
+            int const i = 3 * (y * W + x);
+            RGB const L(splat[i].load(std::memory_order_relaxed), splat[i+1].load(std::memory_order_relaxed), splat[i+2].load(std::memory_order_relaxed));
+            if (!L.isZero()) img->add(x, y, RGB(L) * s);
+        }
+    }
+}
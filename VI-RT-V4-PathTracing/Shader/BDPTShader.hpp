@@ -0,0 +1,102 @@
+//
+//  BDPTShader.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Bidirectional path tracing (Veach, PhD thesis, ch. 10 ; pbrt book, sec 16.3).
+//  For each camera sample a camera subpath and a light subpath are traced and
+//  every prefix of one is connected to every prefix of the other ; the
+//  contributions are weighted with the power heuristic over all the strategies
+//  that could have produced the same path. The strategies with a single camera
+//  vertex (light tracing) reach arbitrary pixels: they are accumulated in a
+//  splat buffer with atomic adds and added to the image by AddSplats.
+//  Subpaths start on the point, area and quad lights (proportionally to their
+//  flux) ; mesh and environment lights, and the background, are only found by
+//  the camera subpaths. As in directLighting the diffuse BRDF value is Kd.
+//
+
+#ifndef BDPTShader_hpp
+#define BDPTShader_hpp
+
+#include "shader.hpp"
+#include "camera.hpp"
+#include "BRDF.hpp"
+#include "RNG.hpp"
+#include <atomic>
+#include <random>
+#include <vector>
+
+// vertices of each subpath (the path length is also bounded by this)
+#define BDPT_MAX_VERTICES 16
+
+class BDPT: public Shader {
+    typedef enum {
+        CAMERA_VERTEX,
+        LIGHT_VERTEX,
+        SURFACE_VERTEX
+    } VertexType;
+    typedef struct PathVertex {
+        VertexType type;
+        Point p;
+        Vector n;           // geometric normal (zero for the camera and point lights)
+        Vector wo;          // towards the previous vertex of the subpath
+        BRDF *f;
+        Vec2 TexCoord;
+        float uv_width;     // texture footprint of the ray cone (camera subpath ; 0 on the light subpath)
+        float incident_eta;
+        RGB beta;           // subpath throughput up to this vertex
+        RGB Le;             // light vertices: radiance (intensity for point lights)
+        int light;          // light vertices: index in scene->lights
+        bool delta;         // a specular lobe was sampled here (or a point light, or a camera that cannot be connected to)
+        int nd;             // non specular surface vertices before this one
+        float pdfFwd, pdfRev;   // area densities of sampling this vertex from each side
+    } PathVertex;
+    RGB background;
+    Camera *cam;
+    int W, H;
+    int max_depth;          // non specular bounces
+    std::vector<std::atomic<float> > splat;     // R, G, B per pixel
+    std::atomic<long> light_paths;              // light subpaths traced
+    std::vector<float> lightCdf;                // light selection, proportional to the flux
+    bool light_tracing;     // connect the light subpaths to the camera (t=1, splats)
+    /****************************************
+
+     Our Random Number Generator (rng) */
+    std::random_device rdev{};
+    RNG rng{rdev()};
+    std::uniform_real_distribution<float>U_dist{0.0,1.0};  // uniform distribution in[0,1[
+
+    float lightSelectPdf (const int l) const;
+    // sample a light and a point on it (v) ; false if there are no such lights
+    bool sampleLight (PathVertex &v);
+    // extend path (n vertices, the last already set) along ray, scattering at the
+    // surfaces ; returns the number of vertices ; camera: the radiance of the
+    // background reached by the subpath is added to Lesc
+    int randomWalk (Ray ray, bool intersected, Intersection isect, RGB beta, float pdf_dir, PathVertex *path, int n, const bool camera, RGB &Lesc);
+    // BRDF value (non specular lobes) at v from v.wo to wi
+    RGB f (const PathVertex &v, const Vector &wi);
+    // pdf (solid angle) with which v samples the direction wi, coming from wo
+    float pdfDir (const PathVertex &v, const Vector &wo, const Vector &wi);
+    // pdf (area at next) with which v samples next, when it was reached from prev (may be NULL)
+    float pdfArea (const PathVertex *prev, const PathVertex &v, const PathVertex &next);
+    // pdf (area) with which a light subpath starts at the light vertex v
+    float pdfLightOrigin (const PathVertex &v) const;
+    // radiance leaving the light vertex v towards w
+    RGB emitted (const PathVertex &v, const Vector &w) const;
+    bool connectible (const PathVertex &v) const;
+    float G (const PathVertex &a, const PathVertex &b) const;
+    bool visible (const PathVertex &a, const PathVertex &b);
+    float misWeight (PathVertex *light, PathVertex *camera, PathVertex &sampled, const int s, const int t);
+    // contribution of the path made of s light and t camera vertices ; t=1 sets the pixel (x,y)
+    RGB connect (PathVertex *light, PathVertex *camera, const int s, const int t, int &x, int &y);
+public:
+    // max_depth: non specular bounces ; 2 is the path space of PathTracing (one
+    // indirect diffuse bounce, lit directly)
+    BDPT (Scene *scene, Camera *cam, RGB bg, const int W, const int H, const int max_depth=2);
+    // the strategies splatting onto arbitrary pixels are only possible with a
+    // renderer that calls AddSplats (on by default)
+    void SetLightTracing (const bool on) { light_tracing = on; }
+    RGB shade (bool intersected, Intersection isect, int depth);
+    void AddSplats (Image *img, const float scale);
+};
+
+#endif /* BDPTShader_hpp */
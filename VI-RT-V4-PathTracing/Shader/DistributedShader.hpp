@@ -11,6 +11,7 @@
 #include "shader.hpp"
 #include "BRDF.hpp"
 #include "directLighting.hpp"
+#include "RNG.hpp"
 #include <random>
 
 class DistributedShader: public Shader {
@@ -21,7 +22,7 @@ class DistributedShader: public Shader {
      
      Our Random Number Generator (rng) */
     std::random_device rdev{};
-    std::mt19937 rng{rdev()};
+    RNG rng{rdev()};
     std::uniform_real_distribution<float>U_dist{0.0,1.0};  // uniform distribution in[0,1[
 
 
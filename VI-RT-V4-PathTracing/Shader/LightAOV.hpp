@@ -0,0 +1,33 @@
+//
+//  LightAOV.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Per light attribution of the radiance of a sample (light AOVs). The
+//  renderer points Active at a buffer with one RGB per light while a sample
+//  is shaded ; the shaders record, wherever a light's radiance enters the
+//  estimate (directLighting and the emitter hits), that contribution times
+//  the throughput of the path from the camera. Radiance is linear in each
+//  light's power, so the image can be remixed with new gains per light.
+//
+
+#ifndef LightAOV_hpp
+#define LightAOV_hpp
+
+#include <vector>
+#include "RGB.hpp"
+
+class LightAOV {
+public:
+    // the per light radiance of the sample shaded by the calling thread (NULL: none)
+    static std::vector<RGB> *&Active (void) {
+        static thread_local std::vector<RGB> *active = NULL;
+        return active;
+    }
+    // L: the radiance light l adds to the sample (throughput included)
+    static void record (const int l, const RGB &L) {
+        std::vector<RGB> *active = Active();
+        if (active != NULL && l >= 0 && l < (int)active->size()) (*active)[l] += L;
+    }
+};
+
+#endif /* LightAOV_hpp */
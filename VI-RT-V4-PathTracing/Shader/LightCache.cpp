@@ -0,0 +1,77 @@
+//
+//  LightCache.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "LightCache.hpp"
+
+#include <algorithm>
+
+LightCache::LightCache (Scene *scene, const int resolution): numLights(scene->numLights) {
+    Vector const diag = scene->bb.min.vec2point(scene->bb.max);
+    float const maxDim = std::max(diag.X, std::max(diag.Y, diag.Z));
+    origin = scene->bb.min;
+    cellSize = (maxDim > 0.f ? maxDim / resolution : 1.f);
+}
+
+// 3 x 20 bits for the cell coordinates + 3 bits for the dominant axis of the normal
+// so that the floor and a wall meeting at a corner do not share a cell
+unsigned long long LightCache::key (const Point &p, const Vector &n) const {
+    unsigned long long const ix = (unsigned long long)((int)floorf((p.X - origin.X) / cellSize) & 0xFFFFF);
+    unsigned long long const iy = (unsigned long long)((int)floorf((p.Y - origin.Y) / cellSize) & 0xFFFFF);
+    unsigned long long const iz = (unsigned long long)((int)floorf((p.Z - origin.Z) / cellSize) & 0xFFFFF);
+    Vector nn = n;
+    int const axis = nn.Abs().MaxDimension();
+    float const XYZ[3] = {n.X, n.Y, n.Z};
+    unsigned long long const dir = (unsigned long long)(2*axis + (XYZ[axis] < 0.f ? 1 : 0));
+    return (ix << 43) | (iy << 23) | (iz << 3) | dir;
+}
+
+void LightCache::buildCDF (Cell &c) const {
+    float total = 0.f;
+    for (int i=0 ; i<numLights ; i++) {
+        total += c.sum[i] / c.count[i];
+    }
+    float const uniform = 1.f / numLights;
+    float acc = 0.f;
+    for (int i=0 ; i<numLights ; i++) {
+        float prob = uniform;
+        if (total > 0.f) prob = (1.f - uniform_mix) * (c.sum[i] / c.count[i]) / total + uniform_mix * uniform;
+        acc += prob;
+        c.cdf[i] = acc;
+    }
+    c.cdf[numLights-1] = 1.f;   // avoid rounding errors
+    c.updates = 0;
+}
+
+LightCache::Cell *LightCache::find (const Point &p, const Vector &n) {
+    auto const it = cells.find(key(p, n));
+    if (it == cells.end()) return NULL;
+    return &it->second;
+}
+
+LightCache::Cell *LightCache::insert (const Point &p, const Vector &n, const std::vector<float> &weights) {
+    Cell &c = cells[key(p, n)];
+    c.sum = weights;
+    c.count.assign(numLights, 1.f);
+    c.cdf.resize(numLights);
+    buildCDF(c);
+    return &c;
+}
+
+int LightCache::sample (const Cell *c, const float rnd, float &prob) const {
+    int const l = (int)(std::upper_bound(c->cdf.begin(), c->cdf.end(), rnd) - c->cdf.begin());
+    int const chosen = (l < numLights ? l : numLights-1);
+    prob = pmf(c, chosen);
+    return chosen;
+}
+
+float LightCache::pmf (const Cell *c, const int l) const {
+    return c->cdf[l] - (l > 0 ? c->cdf[l-1] : 0.f);
+}
+
+void LightCache::update (Cell *c, const int l, const float contribution) {
+    c->sum[l] += contribution;
+    c->count[l] += 1.f;
+    if (++c->updates >= rebuild_every) buildCDF(*c);
+}
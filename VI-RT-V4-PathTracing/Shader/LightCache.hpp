@@ -0,0 +1,56 @@
+//
+//  LightCache.hpp
+//  VI-RT-V4-PathTracing
+//
+//  World space hash grid where each cell stores a light selection CDF.
+//  Nearby shading points share the same cell, so the per light importance
+//  is computed only once per cell (with estimateContribution) and then
+//  refined online with the actual (unoccluded) contributions of the
+//  sampled lights. Occluded lights end up with low probability.
+//
+
+#ifndef LightCache_hpp
+#define LightCache_hpp
+
+#include <vector>
+#include <unordered_map>
+#include "vector.hpp"
+#include "scene.hpp"
+
+class LightCache {
+public:
+    typedef struct Cell {
+        std::vector<float> sum;     // accumulated contribution (luminance) per light, prior included
+        std::vector<float> count;   // number of samples per light (the prior counts as 1)
+        std::vector<float> cdf;     // selection CDF
+        int updates;                // updates since the last CDF rebuild
+    } Cell;
+private:
+    std::unordered_map<unsigned long long, Cell> cells;
+    Point origin;
+    float cellSize;
+    int numLights;
+    unsigned long long key (const Point &p, const Vector &n) const;
+    void buildCDF (Cell &c) const;
+public:
+    // fraction of the selection probability spread uniformly over all lights
+    // keeps the estimator unbiased for lights the cell has not seen contributing
+    const float uniform_mix = 0.1f;
+    // rebuild the cell CDF after this many updates
+    const int rebuild_every = 8;
+
+    // resolution: number of cells along the largest dimension of the scene
+    LightCache (Scene *scene, const int resolution=32);
+    // returns NULL if the cell containing (p,n) was not yet created
+    Cell *find (const Point &p, const Vector &n);
+    // create the cell containing (p,n) with the given prior (on the scale of the contributions)
+    Cell *insert (const Point &p, const Vector &n, const std::vector<float> &weights);
+    // select a light with the cell CDF ; prob is the probability of the selected light
+    int sample (const Cell *c, const float rnd, float &prob) const;
+    // probability of selecting light l with the cell CDF
+    float pmf (const Cell *c, const int l) const;
+    // add the contribution obtained by sampling light l (not divided by its pmf)
+    void update (Cell *c, const int l, const float contribution);
+};
+
+#endif /* LightCache_hpp */
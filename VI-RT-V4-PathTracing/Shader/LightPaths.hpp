@@ -0,0 +1,147 @@
+//
+//  LightPaths.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Paths that start at the lights, shared by PhotonMap, VPLShader and BDPT:
+//  light selection proportional to the emitted flux, the emitted rays and
+//  the specular bounces that follow them.
+//  Only the point and area lights (AREA_LIGHT, QUAD_AREA_LIGHT) emit paths.
+//
+
+#ifndef LightPaths_hpp
+#define LightPaths_hpp
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#include "scene.hpp"
+#include "ray.hpp"
+#include "BRDF.hpp"
+#include "PointLight.hpp"
+#include "AreaLight.hpp"
+#include "QuadAreaLight.hpp"
+#include "Shader_Utils.hpp"
+
+// flux (luminance) emitted by light ; the area lights' radiance is power / area
+static inline float lightFlux (Light *light) {
+    switch (light->type) {
+        case POINT_LIGHT:
+            return 4.f * M_PI * ((PointLight *)light)->color.Y();
+        case AREA_LIGHT:
+            return M_PI * ((AreaLight *)light)->power.Y();
+        case QUAD_AREA_LIGHT:
+            return M_PI * ((QuadAreaLight *)light)->power.Y();
+        default:
+            return 0.f;
+    }
+}
+
+// cumulative flux of the scene's lights ; returns the total
+static inline float lightFluxCdf (Scene *scene, std::vector<float> &cdf) {
+    cdf.resize(scene->numLights);
+    float total = 0.f;
+    for (int l=0 ; l<scene->numLights ; l++) {
+        total += lightFlux(scene->lights[l]);
+        cdf[l] = total;
+    }
+    return total;
+}
+
+// light selected by u in [0,1[ from a cdf of lightFluxCdf ; prob: its probability
+static inline int sampleLightFlux (const std::vector<float> &cdf, const float total, const float u, float &prob) {
+    int l = (int)(std::upper_bound(cdf.begin(), cdf.end(), u * total) - cdf.begin());
+    if (l >= (int)cdf.size()) l = (int)cdf.size() - 1;
+    prob = (cdf[l] - (l > 0 ? cdf[l-1] : 0.f)) / total;
+    return l;
+}
+
+// ray leaving light: uniform over the sphere for point lights, a uniform point
+// over the area and a cosine distributed direction around the normal for area lights
+// flux: the light's flux, carried by the ray when it is the only one emitted
+static inline bool sampleEmission (Light *light, float *r, float *d, Ray &ray, RGB &flux) {
+    Point o;
+    Vector dir, n;
+    switch (light->type) {
+        case POINT_LIGHT: {
+            PointLight *pl = (PointLight *)light;
+            o = pl->pos;
+            float const z = 1.f - 2.f * d[0], s = sqrtf(std::max(0.f, 1.f - z * z));
+            dir = Vector(s * cosf(2.f * M_PI * d[1]), s * sinf(2.f * M_PI * d[1]), z);
+            flux = pl->color * (4.f * M_PI);
+            break;
+        }
+        case AREA_LIGHT: {
+            AreaLight *al = (AreaLight *)light;
+            al->Sample_L(r, &o);
+            n = al->gem->normal;
+            flux = al->power * M_PI;
+            break;
+        }
+        case QUAD_AREA_LIGHT: {
+            QuadAreaLight *ql = (QuadAreaLight *)light;
+            ql->Sample_L(r, &o);
+            n = ql->gem->normal;
+            flux = ql->power * M_PI;
+            break;
+        }
+        default:
+            return false;
+    }
+    if (light->type != POINT_LIGHT) {
+        n.normalize();
+        Vector D_around_Z;
+        CosineHemiSphereSample(d, D_around_Z);
+        Vector Rx, Ry;
+        n.CoordinateSystem(&Rx, &Ry);
+        dir = D_around_Z.Rotate(Rx, Ry, n);
+    }
+    ray = Ray(o, dir, PRIMARY);
+    ray.FaceID = -1;
+    ray.propagating_eta = 1.f;
+    if (light->type != POINT_LIGHT) ray.adjustOrigin(n);
+    return true;
+}
+
+// specular transmission at p, as PathTracing::specularTransmission: the refracted
+// ray, or the reflected one on total internal reflection ; incident_eta is 1 outside the objects
+static inline Ray specularRefraction (const Point &p, const Vector &wo, const Vector &N, const Vector &gn, const float incident_eta, const float eta) {
+    float const new_eta = (incident_eta == 1.0f ? eta : 1.0f);
+    float const IOR = incident_eta / new_eta;
+    Vector const V = -1.f * wo;
+    float const cos_theta = std::min(N.dot(wo), 1.f);
+    float const sin_theta = sqrtf(std::max(0.f, 1.f - cos_theta * cos_theta));
+    bool const cannot_refract = (IOR * sin_theta > 1.f);
+    Ray refraction(p, (cannot_refract ? reflect(V, N) : refract(V, N, IOR)), (cannot_refract ? SPEC_REFL : SPEC_TRANS));
+    refraction.adjustOrigin(-1.f * gn);
+    refraction.propagating_eta = (cannot_refract ? incident_eta : new_eta);
+    return refraction;
+}
+
+// continue a light path at isect with a specular reflection or transmission,
+// selected by u with the probability of its albedo ; false ends the path
+// weight: the throughput of the bounce
+static inline bool specularBounce (Intersection &isect, const float u, Ray &next, RGB &weight) {
+    BRDF *f = isect.f;
+    float pS = f->Ks.Y(), pT = f->Kt.Y();
+    if (pS + pT > 1.f) {
+        float const sum = pS + pT;
+        pS /= sum;
+        pT /= sum;
+    }
+    if (u < pS) {
+        next = Ray(isect.p, reflect(isect.wo, isect.sn), SPEC_REFL);
+        next.adjustOrigin(isect.gn);
+        next.propagating_eta = isect.incident_eta;
+        weight = f->Ks / pS;
+    } else if (u < pS + pT) {
+        next = specularRefraction(isect.p, isect.wo, isect.sn, isect.gn, isect.incident_eta, f->eta);
+        weight = f->Kt / pT;
+    } else {
+        return false;
+    }
+    next.FaceID = isect.FaceID;
+    return true;
+}
+
+#endif /* LightPaths_hpp */
@@ -0,0 +1,184 @@
+//
+//  PathGuiding.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "PathGuiding.hpp"
+
+// (cos theta, phi) square coordinates of dir, in [0,1[
+static void dirToSquare (const Vector &dir, float &u, float &v) {
+    u = std::min(std::max((dir.Z + 1.f) / 2.f, 0.f), 0.99999f);
+    float phi = atan2f(dir.Y, dir.X);
+    if (phi < 0.f) phi += 2.f * M_PI;
+    v = std::min(std::max(phi / (2.f * (float)M_PI), 0.f), 0.99999f);
+}
+
+static Vector squareToDir (const float u, const float v) {
+    float const cos_theta = 2.f * u - 1.f;
+    float const sin_theta = sqrtf(std::max(0.f, 1.f - cos_theta * cos_theta));
+    float const phi = 2.f * M_PI * v;
+    return Vector(sin_theta * cosf(phi), sin_theta * sinf(phi), cos_theta);
+}
+
+// quadrant of (u,v) ; (u,v) are rescaled to the quadrant
+static int quadrant (float &u, float &v) {
+    int i = 0;
+    if (u >= 0.5f) { i += 1; u -= 0.5f; }
+    if (v >= 0.5f) { i += 2; v -= 0.5f; }
+    u *= 2.f;
+    v *= 2.f;
+    return i;
+}
+
+void DTree::record (const Vector &dir, const float value) {
+    if (!(value > 0.f) || !std::isfinite(value)) return;
+    float u, v;
+    dirToSquare(dir, u, v);
+    int n = 0;
+    while (true) {
+        int const i = quadrant(u, v);
+        nodes[n].sum[i] += value;
+        if (nodes[n].child[i] == 0) break;
+        n = nodes[n].child[i];
+    }
+}
+
+float DTree::pdf (const Vector &dir) const {
+    float u, v;
+    dirToSquare(dir, u, v);
+    float p = 1.f;
+    int n = 0;
+    while (true) {
+        Node const &N = nodes[n];
+        float const s = N.sum[0] + N.sum[1] + N.sum[2] + N.sum[3];
+        if (s <= 0.f) return 0.f;
+        int const i = quadrant(u, v);
+        p *= 4.f * N.sum[i] / s;
+        if (N.child[i] == 0) break;
+        n = N.child[i];
+    }
+    // the map of the square to the sphere has constant jacobian 4 PI
+    return p / (4.f * M_PI);
+}
+
+Vector DTree::sample (const float *rnd) const {
+    float r0 = std::min(rnd[0], 0.99999f), r1 = std::min(rnd[1], 0.99999f);
+    float u = 0.f, v = 0.f, side = 1.f;
+    int n = 0;
+    while (true) {
+        Node const &N = nodes[n];
+        // select the column (u) and then the quadrant within it (v), reusing the random numbers
+        float const left = N.sum[0] + N.sum[2], s = left + N.sum[1] + N.sum[3];
+        int iu = 0, iv = 0;
+        if (r0 * s < left) r0 = r0 * s / left;
+        else { iu = 1; r0 = (r0 * s - left) / (s - left); }
+        float const low = N.sum[iu], col = low + N.sum[iu + 2];
+        if (r1 * col < low) r1 = r1 * col / low;
+        else { iv = 1; r1 = (r1 * col - low) / (col - low); }
+        r0 = std::min(std::max(r0, 0.f), 0.99999f);
+        r1 = std::min(std::max(r1, 0.f), 0.99999f);
+        side /= 2.f;
+        u += iu * side;
+        v += iv * side;
+        int const i = iu + 2 * iv;
+        if (N.child[i] == 0) break;
+        n = N.child[i];
+    }
+    return squareToDir(u + r0 * side, v + r1 * side);
+}
+
+// fsum: energy of the 4 quadrants of node n ; fn the corresponding node of from (-1 if it is a leaf there)
+void DTree::subdivide (const DTree &from, const int fn, const float *fsum, const int n, const int depth, const float total) {
+    for (int i=0 ; i<4 ; i++) {
+        if (fsum[i] <= DTREE_SPLIT * total || depth >= DTREE_MAX_DEPTH) continue;
+        int const c = (int)nodes.size();
+        nodes.push_back(Node());
+        nodes[n].child[i] = c;
+        int const fc = (fn >= 0 ? from.nodes[fn].child[i] : 0);
+        if (fc > 0) {
+            subdivide(from, fc, from.nodes[fc].sum, c, depth + 1, total);
+        } else {
+            // assume the energy of a leaf quadrant is evenly spread
+            float const quarter[4] = {fsum[i] / 4.f, fsum[i] / 4.f, fsum[i] / 4.f, fsum[i] / 4.f};
+            subdivide(from, -1, quarter, c, depth + 1, total);
+        }
+    }
+}
+
+void DTree::refine (const DTree &from) {
+    nodes.assign(1, Node());
+    float const total = from.total();
+    if (total > 0.f) subdivide(from, 0, from.nodes[0].sum, 0, 1, total);
+}
+
+GuidingField::GuidingField (Scene *scene): pass(0) {
+    Vector const diag = scene->bb.min.vec2point(scene->bb.max);
+    size = std::max(diag.X, std::max(diag.Y, diag.Z)) * 1.01f;
+    if (size <= 0.f) size = 1.f;
+    // center the cube on the bounding box
+    origin.set(scene->bb.min.X - (size - diag.X) / 2.f, scene->bb.min.Y - (size - diag.Y) / 2.f, scene->bb.min.Z - (size - diag.Z) / 2.f);
+    SNode root;
+    root.axis = 0;
+    root.child[0] = root.child[1] = 0;
+    root.leaf = 0;
+    root.depth = 0;
+    nodes.push_back(root);
+    leaves.resize(1);
+    leaves[0].records = 0.f;
+}
+
+int GuidingField::leafIndex (const Point &p) const {
+    float q[3] = {(p.X - origin.X) / size, (p.Y - origin.Y) / size, (p.Z - origin.Z) / size};
+    int n = 0;
+    while (nodes[n].leaf < 0) {
+        int const a = nodes[n].axis;
+        if (q[a] < 0.5f) {
+            q[a] *= 2.f;
+            n = nodes[n].child[0];
+        } else {
+            q[a] = 2.f * q[a] - 1.f;
+            n = nodes[n].child[1];
+        }
+    }
+    return nodes[n].leaf;
+}
+
+const DTree *GuidingField::find (const Point &p) const {
+    DTree const *t = &leaves[leafIndex(p)].sampling;
+    return (t->total() > 0.f ? t : NULL);
+}
+
+void GuidingField::record (const Point &p, const Vector &dir, const float value) {
+    Leaf &l = leaves[leafIndex(p)];
+    l.building.record(dir, value);
+    l.records += 1.f;
+}
+
+void GuidingField::EndPass (void) {
+    // split the spatial leaves with many records ; both halves inherit the
+    // quadtrees and half of the records (the new nodes are visited by the loop)
+    float const threshold = STREE_SPLIT * sqrtf(powf(2.f, (float)pass));
+    for (size_t n=0 ; n<nodes.size() ; n++) {
+        int const l = nodes[n].leaf;
+        if (l < 0 || leaves[l].records <= threshold || nodes[n].depth >= STREE_MAX_DEPTH) continue;
+        leaves[l].records /= 2.f;
+        leaves.push_back(leaves[l]);
+        for (int c=0 ; c<2 ; c++) {
+            SNode child;
+            child.axis = (nodes[n].axis + 1) % 3;
+            child.child[0] = child.child[1] = 0;
+            child.leaf = (c == 0 ? l : (int)leaves.size() - 1);
+            child.depth = nodes[n].depth + 1;
+            nodes[n].child[c] = (int)nodes.size();
+            nodes.push_back(child);
+        }
+        nodes[n].leaf = -1;
+    }
+    // sample the radiance learned in this pass and refine the trees for the next one
+    for (Leaf &l : leaves) {
+        l.sampling = l.building;
+        l.building.refine(l.sampling);
+        l.records = 0.f;
+    }
+    pass++;
+}
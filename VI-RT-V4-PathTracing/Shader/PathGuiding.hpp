@@ -0,0 +1,95 @@
+//
+//  PathGuiding.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Online learning of the incident radiance for path guiding with a
+//  spatial-directional tree (SD-tree): Muller et al., "Practical path guiding
+//  for efficient light-transport simulation", EGSR 2017.
+//  A binary tree splits the scene (a cube around its bounding box) alternating
+//  the X, Y and Z axes ; each spatial leaf holds two directional quadtrees over
+//  the (cos theta, phi) square, an area preserving map of the sphere: the one
+//  being built from the radiance recorded in the current pass and the one
+//  learned in the previous pass, used for sampling.
+//  At the end of each pass (EndPass) leaves with many records are split and
+//  the quadtrees are refined where they hold a large fraction of the energy.
+//
+
+#ifndef PathGuiding_hpp
+#define PathGuiding_hpp
+
+#include <vector>
+#include <math.h>
+#include <algorithm>
+#include "vector.hpp"
+#include "scene.hpp"
+
+// quadtree nodes holding more than this fraction of the energy are subdivided
+#define DTREE_SPLIT 0.01f
+#define DTREE_MAX_DEPTH 20
+// spatial leaves are split after STREE_SPLIT * sqrt(2^pass) records
+#define STREE_SPLIT 12000.f
+#define STREE_MAX_DEPTH 24
+// probability of sampling the guide (instead of the BRDF) at guided vertices
+#define GUIDE_FRACTION 0.5f
+
+// directional quadtree ; directions are in world space
+class DTree {
+    typedef struct Node {
+        float sum[4];   // energy of each quadrant: (u,v) < 0.5 is 0, u >= 0.5 adds 1, v >= 0.5 adds 2
+        int child[4];   // node index of each quadrant ; 0 if the quadrant is a leaf
+        Node () {
+            for (int i=0 ; i<4 ; i++) { sum[i] = 0.f; child[i] = 0; }
+        }
+    } Node;
+    std::vector<Node> nodes;    // nodes[0] is the root
+    void subdivide (const DTree &from, const int fn, const float *fsum, const int n, const int depth, const float total);
+public:
+    DTree (): nodes(1) {}
+    float total (void) const {
+        return nodes[0].sum[0] + nodes[0].sum[1] + nodes[0].sum[2] + nodes[0].sum[3];
+    }
+    // add value (the radiance arriving from dir over the pdf it was sampled with)
+    void record (const Vector &dir, const float value);
+    // solid angle pdf of sample ; 0 if the tree is empty
+    float pdf (const Vector &dir) const;
+    // direction sampled proportionally to the energy, given rnd[2] in [0,1[
+    Vector sample (const float *rnd) const;
+    // rebuild this tree with the structure given by the energy of from and zero energy
+    void refine (const DTree &from);
+};
+
+class GuidingField {
+    typedef struct SNode {
+        int axis;       // splitting axis (0: X, 1: Y, 2: Z)
+        int child[2];   // node indices ; 0 for leaves
+        int leaf;       // index into leaves for leaf nodes ; -1 otherwise
+        int depth;
+    } SNode;
+    typedef struct Leaf {
+        DTree sampling, building;
+        float records;  // number of records in building
+    } Leaf;
+    std::vector<SNode> nodes;   // nodes[0] is the root
+    std::vector<Leaf> leaves;
+    Point origin;       // minimum corner of the cube
+    float size;         // and its side
+    int pass;
+    int leafIndex (const Point &p) const;
+public:
+    GuidingField (Scene *scene);
+    // the sampling tree of the leaf containing p ; NULL if nothing was learned there yet
+    const DTree *find (const Point &p) const;
+    // radiance value arriving at p from dir (value = luminance / pdf of dir)
+    void record (const Point &p, const Vector &dir, const float value);
+    // ends a learning pass: split and refine the trees and use them for sampling
+    void EndPass (void);
+};
+
+// solid angle pdf of sampling dir at a vertex of normal n with the one sample
+// mixture of the guide (probability GUIDE_FRACTION) and the cosine lobe
+inline float GuidedPdf (const DTree *guide, const Vector &dir, const Vector &n) {
+    float const cos_pdf = std::max(0.f, dir.dot(n)) / (float)M_PI;
+    return GUIDE_FRACTION * guide->pdf(dir) + (1.f - GUIDE_FRACTION) * cos_pdf;
+}
+
+#endif /* PathGuiding_hpp */
@@ -8,6 +8,11 @@
 #include "PathTracingShader.hpp"
 #include "BRDF.hpp"
 #include "ray.hpp"
+#include "EnvironmentLight.hpp"
+#include "DiffuseTexture.hpp"
+#include "LightAOV.hpp"
+
+#include <algorithm>
 
 #include "Shader_Utils.hpp"
 
@@ -26,6 +31,11 @@ RGB PathTracing::specularReflection (Intersection isect, BRDF *f, int depth) {
 
     specular.adjustOrigin(isect.gn);
     specular.propagating_eta = isect.incident_eta;  // same medium
+    specular.throughput = isect.throughput * f->Ks;
+    specular.after_diffuse = isect.after_diffuse;
+    // a mirror keeps the cone (surfaces are flat: no curvature term)
+    specular.cone_width = isect.cone_width;
+    specular.cone_spread = isect.cone_spread;
 
     // OK, we have the ray : trace and shade it recursively
     bool intersected;
@@ -83,6 +93,10 @@ RGB PathTracing::specularTransmission (Intersection isect, BRDF *f, int depth) {
     refraction.adjustOrigin(-1. * isect.gn);
     
     refraction.propagating_eta = (cannot_refract ? isect.incident_eta : new_eta);
+    refraction.throughput = isect.throughput * f->Kt;
+    refraction.after_diffuse = isect.after_diffuse;
+    refraction.cone_width = isect.cone_width;
+    refraction.cone_spread = isect.cone_spread;
 
     // OK, we have the ray : trace and shade it recursively
     bool intersected;
@@ -96,10 +110,68 @@ RGB PathTracing::specularTransmission (Intersection isect, BRDF *f, int depth) {
     return color;
 }
 
-RGB PathTracing::diffuseReflection (Intersection isect, BRDF *f, int depth) {
+RGB PathTracing::glossyScattering (Intersection isect, GGX *f, int depth) {
+    RGB color(0.,0.,0.);
+
+    // sample the visible microfacet normals in the shading frame
+    float rnd[3];
+    rnd[0] = U_dist(rng);
+    rnd[1] = U_dist(rng);
+    rnd[2] = U_dist(rng);
+
+    // the shading normal faces wi: point it inwards when leaving the object
+    // (same assumption as specularTransmission: incident_eta is 1 outside)
+    bool const inside = (isect.incident_eta != 1.0f);
+    Vector const N = (inside ? -1.f * isect.sn : isect.sn);
+    Vector const wi = WorldToLocal(isect.wo, N);
+    Vector wo;
+    float pdf;
+    RGB fr = f->Sample_f(wi, rnd, &wo, pdf);
+    if (pdf <= 0.f || fr.isZero()) return color;
+
+    bool const transmission = (wi.Z * wo.Z < 0.f);
+    Vector dir = LocalToWorld(wo, N);
+    dir.normalize();
+    Ray glossy(isect.p, dir, (transmission ? GLOSS_TRANS : GLOSS_REFL));
+
+    glossy.pix_x = isect.pix_x;
+    glossy.pix_y = isect.pix_y;
+
+    glossy.FaceID = isect.FaceID;
+
+    glossy.adjustOrigin(isect.gn);
+    glossy.propagating_eta = (transmission ? (inside ? 1.f : f->eta) : isect.incident_eta);
+    glossy.throughput = isect.throughput * fr * (fabsf(wo.Z) / pdf);
+    // the lobe opens the cone by its roughness, up to the spread of a diffuse bounce
+    glossy.cone_width = isect.cone_width;
+    glossy.cone_spread = std::max(isect.cone_spread, std::min(f->Alpha(), DIFFUSE_CONE_SPREAD));
+
+    // OK, we have the ray : trace and shade it recursively
+    bool intersected;
+    Intersection g_isect;
+    // trace ray
+    intersected = scene->trace(glossy, &g_isect);
+
+    // shade this intersection
+    RGB Rcolor = shade (intersected, g_isect, depth+1);
+
+    color = (fr * fabsf(wo.Z) * Rcolor) / pdf;
+    return color;
+}
+
+RGB PathTracing::diffuseReflection (Intersection isect, BRDF *f, int depth, float bsdfSelect, const DTree *guide, const LightSelection &sel) {
     RGB color(0.,0.,0.);
     Vector dir;
     float pdf;
+
+    // the diffuse reflectance at isect (the texel for textured surfaces)
+    RGB Kd;
+    if (f->textured) {
+        DiffuseTexture *df = (DiffuseTexture *)f;
+        Kd = df->GetKd(isect);
+    } else {
+        Kd = f->Kd;
+    }
     
     // generate the specular ray
     
@@ -110,23 +182,34 @@ RGB PathTracing::diffuseReflection (Intersection isect, BRDF *f, int depth) {
     rnd[1] = U_dist(rng);
         
     Vector D_around_Z;
-    
-    // Sample the HemiSphere
-    // Uniform
-    //pdf = UniformHemiSphereSample (rnd, D_around_Z);
-    // Cosine Sampled
-    pdf = CosineHemiSphereSample (rnd, D_around_Z);
-
-    // independently of the sampling function
-    // the cosine of theta is always equal do D_around_Z.Z
-    
-    float const cos_theta = D_around_Z.Z;
-    // generate a coordinate system from N
-    Vector Rx, Ry;
-    isect.gn.CoordinateSystem(&Rx, &Ry);
+    float cos_theta;
+
+    if (guide != NULL && U_dist(rng) < GUIDE_FRACTION) {
+        // sample the learned incident radiance (may be below the surface)
+        dir = guide->sample(rnd);
+        cos_theta = dir.dot(isect.sn);
+        if (cos_theta <= 0.f) return color;
+    } else {
+        // Sample the HemiSphere
+        // Uniform
+        //pdf = UniformHemiSphereSample (rnd, D_around_Z);
+        // Cosine Sampled
+        pdf = CosineHemiSphereSample (rnd, D_around_Z);
+
+        // independently of the sampling function
+        // the cosine of theta is always equal do D_around_Z.Z
+
+        cos_theta = D_around_Z.Z;
+        // generate a coordinate system from N
+        Vector Rx, Ry;
+        isect.gn.CoordinateSystem(&Rx, &Ry);
 
-    // rotate sampling direction to world space
-    dir = D_around_Z.Rotate  (Rx, Ry, isect.sn);
+        // rotate sampling direction to world space
+        dir = D_around_Z.Rotate  (Rx, Ry, isect.sn);
+    }
+    // one sample MIS: the pdf of the mixture, whichever technique was used
+    if (guide != NULL) pdf = GuidedPdf(guide, dir, isect.sn);
+    if (pdf <= 0.f) return color;
 
     Ray diffuse(isect.p, dir, DIFF_REFL);
         
@@ -137,6 +220,11 @@ RGB PathTracing::diffuseReflection (Intersection isect, BRDF *f, int depth) {
     
     diffuse.adjustOrigin(isect.sn);
     diffuse.propagating_eta = isect.incident_eta;  // same medium
+    diffuse.throughput = isect.throughput * Kd * (cos_theta / pdf);
+    diffuse.after_diffuse = true;
+    // the lobe is the whole hemisphere: the cone opens to at least DIFFUSE_CONE_SPREAD
+    diffuse.cone_width = isect.cone_width;
+    diffuse.cone_spread = std::max(isect.cone_spread, DIFFUSE_CONE_SPREAD);
 
     // OK, we have the ray : trace and shade it recursively
     bool intersected;
@@ -144,11 +232,26 @@ RGB PathTracing::diffuseReflection (Intersection isect, BRDF *f, int depth) {
     // trace ray
     intersected = scene->trace(diffuse, &d_isect);
 
-    if (!d_isect.isLight) {  // if light source return 0 ; handled by direct
+    if ((intersected && d_isect.isLight) || (!intersected && scene->environment != NULL)) {
+        // light source (or the environment): weighted with MIS against the light
+        // sampling done by directLighting ; without MIS it is all handled by direct
+        if (bsdfSelect > 0.f) {
+            int const l = (intersected ? d_isect.LightID : (int)(std::find(scene->lights.begin(), scene->lights.end(), scene->environment) - scene->lights.begin()));
+            float const light_pdf = lightSelectionPdf(sel, l) * scene->lights[l]->Pdf_L(isect.p, d_isect);
+            RGB Le = shade (intersected, d_isect, depth+1);
+
+            color = (Kd * cos_theta * Le) / pdf * PowerHeuristic(bsdfSelect * pdf, light_pdf);
+            LightAOV::record(l, isect.throughput * color);
+        }
+    }
+    else {
         // shade this intersection
         RGB Rcolor = shade (intersected, d_isect, depth+1);
             
-        color = (f->Kd * cos_theta * Rcolor) / pdf ;
+        color = (Kd * cos_theta * Rcolor) / pdf ;
+        // the guide learns the radiance reflected towards isect ; the emitters are
+        // left to the light sampling
+        if (guiding != NULL) guiding->record(isect.p, dir, Rcolor.Y() / pdf);
     }
     return color;
 
@@ -157,65 +260,181 @@ RGB PathTracing::diffuseReflection (Intersection isect, BRDF *f, int depth) {
 RGB PathTracing::shade(bool intersected, Intersection isect, int depth) {
     RGB color(0.,0.,0.);
     
-    // if no intersection, return background
+    // if no intersection, return the environment or the background
+    // (the emitters hit by diffuse rays are weighted, and recorded in the AOVs, by diffuseReflection)
     if (!intersected) {
+        if (scene->environment != NULL) {
+            RGB Le = ((EnvironmentLight *)scene->environment)->Le(-1.f * isect.wo);
+            if (isect.r_type != DIFF_REFL) {
+                int const l = (int)(std::find(scene->lights.begin(), scene->lights.end(), scene->environment) - scene->lights.begin());
+                LightAOV::record(l, isect.throughput * Le);
+            }
+            return Le;
+        }
         return (background);
     }
     if (isect.isLight) { // intersection with a light source
+        // diffuse, specular chain, area light: a caustic, given by the photon map
+        if (caustics != NULL && isect.after_diffuse && (isect.r_type == SPEC_REFL || isect.r_type == SPEC_TRANS)
+            && (scene->lights[isect.LightID]->type == AREA_LIGHT || scene->lights[isect.LightID]->type == QUAD_AREA_LIGHT)) {
+            return RGB();
+        }
+        if (isect.r_type != DIFF_REFL) LightAOV::record(isect.LightID, isect.throughput * isect.Le);
         return isect.Le;
     }
     // get the BRDF
     BRDF *f = isect.f;
+
+    // the outgoing radiance of diffuse surfaces is view independent: it can be cached
+    bool const cacheable = (radiance_cache != NULL && f->Ks.isZero() && f->Kt.isZero() && !f->glossy);
+    if (cacheable && depth >= rcache_bounces) {
+        RGB L;
+        if (radiance_cache->lookup(isect.p, isect.sn, isect.r_type == DIFF_REFL, L)) return L;
+    }
     
-    // Russian Roullette
-    #define MIN_DEPTH 1
-    #define P_CONTINUE 0.2f
+    // the diffuse reflectance at isect (the texel for textured surfaces)
+    RGB Kd = f->Kd;
+    if (f->textured && !f->Kd.isZero()) {
+        DiffuseTexture *df = (DiffuseTexture *)f;
+        Kd = df->GetKd(isect);
+    }
+
+    float pdf[3], sum, cdf[3];
+
+    // the diffuse lobe is selected with the reflectance of the texel
+    pdf[0] = f->Ks.Y();
+    pdf[1] = f->Kt.Y();
+    pdf[2] = Kd.Y();
+
+    sum = pdf[0] + pdf[1] + pdf[2];
+    // a black texel on a diffuse only surface: nothing is reflected, any lobe will do
+    if (sum <= 0.f) pdf[2] = sum = 1.f;
+    pdf[0] /= sum;
+    pdf[1] /= sum;
+    pdf[2] /= sum;
+
+    cdf[0] = pdf[0];
+    cdf[1] = cdf[0] + pdf[1];
+    cdf[2] = cdf[1] + pdf[2];
+
+    // Russian Roullette (q < 1) or splitting (n_split > 1)
+    float q;
+    int n_split;
+    continuation (isect, depth, q, n_split);
+
+    // expected number of diffuse BRDF samples at this point (for MIS)
+    float bsdfSelect = 0.f;
+    if (mis && !f->Kd.isZero() && isect.r_type != DIFF_REFL) {
+        bsdfSelect = pdf[2] * q * n_split;
+    }
+
+    // the learned incident radiance at the diffuse vertices (path guiding)
+    DTree const *guide = NULL;
+    if (guiding != NULL && !f->Kd.isZero() && isect.r_type != DIFF_REFL) {
+        guide = guiding->find(isect.p);
+    }
+
+    // the light selection pmf, shared by the light sampling and the MIS weights
+    // of the emitters hit by the diffuse rays
+    LightSelection sel;
+    if (!f->Kd.isZero()) lightSelection(scene, isect, light_sampler, light_cache, sel);
+
     float cont=U_dist(rng);
-    if (depth<MIN_DEPTH || cont < P_CONTINUE) {
+    if (cont < q) {
+        // throughput of the continuing paths (before the BRDF)
+        RGB throughput = isect.throughput;
+        float const scale = 1.f / (q * n_split);
 
-        float pdf[3], sum, cdf[3];
-        
-        pdf[0] = f->Ks.Y();
-        pdf[1] = f->Kt.Y();
-        pdf[2] = f->Kd.Y();
-        
-        sum = pdf[0] + pdf[1] + pdf[2];
-        pdf[0] /= sum;
-        pdf[1] /= sum;
-        pdf[2] /= sum;
-
-        cdf[0] = pdf[0];
-        cdf[1] = cdf[0] + pdf[1];
-        cdf[2] = cdf[1] + pdf[2];
-        
-        float const rnd = U_dist(rng);
-        
-            // if there is a specular component sample it
-        if (!f->Ks.isZero() && rnd < cdf[0]) {
-            RGB c_aux;
-            c_aux = specularReflection (isect, f, depth);
-            c_aux /= pdf[0];
-            color += c_aux;
-        }
-            // if there is a specular component sample it
-        else if (!f->Kt.isZero() &&  rnd < cdf[1]) {
-            RGB c_aux;
-            c_aux = specularTransmission (isect, f, depth);
-            c_aux /= pdf[1];
-            color += c_aux;
-        }
-            // if there is a diffuse component sample it
-            // do one bounce (do not recurse on indirect diffuse)
-        else if (!f->Kd.isZero() && isect.r_type != DIFF_REFL) {
-            RGB c_aux;
-            c_aux = diffuseReflection (isect, f, depth);
-            c_aux /= pdf[2];
+        for (int split=0 ; split < n_split ; split++) {
+            float const rnd = U_dist(rng);
+            RGB c_aux(0.,0.,0.);
+
+                // GGX: Ks and Kt are a single rough lobe
+            if (f->glossy && rnd < cdf[1]) {
+                isect.throughput = throughput * (scale / (pdf[0] + pdf[1]));
+                c_aux = glossyScattering (isect, (GGX *)f, depth);
+                c_aux /= (pdf[0] + pdf[1]);
+            }
+                // if there is a specular component sample it
+            else if (!f->Ks.isZero() && rnd < cdf[0]) {
+                isect.throughput = throughput * (scale / pdf[0]);
+                c_aux = specularReflection (isect, f, depth);
+                c_aux /= pdf[0];
+            }
+                // if there is a specular component sample it
+            else if (!f->Kt.isZero() &&  rnd < cdf[1]) {
+                isect.throughput = throughput * (scale / pdf[1]);
+                c_aux = specularTransmission (isect, f, depth);
+                c_aux /= pdf[1];
+            }
+                // if there is a diffuse component sample it
+                // do one bounce (do not recurse on indirect diffuse)
+            else if (!f->Kd.isZero() && isect.r_type != DIFF_REFL) {
+                isect.throughput = throughput * (scale / pdf[2]);
+                c_aux = diffuseReflection (isect, f, depth, bsdfSelect, guide, sel);
+                c_aux /= pdf[2];
+            }
             color += c_aux;
         }
-        if (depth>=MIN_DEPTH) color /= P_CONTINUE;
+        color *= scale;
+        isect.throughput = throughput;
     }
     if (!f->Kd.isZero()) {
-        color += directLighting(scene, isect, f, rng, U_dist, light_sampler);
+        color += directLighting(scene, isect, f, rng, U_dist, light_sampler, light_cache, reservoirs, bsdfSelect, guide, &sel);
+        if (caustics != NULL) color += Kd * caustics->irradiance(isect.p, isect.sn);
+    }
+    if (cacheable) {
+        radiance_cache->update(isect.p, isect.sn, isect.r_type == DIFF_REFL, color);
+    }
+    if (rr_mode == RR_ADAPTIVE) {
+        float const Y = color.Y();
+        if (depth == 0) {
+            // the pixel estimate ; primary rays that miss or hit a light do not get here
+            if (!pixel_sum.empty()) {
+                int const p = isect.pix_y * W + isect.pix_x;
+                pixel_sum[p] += Y;
+                pixel_count[p] += 1.f;
+            }
+            image_sum += Y;
+            image_count += 1.;
+        } else {
+            radiance_sum += Y;
+            radiance_count += 1.;
+        }
     }
     return color;
 };
+
+float PathTracing::pixelEstimate (const int x, const int y) const {
+    if (!pixel_sum.empty() && x >= 0 && y >= 0 && x < W && y < H) {
+        int const p = y * W + x;
+        if (pixel_count[p] > 0.f && pixel_sum[p] > 0.f) return pixel_sum[p] / pixel_count[p];
+    }
+    return (image_count > 0. ? (float)(image_sum / image_count) : 0.f);
+}
+
+void PathTracing::continuation (Intersection &isect, const int depth, float &q, int &n_split) {
+    #define MIN_DEPTH 1
+    #define P_CONTINUE 0.2f
+    q = 1.f;
+    n_split = 1;
+    if (rr_mode == RR_FIXED || depth >= RR_MAX_DEPTH) {
+        if (depth >= MIN_DEPTH) q = P_CONTINUE;
+        return;
+    }
+    // expected contribution of a path continuing from here relative to the pixel
+    // value, kept within the weight window [lower, rr_window * lower] centered on 1
+    float const I = pixelEstimate(isect.pix_x, isect.pix_y);
+    float const Lr = (radiance_count > 0. ? (float)(radiance_sum / radiance_count) : 0.f);
+    if (I <= 0.f || Lr <= 0.f) {     // no estimates yet
+        if (depth >= MIN_DEPTH) q = P_CONTINUE;
+        return;
+    }
+    float const ratio = isect.throughput.Y() * Lr / I;
+    float const lower = 2.f / (1.f + rr_window), upper = rr_window * lower;
+    if (ratio < lower) {
+        q = std::max(RR_MIN_SURVIVAL, ratio / lower);
+    } else if (ratio > upper && depth < RR_MAX_SPLIT_DEPTH) {
+        n_split = std::min(rr_max_split, (int)ceilf(ratio / upper));
+    }
+}
@@ -10,25 +10,117 @@
 
 #include "shader.hpp"
 #include "BRDF.hpp"
+#include "GGX.hpp"
 #include "directLighting.hpp"
+#include "PathGuiding.hpp"
+#include "RadianceCache.hpp"
+#include "PhotonMap.hpp"
+#include "RNG.hpp"
 #include <random>
+#include <vector>
+
+typedef enum {
+    RR_FIXED,       // continue with probability P_CONTINUE after MIN_DEPTH
+    RR_ADAPTIVE     // weight window on the path throughput (ADRRS): roulette or split
+} RR_MODE;
+
+// adaptive roulette: survival probability is never below this
+#define RR_MIN_SURVIVAL 0.05f
+// adaptive roulette: paths are split only at the first vertices, and the fixed
+// roulette takes over on long paths (materials with Ks+Kt > 1 gain throughput)
+#define RR_MAX_SPLIT_DEPTH 3
+#define RR_MAX_DEPTH 16
 
 class PathTracing: public Shader {
     RGB background;
-    RGB diffuseReflection (Intersection isect, BRDF *f, int depth);
+    // bsdfSelect: probability with which shade samples the diffuse BRDF (0: no MIS)
+    // guide: if not NULL the direction is sampled from its mixture with the cosine lobe
+    // sel: the light selection at isect (MIS weights of the emitters hit)
+    RGB diffuseReflection (Intersection isect, BRDF *f, int depth, float bsdfSelect, const DTree *guide, const LightSelection &sel);
     RGB specularReflection (Intersection isect, BRDF *f, int depth);
     RGB specularTransmission (Intersection isect, BRDF *f, int depth);
+    // GGX reflection (and transmission for dielectrics)
+    RGB glossyScattering (Intersection isect, GGX *f, int depth);
     /****************************************
      
      Our Random Number Generator (rng) */
     std::random_device rdev{};
-    std::mt19937 rng{rdev()};
+    RNG rng{rdev()};
     std::uniform_real_distribution<float>U_dist{0.0,1.0};  // uniform distribution in[0,1[
 
     DIRECT_SAMPLE_MODE light_sampler;
+    LightCache *light_cache;   // only for LIGHT_CACHE_ONE
+    ReservoirBuffer *reservoirs;  // only for RESTIR_ONE
+    // combine BRDF sampled hits on the lights with the light sampling (MIS) ;
+    // not possible with RIS_ONE and RESTIR_ONE (no closed form light selection pdf)
+    bool mis;
+    // Russian roulette and splitting
+    // Vorba and Krivanek, "Adjoint-driven Russian roulette and splitting in light
+    // transport simulation", SIGGRAPH 2016. Without an adjoint (radiance) cache the
+    // radiance reaching a vertex is approximated by the running mean of the
+    // radiance carried by the secondary rays
+    RR_MODE rr_mode;
+    float rr_window;        // ratio between the upper and lower bounds of the weight window
+    int rr_max_split;       // maximum number of paths a vertex is split into
+    std::vector<float> pixel_sum, pixel_count;  // running pixel estimates (luminance)
+    double image_sum, image_count;              // and for the whole image
+    double radiance_sum, radiance_count;        // radiance carried by secondary rays
+    int W, H;
+    GuidingField *guiding;  // NULL without path guiding
+    RadianceCache *radiance_cache;  // NULL without the radiance cache
+    int rcache_bounces;     // vertices this deep read the radiance cache
+    // caustics (L S+ D paths) ; NULL: found by the diffuse rays hitting lights through specular chains
+    PhotonMap *caustics;
+    float pixelEstimate (const int x, const int y) const;
+    // number of paths continuing from isect: splits (>1), or roulette survival probability q (<1)
+    void continuation (Intersection &isect, const int depth, float &q, int &n_split);
 public:
-    PathTracing(Scene *scene, RGB bg, DIRECT_SAMPLE_MODE light_sampler): background(bg), Shader(scene),
-                                                                         light_sampler(light_sampler) {
+    // the image resolution (W, H) is required by RESTIR_ONE to keep one reservoir per pixel
+    PathTracing(Scene *scene, RGB bg, DIRECT_SAMPLE_MODE light_sampler, const int W=0, const int H=0): background(bg), Shader(scene),
+                                                                         light_sampler(light_sampler), W(W), H(H), guiding(NULL), radiance_cache(NULL), rcache_bounces(0), caustics(NULL) {
+        light_cache = (light_sampler == LIGHT_CACHE_ONE ? new LightCache(scene) : NULL);
+        reservoirs = (light_sampler == RESTIR_ONE && W > 0 && H > 0 ? new ReservoirBuffer(W, H) : NULL);
+        mis = (light_sampler != RIS_ONE && light_sampler != RESTIR_ONE);
+        SetRussianRoulette(RR_FIXED);
+    }
+    ~PathTracing() {
+        if (light_cache != NULL) delete light_cache;
+        if (reservoirs != NULL) delete reservoirs;
+        if (guiding != NULL) delete guiding;
+        if (radiance_cache != NULL) delete radiance_cache;
+        if (caustics != NULL) delete caustics;
+    }
+    // window: upper / lower bound of the weight window (> 1) ; max_split >= 1
+    void SetRussianRoulette (const RR_MODE mode, const float window=5.f, const int max_split=4) {
+        rr_mode = mode;
+        rr_window = (window > 1.f ? window : 1.f);
+        rr_max_split = (max_split > 1 ? max_split : 1);
+        pixel_sum.assign(W * H, 0.f);
+        pixel_count.assign(W * H, 0.f);
+        image_sum = image_count = radiance_sum = radiance_count = 0.;
+    }
+    // learn the incident radiance at the diffuse vertices and guide the diffuse
+    // bounces with it ; requires a renderer with several passes
+    void SetPathGuiding (const bool on) {
+        if (guiding != NULL) delete guiding;
+        guiding = (on ? new GuidingField(scene) : NULL);
+    }
+    // diffuse vertices at depth >= bounces return the radiance cached around them
+    // (when there is enough) instead of being shaded ; bounces < 1 disables the cache
+    // resolution: cells along the largest dimension of the scene
+    void SetRadianceCache (const int bounces, const int resolution=64) {
+        if (radiance_cache != NULL) delete radiance_cache;
+        radiance_cache = (bounces > 0 ? new RadianceCache(scene, resolution) : NULL);
+        rcache_bounces = bounces;
+    }
+    // emit photons from the lights and estimate the caustics at the diffuse vertices
+    // from the K nearest ones (within radius) ; photons = 0 disables the photon map
+    void SetCausticPhotons (const int photons, const int K=64, const float radius=0.f) {
+        if (caustics != NULL) delete caustics;
+        caustics = (photons > 0 ? new PhotonMap(scene, photons, K, radius) : NULL);
+    }
+    void EndPass (void) {
+        if (guiding != NULL) guiding->EndPass();
     }
     RGB shade (bool intersected, Intersection isect, int depth);
 };
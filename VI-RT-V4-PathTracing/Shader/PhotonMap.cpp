@@ -0,0 +1,151 @@
+//
+//  PhotonMap.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "PhotonMap.hpp"
+
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <math.h>
+
+#include "LightPaths.hpp"
+
+static float coord (const Point &p, const int axis) {
+    return (axis == 0 ? p.X : (axis == 1 ? p.Y : p.Z));
+}
+
+// number of nodes in the left subtree of a left balanced tree with n nodes
+static int leftCount (const int n) {
+    if (n <= 1) return 0;
+    int h = 0;      // floor (log2 (n))
+    while ((2 << h) <= n) h++;
+    int const full = (1 << h) - 1;      // nodes above the last level
+    int const last = n - full;          // nodes in the last level
+    return (full - 1) / 2 + std::min(last, 1 << (h - 1));
+}
+
+PhotonMap::PhotonMap (Scene *scene, const int N, const int _K, const float _radius): K(_K), radius(_radius) {
+    if (radius <= 0.f) {
+        Vector const diag = scene->bb.min.vec2point(scene->bb.max);
+        radius = 0.01f * std::max(diag.X, std::max(diag.Y, diag.Z));
+    }
+    // lights selected proportionally to their flux
+    std::vector<float> cdf;
+    float const total = lightFluxCdf(scene, cdf);
+    if (total <= 0.f || N <= 0) return;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> U_dist(0.f, 1.f);
+    std::vector<Photon> photons;
+    for (int i=0 ; i<N ; i++) {
+        float prob;
+        int const l = sampleLightFlux(cdf, total, U_dist(rng), prob);
+        if (prob <= 0.f) continue;
+        float r[2] = {U_dist(rng), U_dist(rng)};
+        float d[2] = {U_dist(rng), U_dist(rng)};
+        Ray photon;
+        RGB power;
+        if (!sampleEmission(scene->lights[l], r, d, photon, power)) continue;
+        trace(scene, photon, power / (N * prob), rng, U_dist, photons);
+    }
+
+    tree.resize(photons.size());
+    build(photons, 0, (int)photons.size(), 0, 0);
+}
+
+// follow a photon through the specular surfaces ; store it at the diffuse ones reached after them
+void PhotonMap::trace (Scene *scene, Ray r, RGB power, std::mt19937 &rng, std::uniform_real_distribution<float> &U_dist, std::vector<Photon> &store) {
+    bool specular = false;
+    for (int depth=0 ; depth < PHOTON_MAX_DEPTH ; depth++) {
+        Intersection isect;
+        if (!scene->trace(r, &isect) || isect.isLight) return;
+        BRDF *f = isect.f;
+        if (!f->Kd.isZero() && specular) {
+            Photon ph;
+            ph.p = isect.p;
+            ph.power = power;
+            ph.wi = -1.f * r.dir;
+            ph.wi.normalize();
+            ph.axis = 0;
+            store.push_back(ph);
+        }
+        if (f->glossy) return;
+        // continue with a specular reflection or transmission with probability of its albedo
+        Ray next;
+        RGB weight;
+        if (!specularBounce(isect, U_dist(rng), next, weight)) return;
+        power = power * weight;
+        r = next;
+        specular = true;
+    }
+}
+
+// photons[lo, hi[ become the subtree rooted at node
+void PhotonMap::build (std::vector<Photon> &photons, const int lo, const int hi, const int node, const int level) {
+    if (lo >= hi) return;
+    // split along the largest extent
+    Point bmin = photons[lo].p, bmax = photons[lo].p;
+    for (int i=lo+1 ; i<hi ; i++) {
+        Point const &p = photons[i].p;
+        bmin.X = std::min(bmin.X, p.X); bmax.X = std::max(bmax.X, p.X);
+        bmin.Y = std::min(bmin.Y, p.Y); bmax.Y = std::max(bmax.Y, p.Y);
+        bmin.Z = std::min(bmin.Z, p.Z); bmax.Z = std::max(bmax.Z, p.Z);
+    }
+    Vector const ext = bmin.vec2point(bmax);
+    int const axis = (ext.X >= ext.Y && ext.X >= ext.Z ? 0 : (ext.Y >= ext.Z ? 1 : 2));
+    int const m = lo + leftCount(hi - lo);
+    std::nth_element(photons.begin() + lo, photons.begin() + m, photons.begin() + hi,
+                     [axis] (const Photon &a, const Photon &b) { return coord(a.p, axis) < coord(b.p, axis); });
+    tree[node] = photons[m];
+    tree[node].axis = axis;
+    // both subtrees use disjoint ranges of photons and of the tree
+    if (level < PHOTON_PARALLEL_LEVELS && hi - lo > 4096) {
+        std::thread left(&PhotonMap::build, this, std::ref(photons), lo, m, 2 * node + 1, level + 1);
+        build(photons, m + 1, hi, 2 * node + 2, level + 1);
+        left.join();
+    } else {
+        build(photons, lo, m, 2 * node + 1, level + 1);
+        build(photons, m + 1, hi, 2 * node + 2, level + 1);
+    }
+}
+
+// adds the photons of the subtree at node closer than sqrt(r2) to heap ; once it holds K
+// photons r2 shrinks to the distance of the farthest one
+void PhotonMap::locate (const Point &p, const int node, float &r2, std::vector<Neighbour> &heap) const {
+    if (node >= (int)tree.size()) return;
+    Photon const &ph = tree[node];
+    float const d = coord(p, ph.axis) - coord(ph.p, ph.axis);
+    // the side of the splitting plane containing p first
+    locate(p, (d < 0.f ? 2 * node + 1 : 2 * node + 2), r2, heap);
+    if (d * d < r2) locate(p, (d < 0.f ? 2 * node + 2 : 2 * node + 1), r2, heap);
+    float const dx = p.X - ph.p.X, dy = p.Y - ph.p.Y, dz = p.Z - ph.p.Z;
+    float const d2 = dx * dx + dy * dy + dz * dz;
+    if (d2 < r2) {
+        Neighbour const nb = {d2, node};
+        heap.push_back(nb);
+        std::push_heap(heap.begin(), heap.end());
+        if ((int)heap.size() > K) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.pop_back();
+        }
+        if ((int)heap.size() == K) r2 = heap.front().d2;
+    }
+}
+
+RGB PhotonMap::irradiance (const Point &p, const Vector &n) const {
+    RGB E(0., 0., 0.);
+    if (tree.empty()) return E;
+    // scratch buffer reused across calls
+    static thread_local std::vector<Neighbour> heap;
+    heap.clear();
+    float r2 = radius * radius;
+    locate(p, 0, r2, heap);
+    if (heap.empty()) return E;
+    for (const Neighbour &nb : heap) {
+        Photon const &ph = tree[nb.index];
+        if (ph.wi.dot(n) > 0.f) E += ph.power;
+    }
+    return E / (M_PI * r2);
+}
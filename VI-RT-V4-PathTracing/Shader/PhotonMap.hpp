@@ -0,0 +1,60 @@
+//
+//  PhotonMap.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Caustic photon map (Jensen, "Realistic image synthesis using photon
+//  mapping", 2001). Photons are emitted from the point and area lights
+//  (AREA_LIGHT, QUAD_AREA_LIGHT) proportionally to their power, followed
+//  through specular reflections and transmissions and stored when they
+//  reach a diffuse surface after at least one of them (L S+ D paths).
+//  The photons are kept in a left balanced kd-tree stored as an implicit
+//  heap (children of i at 2i+1 and 2i+2): no pointers, and the top of the
+//  tree, visited by every query, is contiguous in memory. The subtrees are
+//  built in parallel.
+//  The BRDF value of diffuse surfaces is Kd, as in directLighting.
+//
+
+#ifndef PhotonMap_hpp
+#define PhotonMap_hpp
+
+#include <vector>
+#include <random>
+#include "vector.hpp"
+#include "RGB.hpp"
+#include "scene.hpp"
+
+// maximum number of bounces of a photon
+#define PHOTON_MAX_DEPTH 16
+// levels of the kd-tree whose subtrees are built by separate threads (2^levels threads)
+#define PHOTON_PARALLEL_LEVELS 3
+
+class PhotonMap {
+    typedef struct Photon {
+        Point p;
+        RGB power;      // flux
+        Vector wi;      // direction towards where the photon came from
+        int axis;       // splitting axis of this kd-tree node
+    } Photon;
+    std::vector<Photon> tree;   // left balanced kd-tree (implicit heap)
+    // photons within radius of the query point, as a max-heap on the distance (d2, index)
+    typedef struct Neighbour {
+        float d2;
+        int index;
+        bool operator< (const Neighbour &o) const { return d2 < o.d2; }
+    } Neighbour;
+    void build (std::vector<Photon> &photons, const int lo, const int hi, const int node, const int level);
+    void locate (const Point &p, const int node, float &r2, std::vector<Neighbour> &heap) const;
+    void trace (Scene *scene, Ray r, RGB power, std::mt19937 &rng, std::uniform_real_distribution<float> &U_dist, std::vector<Photon> &store);
+public:
+    int K;          // photons used in each density estimate
+    float radius;   // maximum search radius
+    // emit N photons from the lights of scene and build the tree
+    // radius <= 0: 1% of the largest dimension of the scene
+    PhotonMap (Scene *scene, const int N, const int K=64, const float radius=0.f);
+    int size (void) const { return (int)tree.size(); }
+    // irradiance at p (normal n) due to the stored photons: the flux of the
+    // K nearest photons arriving from above the surface over the disk that holds them
+    RGB irradiance (const Point &p, const Vector &n) const;
+};
+
+#endif /* PhotonMap_hpp */
@@ -0,0 +1,81 @@
+//
+//  RadianceCache.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "RadianceCache.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+// never a valid key (the normal direction uses 3 bits but only goes up to 5)
+#define RCACHE_EMPTY (~0ULL)
+
+RadianceCache::RadianceCache (Scene *scene, const int resolution): cells(RCACHE_SIZE) {
+    Vector const diag = scene->bb.min.vec2point(scene->bb.max);
+    float const maxDim = std::max(diag.X, std::max(diag.Y, diag.Z));
+    origin = scene->bb.min;
+    cellSize = (maxDim > 0.f && resolution > 0 ? maxDim / resolution : 1.f);
+    for (Cell &c : cells) {
+        c.key.store(RCACHE_EMPTY, std::memory_order_relaxed);
+        for (int i=0 ; i<3 ; i++) c.sum[i].store(0.f, std::memory_order_relaxed);
+        c.count.store(0, std::memory_order_relaxed);
+    }
+}
+
+// 3 x 20 bits for the cell coordinates, 3 bits for the dominant axis of the normal
+// and 1 bit for vertices shaded without indirect diffuse
+unsigned long long RadianceCache::key (const Point &p, const Vector &n, const bool direct_only) const {
+    unsigned long long const ix = (unsigned long long)((int)floorf((p.X - origin.X) / cellSize) & 0xFFFFF);
+    unsigned long long const iy = (unsigned long long)((int)floorf((p.Y - origin.Y) / cellSize) & 0xFFFFF);
+    unsigned long long const iz = (unsigned long long)((int)floorf((p.Z - origin.Z) / cellSize) & 0xFFFFF);
+    Vector nn = n;
+    int const axis = nn.Abs().MaxDimension();
+    float const XYZ[3] = {n.X, n.Y, n.Z};
+    unsigned long long const dir = (unsigned long long)(2*axis + (XYZ[axis] < 0.f ? 1 : 0));
+    return (ix << 44) | (iy << 24) | (iz << 4) | (dir << 1) | (direct_only ? 1ULL : 0ULL);
+}
+
+RadianceCache::Cell *RadianceCache::find (const unsigned long long k, const bool create) {
+    // splitmix64 finalizer
+    unsigned long long h = k;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    h ^= (h >> 31);
+    for (int i=0 ; i<RCACHE_PROBES ; i++) {
+        Cell &c = cells[(h + i) & (RCACHE_SIZE - 1)];
+        unsigned long long current = c.key.load(std::memory_order_acquire);
+        if (current == k) return &c;
+        if (current == RCACHE_EMPTY) {
+            if (!create) return NULL;
+            // claim the empty cell ; another thread may have claimed it first
+            if (c.key.compare_exchange_strong(current, k, std::memory_order_acq_rel)) return &c;
+            if (current == k) return &c;
+        }
+    }
+    return NULL;
+}
+
+bool RadianceCache::lookup (const Point &p, const Vector &n, const bool direct_only, RGB &L) {
+    Cell *c = find(key(p, n, direct_only), false);
+    if (c == NULL) return false;
+    unsigned int const count = c->count.load(std::memory_order_relaxed);
+    if (count < RCACHE_MIN_SAMPLES) return false;
+    L.R = c->sum[0].load(std::memory_order_relaxed) / count;
+    L.G = c->sum[1].load(std::memory_order_relaxed) / count;
+    L.B = c->sum[2].load(std::memory_order_relaxed) / count;
+    return true;
+}
+
+void RadianceCache::update (const Point &p, const Vector &n, const bool direct_only, const RGB &L) {
+    if (!std::isfinite(L.R + L.G + L.B)) return;
+    Cell *c = find(key(p, n, direct_only), true);
+    if (c == NULL) return;
+    float const v[3] = {L.R, L.G, L.B};
+    for (int i=0 ; i<3 ; i++) {
+        // there is no atomic fetch_add for float
+        float old = c->sum[i].load(std::memory_order_relaxed);
+        while (!c->sum[i].compare_exchange_weak(old, old + v[i], std::memory_order_relaxed)) ;
+    }
+    c->count.fetch_add(1, std::memory_order_relaxed);
+}
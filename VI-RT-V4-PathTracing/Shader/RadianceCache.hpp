@@ -0,0 +1,53 @@
+//
+//  RadianceCache.hpp
+//  VI-RT-V4-PathTracing
+//
+//  World space hash grid of the outgoing radiance of diffuse surfaces.
+//  Cells are keyed by the quantized position and the dominant axis of the
+//  normal (as in LightCache) and keep a running average of the radiance
+//  returned by the shader at the vertices falling in them. Paths longer than
+//  a given number of bounces read the cell instead of being continued: a
+//  bias bounded by the cell size for much shorter paths.
+//  The table has a fixed size (open addressing, linear probing) and is updated
+//  with atomic operations only, so it can be shared by concurrent render threads.
+//
+
+#ifndef RadianceCache_hpp
+#define RadianceCache_hpp
+
+#include <atomic>
+#include <vector>
+#include "vector.hpp"
+#include "RGB.hpp"
+#include "scene.hpp"
+
+// number of cells (a power of 2)
+#define RCACHE_SIZE (1 << 18)
+// cells probed before giving up on a full table
+#define RCACHE_PROBES 8
+// samples a cell needs before it is used
+#define RCACHE_MIN_SAMPLES 16
+
+class RadianceCache {
+    typedef struct Cell {
+        std::atomic<unsigned long long> key;
+        std::atomic<float> sum[3];      // accumulated R, G, B
+        std::atomic<unsigned int> count;
+    } Cell;
+    std::vector<Cell> cells;
+    Point origin;
+    float cellSize;
+    unsigned long long key (const Point &p, const Vector &n, const bool direct_only) const;
+    // the cell of key ; inserted if create is true ; NULL if not found (or the table is full)
+    Cell *find (const unsigned long long k, const bool create);
+public:
+    // resolution: number of cells along the largest dimension of the scene
+    RadianceCache (Scene *scene, const int resolution=64);
+    // average radiance leaving the cell of (p,n) ; false if it has too few samples
+    // direct_only: the vertex is shaded without indirect diffuse (reached by a diffuse ray)
+    bool lookup (const Point &p, const Vector &n, const bool direct_only, RGB &L);
+    // add the radiance L leaving p
+    void update (const Point &p, const Vector &n, const bool direct_only, const RGB &L);
+};
+
+#endif /* RadianceCache_hpp */
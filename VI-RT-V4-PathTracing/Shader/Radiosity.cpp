@@ -0,0 +1,337 @@
+//
+//  Radiosity.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "Radiosity.hpp"
+
+#include <algorithm>
+#include <thread>
+#include <math.h>
+
+#include "ray.hpp"
+#include "triangle.hpp"
+#include "Quad.hpp"
+#include "PointLight.hpp"
+#include "AreaLight.hpp"
+#include "QuadAreaLight.hpp"
+#include "MeshLight.hpp"
+#include "DiffuseTexture.hpp"
+
+// uv_width: the patch's footprint in texture space, its Kd is the mean over it
+static RGB diffuseKd (BRDF *f, Vec2 uv, const float uv_width) {
+    if (f->textured) return ((DiffuseTexture *)f)->GetKd(uv, uv_width);
+    return f->Kd;
+}
+
+// index, within its grid, of the vertex (i,j) of a triangle split in n x n (i+j <= n)
+static int triVertex (const int n, const int i, const int j) {
+    return j * (n + 1) - j * (j - 1) / 2 + i;
+}
+
+// parametric coordinates of p in the plane of the edges e1 and e2 from o (as Quad::intersect)
+static void planeCoords (Point o, const Vector &e1, const Vector &e2, const Point &p, float &a, float &b) {
+    Vector const n = e1.cross(e2);
+    Vector const q = o.vec2point(p);
+    a = n.dot(q.cross(e2)) / n.normSQ();
+    b = n.dot(e1.cross(q)) / n.normSQ();
+}
+
+void Radiosity::subdivide (const int prim, Geometry *g, BRDF *f, const float size) {
+    Grid &grid = grids[prim];
+    grid.first = (int)vp.size();
+    Patch patch;
+    patch.emitter = -1;
+    patch.unshot[0] = patch.unshot[1] = RGB(0., 0., 0.);
+    switch (g->type) {
+        case QUAD_GEOMETRY: {
+            Quad *q = (Quad *)g;
+            int const nu = std::max(1, (int)ceilf(q->edge1.norm() / size));
+            int const nv = std::max(1, (int)ceilf(q->edge2.norm() / size));
+            grid.nu = nu;
+            grid.nv = nv;
+            for (int j=0 ; j<=nv ; j++) {
+                for (int i=0 ; i<=nu ; i++) {
+                    vp.push_back(q->point((float)i / nu, (float)j / nv));
+                    vn.push_back(q->normal);
+                }
+            }
+            patch.n = q->normal;
+            patch.area = q->area() / (nu * nv);
+            float const uv_width = sqrtf(patch.area) * q->uv_scale;
+            for (int j=0 ; j<nv ; j++) {
+                for (int i=0 ; i<nu ; i++) {
+                    float const a = (i + 0.5f) / nu, b = (j + 0.5f) / nv;
+                    patch.c = q->point(a, b);
+                    float const a1 = (1.f-a)*(1.f-b), a2 = a*(1.f-b), a3 = a*b, a4 = (1.f-a)*b;
+                    patch.Kd = diffuseKd(f, Vec2(a1 * q->uv1.u + a2 * q->uv2.u + a3 * q->uv3.u + a4 * q->uv4.u,
+                                                 a1 * q->uv1.v + a2 * q->uv2.v + a3 * q->uv3.v + a4 * q->uv4.v), uv_width);
+                    int const v0 = grid.first + j * (nu + 1) + i;
+                    patch.v[0] = v0;
+                    patch.v[1] = v0 + 1;
+                    patch.v[2] = v0 + nu + 2;
+                    patch.v[3] = v0 + nu + 1;
+                    patches.push_back(patch);
+                }
+            }
+            break;
+        }
+        case TRIANGLE_GEOMETRY: {
+            Triangle *t = (Triangle *)g;
+            float const longest = std::max(t->edge1.norm(), std::max(t->edge2.norm(), t->edge3.norm()));
+            int const n = std::max(1, (int)ceilf(longest / size));
+            grid.nu = grid.nv = n;
+            for (int j=0 ; j<=n ; j++) {
+                for (int i=0 ; i<=n-j ; i++) {
+                    vp.push_back(t->v1 + t->edge1 * ((float)i / n) + t->edge2 * ((float)j / n));
+                    vn.push_back(t->normal);
+                }
+            }
+            patch.n = t->normal;
+            patch.area = t->area() / (n * n);
+            float const uv_width = sqrtf(patch.area) * t->uv_scale;
+            patch.v[3] = -1;
+            for (int j=0 ; j<n ; j++) {
+                for (int i=0 ; i<n-j ; i++) {
+                    // the triangle pointing up and, but on the diagonal, the one pointing down
+                    for (int down=0 ; down<2 ; down++) {
+                        if (down && i + j == n - 1) break;
+                        float const a = (i + (down ? 2.f : 1.f) / 3.f) / n, b = (j + (down ? 2.f : 1.f) / 3.f) / n;
+                        patch.c = t->v1 + t->edge1 * a + t->edge2 * b;
+                        patch.Kd = diffuseKd(f, Vec2((1.f-a-b) * t->uv1.u + a * t->uv2.u + b * t->uv3.u,
+                                                     (1.f-a-b) * t->uv1.v + a * t->uv2.v + b * t->uv3.v), uv_width);
+                        if (!down) {
+                            patch.v[0] = grid.first + triVertex(n, i, j);
+                            patch.v[1] = grid.first + triVertex(n, i+1, j);
+                            patch.v[2] = grid.first + triVertex(n, i, j+1);
+                        } else {
+                            patch.v[0] = grid.first + triVertex(n, i+1, j);
+                            patch.v[1] = grid.first + triVertex(n, i+1, j+1);
+                            patch.v[2] = grid.first + triVertex(n, i, j+1);
+                        }
+                        patches.push_back(patch);
+                    }
+                }
+            }
+            break;
+        }
+        default:    // not subdivided
+            grid.first = -1;
+            break;
+    }
+}
+
+// the emitters shoot their radiance from the front side only, so they need no vertices
+void Radiosity::addEmitter (const int l, const float size) {
+    Light *light = scene->lights[l];
+    Patch patch;
+    patch.emitter = l;
+    patch.unshot[1] = RGB(0., 0., 0.);
+    patch.v[0] = patch.v[1] = patch.v[2] = patch.v[3] = -1;
+    // a triangle split in n x n, shooting Le
+    auto triangle = [&] (Triangle *t, RGB Le) {
+        float const longest = std::max(t->edge1.norm(), std::max(t->edge2.norm(), t->edge3.norm()));
+        int const n = std::max(RADIOSITY_MIN_EMITTER_SUBDIV, (int)ceilf(longest / size));
+        patch.n = t->normal;
+        patch.area = t->area() / (n * n);
+        patch.unshot[0] = Le;
+        for (int j=0 ; j<n ; j++) {
+            for (int i=0 ; i<n-j ; i++) {
+                for (int down=0 ; down<2 && !(down && i + j == n - 1) ; down++) {
+                    float const a = (i + (down ? 2.f : 1.f) / 3.f) / n, b = (j + (down ? 2.f : 1.f) / 3.f) / n;
+                    patch.c = t->v1 + t->edge1 * a + t->edge2 * b;
+                    patches.push_back(patch);
+                }
+            }
+        }
+    };
+    switch (light->type) {
+        case AREA_LIGHT: {
+            AreaLight *al = (AreaLight *)light;
+            triangle(al->gem, al->intensity);
+            break;
+        }
+        case MESH_LIGHT: {
+            MeshLight *ml = (MeshLight *)light;
+            for (int t=0 ; t<(int)ml->tris.size() ; t++) triangle(ml->tris[t], ml->radiance[t]);
+            break;
+        }
+        case QUAD_AREA_LIGHT: {
+            QuadAreaLight *ql = (QuadAreaLight *)light;
+            Quad *q = ql->gem;
+            int const nu = std::max(RADIOSITY_MIN_EMITTER_SUBDIV, (int)ceilf(q->edge1.norm() / size));
+            int const nv = std::max(RADIOSITY_MIN_EMITTER_SUBDIV, (int)ceilf(q->edge2.norm() / size));
+            patch.n = q->normal;
+            patch.area = q->area() / (nu * nv);
+            patch.unshot[0] = ql->intensity;
+            for (int j=0 ; j<nv ; j++) {
+                for (int i=0 ; i<nu ; i++) {
+                    patch.c = q->point((i + 0.5f) / nu, (j + 0.5f) / nv);
+                    patches.push_back(patch);
+                }
+            }
+            break;
+        }
+        default:    // point lights shoot directly ; ambient and environment lights are ignored
+            break;
+    }
+}
+
+void Radiosity::shoot (const std::vector<int> &shooters, std::vector<RGB> *dE) {
+    int const n_threads = std::max(1u, std::thread::hardware_concurrency());
+    int const V = (int)vp.size();
+    std::vector<std::thread> workers;
+    for (int t=0 ; t<n_threads ; t++) {
+        workers.push_back(std::thread([&, t] () {
+            for (int v=t ; v<V ; v+=n_threads) {
+                Point p = vp[v];
+                for (int const s : shooters) {
+                    Patch const &sh = patches[s];
+                    Vector dir = p.vec2point(sh.c);
+                    float const dist2 = dir.normSQ();
+                    if (dist2 <= 0.f) continue;
+                    float const dist = sqrtf(dist2);
+                    dir = dir / dist;
+                    float const cos_v = vn[v].dot(dir);
+                    float const cos_s = -1.f * sh.n.dot(dir);
+                    int const side_s = (cos_s > 0.f ? 0 : 1);
+                    if (cos_v == 0.f || cos_s == 0.f || sh.unshot[side_s].isZero()) continue;
+                    int const side_v = (cos_v > 0.f ? 0 : 1);
+                    // vertex to disk form factor (times PI: irradiance from radiance)
+                    float const F = fabsf(cos_v * cos_s) * sh.area / (dist2 + sh.area / M_PI);
+                    Ray shadow(p, dir, SHADOW);
+                    shadow.adjustOrigin(side_v == 0 ? vn[v] : -1.f * vn[v]);
+                    if (!scene->visibility(shadow, dist * 0.999f)) continue;
+                    RGB L = sh.unshot[side_s];
+                    dE[side_v][v] += L * F;
+                }
+            }
+        }));
+    }
+    for (std::thread &w : workers) w.join();
+}
+
+void Radiosity::shootPointLights (std::vector<RGB> *dE) {
+    for (int l=0 ; l<scene->numLights ; l++) {
+        if (scene->lights[l]->type != POINT_LIGHT) continue;
+        PointLight *pl = (PointLight *)scene->lights[l];
+        for (int v=0 ; v<(int)vp.size() ; v++) {
+            Vector dir = vp[v].vec2point(pl->pos);
+            float const dist2 = dir.normSQ();
+            if (dist2 <= 0.f) continue;
+            float const dist = sqrtf(dist2);
+            dir = dir / dist;
+            float const cos_v = vn[v].dot(dir);
+            if (cos_v == 0.f) continue;
+            int const side_v = (cos_v > 0.f ? 0 : 1);
+            Ray shadow(vp[v], dir, SHADOW);
+            shadow.adjustOrigin(side_v == 0 ? vn[v] : -1.f * vn[v]);
+            if (!scene->visibility(shadow, dist - EPSILON)) continue;
+            RGB I = pl->color;
+            dE[side_v][v] += I * (fabsf(cos_v) / dist2);
+        }
+    }
+}
+
+Radiosity::Radiosity (Scene *_scene, const int res, const int bounces, const float threshold): scene(_scene), shot(0) {
+    Vector const diag = scene->bb.min.vec2point(scene->bb.max);
+    float const size = std::max(diag.X, std::max(diag.Y, diag.Z)) / std::max(res, 1);
+    grids.resize(scene->numPrimitives);
+    for (int p=0 ; p<scene->numPrimitives ; p++) {
+        Primitive *prim = scene->GetPrimitive(p);
+        subdivide(p, prim->g, scene->GetMaterial(prim->material_ndx), size);
+    }
+    int const surfaces = (int)patches.size();
+    for (int l=0 ; l<scene->numLights ; l++) addEmitter(l, size);
+    int const V = (int)vp.size();
+    std::vector<RGB> dE[2];
+    for (int s=0 ; s<2 ; s++) {
+        E[s].assign(V, RGB(0., 0., 0.));
+        dE[s].assign(V, RGB(0., 0., 0.));
+    }
+
+    // the lights shoot first
+    std::vector<int> shooters;
+    for (int p=surfaces ; p<(int)patches.size() ; p++) shooters.push_back(p);
+    shootPointLights(dE);
+    shoot(shooters, dE);
+    shot += (int)shooters.size();
+
+    for (int b=0 ; ; b++) {
+        for (int s=0 ; s<2 ; s++) {
+            for (int v=0 ; v<V ; v++) E[s][v] += dE[s][v];
+        }
+        if (b >= bounces) break;
+        // each patch reflects the average irradiance its vertices just received
+        std::vector<float> power(surfaces, 0.f);
+        float total = 0.f;
+        for (int p=0 ; p<surfaces ; p++) {
+            Patch &patch = patches[p];
+            int const nv = (patch.v[3] < 0 ? 3 : 4);
+            for (int s=0 ; s<2 ; s++) {
+                RGB sum(0., 0., 0.);
+                for (int k=0 ; k<nv ; k++) sum += dE[s][patch.v[k]];
+                patch.unshot[s] = patch.Kd * sum / (float)nv;
+                power[p] += patch.unshot[s].Y() * patch.area;
+            }
+            total += power[p];
+        }
+        for (int s=0 ; s<2 ; s++) dE[s].assign(V, RGB(0., 0., 0.));
+        // largest unshot power first, until what is left is below the threshold
+        shooters.clear();
+        for (int p=0 ; p<surfaces ; p++) {
+            if (power[p] > 0.f) shooters.push_back(p);
+        }
+        std::sort(shooters.begin(), shooters.end(), [&] (const int a, const int c) { return power[a] > power[c]; });
+        float left = total;
+        int n = 0;
+        while (n < (int)shooters.size() && left > threshold * total) left -= power[shooters[n++]];
+        shooters.resize(n);
+        shoot(shooters, dE);
+        shot += n;
+    }
+}
+
+bool Radiosity::irradiance (const Intersection &isect, RGB &Eo) const {
+    if (isect.PrimID < 0 || isect.PrimID >= (int)grids.size()) return false;
+    Grid const &grid = grids[isect.PrimID];
+    if (grid.first < 0) return false;
+    Geometry *g = scene->GetPrimitive(isect.PrimID)->g;
+    int const side = (vn[grid.first].dot(isect.wo) >= 0.f ? 0 : 1);
+    std::vector<RGB> const &Es = E[side];
+    float a, b;
+    if (g->type == QUAD_GEOMETRY) {
+        // bilinear interpolation over the patch
+        Quad *q = (Quad *)g;
+        planeCoords(q->v1, q->edge1, q->edge2, isect.p, a, b);
+        float const x = std::min(std::max(a, 0.f), 1.f) * grid.nu, y = std::min(std::max(b, 0.f), 1.f) * grid.nv;
+        int const i = std::min((int)x, grid.nu - 1), j = std::min((int)y, grid.nv - 1);
+        float const fx = x - i, fy = y - j;
+        int const v0 = grid.first + j * (grid.nu + 1) + i;
+        RGB e00 = Es[v0], e10 = Es[v0 + 1], e01 = Es[v0 + grid.nu + 1], e11 = Es[v0 + grid.nu + 2];
+        Eo = e00 * ((1.f-fx)*(1.f-fy)) + e10 * (fx*(1.f-fy)) + e01 * ((1.f-fx)*fy) + e11 * (fx*fy);
+    } else {
+        // barycentric interpolation over the patch
+        Triangle *t = (Triangle *)g;
+        int const n = grid.nu;
+        planeCoords(t->v1, t->edge1, t->edge2, isect.p, a, b);
+        a = std::max(a, 0.f);
+        b = std::max(b, 0.f);
+        if (a + b > 1.f) {
+            float const sum = a + b;
+            a /= sum;
+            b /= sum;
+        }
+        float const x = a * n, y = b * n;
+        int const j = std::min((int)y, n - 1), i = std::min((int)x, n - 1 - j);
+        float const fx = x - i, fy = y - j;
+        if (fx + fy <= 1.f) {
+            RGB e0 = Es[grid.first + triVertex(n, i, j)], e1 = Es[grid.first + triVertex(n, i+1, j)], e2 = Es[grid.first + triVertex(n, i, j+1)];
+            Eo = e0 * (1.f - fx - fy) + e1 * fx + e2 * fy;
+        } else {
+            RGB e0 = Es[grid.first + triVertex(n, i+1, j)], e1 = Es[grid.first + triVertex(n, i+1, j+1)], e2 = Es[grid.first + triVertex(n, i, j+1)];
+            Eo = e0 * (1.f - fy) + e1 * (fx + fy - 1.f) + e2 * (1.f - fx);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+//
+//  Radiosity.hpp
+//  VI-RT-V4-PathTracing
+//
+//  View independent progressive refinement radiosity (Cohen et al., "A
+//  progressive refinement approach to fast radiosity image generation",
+//  SIGGRAPH 1988) for diffuse scenes. The triangles and quads of the scene
+//  are subdivided into patches of about the same size, on a grid of vertices
+//  per primitive. Patches shoot their unshot radiance, largest power first,
+//  to the vertices of every other patch, with ray traced form factors from
+//  the vertices to a disk of the shooter's area (Wallace et al., "A ray
+//  tracing algorithm for progressive radiosity", SIGGRAPH 1989): each
+//  receiver vertex is tested with Scene::visibility, the vertices split
+//  among threads. The irradiance is kept per vertex and per side of the
+//  surface (primitives are two sided) and interpolated over each patch.
+//  The lights shoot first: point lights directly, area, quad and mesh lights
+//  as patches of their own. The BRDF value of diffuse surfaces is Kd, as in
+//  directLighting ; the albedo (PI * Kd) may exceed 1, so the number of
+//  bounces is bounded (1: as PathTracing). Spheres are not subdivided.
+//
+
+#ifndef Radiosity_hpp
+#define Radiosity_hpp
+
+#include <vector>
+#include "vector.hpp"
+#include "RGB.hpp"
+#include "scene.hpp"
+
+// minimum number of patches along each edge of an emitter
+#define RADIOSITY_MIN_EMITTER_SUBDIV 4
+
+class Radiosity {
+    typedef struct Patch {
+        Point c;
+        Vector n;
+        float area;
+        RGB Kd;         // at the patch centre
+        int v[4];       // vertices (v[3] is -1 for triangles)
+        int emitter;    // the light it belongs to (-1: a surface)
+        RGB unshot[2];  // radiance still to shoot from each side (front: along n)
+    } Patch;
+    // the grid of vertices of each primitive: nu x nv quads or n x n triangles (nu == nv)
+    typedef struct Grid {
+        int first;      // index of its first vertex (-1: not subdivided)
+        int nu, nv;
+    } Grid;
+    std::vector<Grid> grids;            // per scene primitive
+    std::vector<Point> vp;
+    std::vector<Vector> vn;
+    std::vector<RGB> E[2];              // irradiance of each vertex on each side
+    std::vector<Patch> patches;
+    Scene *scene;
+    void subdivide (const int prim, Geometry *g, BRDF *f, const float size);
+    void addEmitter (const int l, const float size);
+    // the patches' vertices get the irradiance the shooters send to them (into dE)
+    void shoot (const std::vector<int> &shooters, std::vector<RGB> *dE);
+    void shootPointLights (std::vector<RGB> *dE);
+public:
+    int shot;       // patches shot, over all the bounces
+    // res: patches along the largest dimension of the scene
+    // threshold: each bounce stops once the unshot power left is below this fraction
+    Radiosity (Scene *scene, const int res=32, const int bounces=1, const float threshold=0.01f);
+    int size (void) const { return (int)patches.size(); }
+    // irradiance at the intersection, on the side wo is in (false if the primitive has no patches)
+    bool irradiance (const Intersection &isect, RGB &Eo) const;
+};
+
+#endif /* Radiosity_hpp */
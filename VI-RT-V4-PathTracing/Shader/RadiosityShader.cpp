@@ -0,0 +1,25 @@
+//
+//  RadiosityShader.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "RadiosityShader.hpp"
+#include "BRDF.hpp"
+#include "DiffuseTexture.hpp"
+#include "EnvironmentLight.hpp"
+
+RGB RadiosityShader::shade (bool intersected, Intersection isect, int depth) {
+    // if no intersection, return the environment or the background
+    if (!intersected) {
+        if (scene->environment != NULL) return ((EnvironmentLight *)scene->environment)->Le(-1.f * isect.wo);
+        return (background);
+    }
+    if (isect.isLight) { // intersection with a light source
+        return isect.Le;
+    }
+    RGB E;
+    if (!radiosity->irradiance(isect, E)) return RGB(0., 0., 0.);
+    BRDF *f = isect.f;
+    RGB Kd = (f->textured ? ((DiffuseTexture *)f)->GetKd(isect) : f->Kd);
+    return Kd * E;
+}
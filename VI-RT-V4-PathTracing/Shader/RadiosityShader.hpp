@@ -0,0 +1,25 @@
+//
+//  RadiosityShader.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Renders a Radiosity solution from any camera: a single primary ray per
+//  sample, whose hit point gets Kd (textured or not) times the irradiance
+//  interpolated from the vertices of its patch. Every material is taken as
+//  diffuse ; the primitives without patches (spheres) show black.
+//
+
+#ifndef RadiosityShader_hpp
+#define RadiosityShader_hpp
+
+#include "shader.hpp"
+#include "Radiosity.hpp"
+
+class RadiosityShader: public Shader {
+    RGB background;
+    Radiosity *radiosity;
+public:
+    RadiosityShader (Scene *scene, RGB bg, Radiosity *_radiosity): Shader(scene), background(bg), radiosity(_radiosity) {}
+    RGB shade (bool intersected, Intersection isect, int depth);
+};
+
+#endif /* RadiosityShader_hpp */
@@ -0,0 +1,59 @@
+//
+//  Reservoir.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Weighted reservoir sampling over the scene lights (RIS / ReSTIR).
+//  Based on Bitterli et al., "Spatiotemporal reservoir resampling for
+//  real-time ray tracing with dynamic direct lighting", SIGGRAPH 2020
+//
+
+#ifndef Reservoir_hpp
+#define Reservoir_hpp
+
+#include <vector>
+#include "vector.hpp"
+
+typedef struct Reservoir {
+    int light;      // selected light index (-1 if none)
+    float wsum;     // sum of the resampling weights
+    float M;        // number of candidates seen
+    float W;        // unbiased contribution weight of the selected light
+    Reservoir (): light(-1), wsum(0.f), M(0.f), W(0.f) {}
+    // stream one candidate with weight w ; rnd in [0,1[
+    bool update (const int l, const float w, const float rnd) {
+        M += 1.f;
+        if (w <= 0.f) return false;
+        wsum += w;
+        if (rnd * wsum < w) {
+            light = l;
+            return true;
+        }
+        return false;
+    }
+} Reservoir;
+
+// One reservoir per pixel, kept from the previous sample of each pixel so that
+// the primary hits can reuse the reservoirs of the same pixel and its neighbours
+class ReservoirBuffer {
+public:
+    typedef struct Entry {
+        Reservoir r;
+        Point p;        // shading point the reservoir was built for
+        Vector n;       // and its shading normal
+        float depth;    // distance from the camera
+        bool valid;
+        Entry (): valid(false) {}
+    } Entry;
+private:
+    int W, H;
+    std::vector<Entry> entries;
+public:
+    ReservoirBuffer (const int _W, const int _H): W(_W), H(_H), entries(_W*_H) {}
+    // returns NULL outside the image
+    Entry *get (const int x, const int y) {
+        if (x<0 || y<0 || x>=W || y>=H) return NULL;
+        return &entries[y*W+x];
+    }
+};
+
+#endif /* Reservoir_hpp */
@@ -43,4 +43,25 @@ static float CosineHemiSphereSample (float *rnd, Vector &D) {
     return pdf;
 }
 
+// direction d in the shading frame of n (n along Z), as used by BRDF::pdf
+inline Vector WorldToLocal(const Vector& d, Vector n) {
+    Vector Rx, Ry;
+    n.CoordinateSystem(&Rx, &Ry);
+    return Vector(d.dot(Rx), d.dot(Ry), d.dot(n));
+}
+
+// direction d given in the shading frame of n back to world space
+inline Vector LocalToWorld(const Vector& d, Vector n) {
+    Vector Rx, Ry;
+    n.CoordinateSystem(&Rx, &Ry);
+    return Vector(d).Rotate(Rx, Ry, n);
+}
+
+// MIS weight of a sample drawn with pdf pf when it could also have been drawn with pdf pg
+// power heuristic (beta = 2), Veach's thesis, sec 9.2.4
+inline float PowerHeuristic(const float pf, const float pg) {
+    float const f2 = pf * pf, g2 = pg * pg;
+    return (f2 + g2 > 0.f ? f2 / (f2 + g2) : 0.f);
+}
+
 #endif // _ShaderUtils_hpp_
@@ -0,0 +1,149 @@
+//
+//  VPLShader.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "VPLShader.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+#include "ray.hpp"
+#include "EnvironmentLight.hpp"
+#include "DiffuseTexture.hpp"
+#include "LightPaths.hpp"
+
+static RGB diffuseKd (Intersection &isect) {
+    BRDF *f = isect.f;
+    if (f->textured) return ((DiffuseTexture *)f)->GetKd(isect);
+    return f->Kd;
+}
+
+VPLShader::VPLShader (Scene *scene, RGB bg, const int paths, const int _interleave, const float min_dist): Shader(scene), background(bg) {
+    interleave = (_interleave > 1 ? _interleave : 1);
+    float d = min_dist;
+    if (d <= 0.f) {
+        Vector const diag = scene->bb.min.vec2point(scene->bb.max);
+        d = 0.05f * std::max(diag.X, std::max(diag.Y, diag.Z));
+    }
+    min_dist2 = d * d;
+
+    // lights selected proportionally to their flux
+    std::vector<float> cdf;
+    float const total = lightFluxCdf(scene, cdf);
+    if (total <= 0.f || paths <= 0) return;
+
+    // the same VPLs at every run
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> U(0.f, 1.f);
+    for (int i=0 ; i<paths ; i++) {
+        float prob;
+        int const l = sampleLightFlux(cdf, total, U(gen), prob);
+        if (prob <= 0.f) continue;
+        float r[2] = {U(gen), U(gen)};
+        float dr[2] = {U(gen), U(gen)};
+        Ray ray;
+        RGB power;
+        if (!sampleEmission(scene->lights[l], r, dr, ray, power)) continue;
+        power = power / (paths * prob);
+
+        // follow the specular surfaces (as PhotonMap::trace) up to a diffuse one
+        for (int depth=0 ; depth < VPL_MAX_DEPTH ; depth++) {
+            Intersection isect;
+            if (!scene->trace(ray, &isect) || isect.isLight) break;
+            BRDF *f = isect.f;
+            if (!f->Kd.isZero()) {
+                VPL v;
+                v.p = isect.p;
+                v.n = isect.sn;
+                // Kd over the region the VPL lights without clamping (d wide), not at a point
+                RGB const Kd = (f->textured ? ((DiffuseTexture *)f)->GetKd(isect.TexCoord, d * isect.uv_scale) : f->Kd);
+                v.power = power * Kd;
+                vpls.push_back(v);
+            }
+            // continue with a specular reflection or transmission with probability of its albedo
+            Ray next;
+            RGB weight;
+            if (!specularBounce(isect, U(gen), next, weight)) break;
+            power = power * weight;
+            ray = next;
+        }
+    }
+}
+
+RGB VPLShader::indirect (Intersection isect, RGB Kd) {
+    RGB color(0., 0., 0.);
+    int const k2 = interleave * interleave;
+    // this pixel's subset: VPLs first, first + k2, ...
+    int const first = (interleave > 1 ? (isect.pix_y % interleave) * interleave + isect.pix_x % interleave : 0);
+    for (int i=first ; i<(int)vpls.size() ; i+=k2) {
+        VPL const &v = vpls[i];
+        Vector dir = isect.p.vec2point(v.p);
+        float const dist2 = dir.normSQ();
+        if (dist2 <= 0.f) continue;
+        float const dist = sqrtf(dist2);
+        dir = dir / dist;
+        float const cos_x = dir.dot(isect.sn);
+        float const cos_v = -1.f * dir.dot(v.n);
+        if (cos_x <= 0.f || cos_v <= 0.f) continue;
+        Ray shadow(isect.p, dir, SHADOW);
+        shadow.pix_x = isect.pix_x;
+        shadow.pix_y = isect.pix_y;
+        shadow.adjustOrigin(isect.gn);
+        if (!scene->visibility(shadow, dist - EPSILON)) continue;
+        RGB power = v.power;
+        color += power * (cos_x * cos_v / std::max(dist2, min_dist2));
+    }
+    return Kd * color * (float)k2;
+}
+
+RGB VPLShader::specularReflection (Intersection isect, BRDF *f, int depth) {
+    Ray specular(isect.p, reflect(isect.wo, isect.sn), SPEC_REFL);
+    specular.pix_x = isect.pix_x;
+    specular.pix_y = isect.pix_y;
+    specular.FaceID = isect.FaceID;
+    specular.adjustOrigin(isect.gn);
+    specular.propagating_eta = isect.incident_eta;  // same medium
+
+    Intersection s_isect;
+    bool const intersected = scene->trace(specular, &s_isect);
+    return f->Ks * shade(intersected, s_isect, depth+1);
+}
+
+RGB VPLShader::specularTransmission (Intersection isect, BRDF *f, int depth) {
+    Ray refraction = specularRefraction(isect.p, isect.wo, isect.sn, isect.gn, isect.incident_eta, f->eta);
+    refraction.pix_x = isect.pix_x;
+    refraction.pix_y = isect.pix_y;
+    refraction.FaceID = isect.FaceID;
+
+    Intersection t_isect;
+    bool const intersected = scene->trace(refraction, &t_isect);
+    return f->Kt * shade(intersected, t_isect, depth+1);
+}
+
+RGB VPLShader::shade (bool intersected, Intersection isect, int depth) {
+    RGB color(0.,0.,0.);
+
+    // if no intersection, return the environment or the background
+    if (!intersected) {
+        if (scene->environment != NULL) return ((EnvironmentLight *)scene->environment)->Le(-1.f * isect.wo);
+        return (background);
+    }
+    if (isect.isLight) { // intersection with a light source
+        return isect.Le;
+    }
+    // get the BRDF
+    BRDF *f = isect.f;
+
+    if (!f->Ks.isZero() && depth < VPL_MAX_DEPTH) {
+        color += specularReflection(isect, f, depth);
+    }
+    if (!f->Kt.isZero() && depth < VPL_MAX_DEPTH) {
+        color += specularTransmission(isect, f, depth);
+    }
+    if (!f->Kd.isZero()) {
+        color += directLighting(scene, isect, f, rng, U_dist, ALL_LIGHTS);
+        color += indirect(isect, diffuseKd(isect));
+    }
+    return color;
+}
@@ -0,0 +1,60 @@
+//
+//  VPLShader.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Instant radiosity preview (Keller, "Instant radiosity", SIGGRAPH 1997).
+//  Paths traced from the point and area lights (AREA_LIGHT, QUAD_AREA_LIGHT),
+//  through the specular surfaces, leave a virtual point light (VPL) where
+//  they first reach a diffuse surface: the flux it reflects. The indirect
+//  diffuse light of the shaded points is gathered from the VPLs with
+//  Scene::visibility, the geometry term clamped by a minimum distance (the
+//  bias that keeps the image free of the bright spots next to each VPL).
+//  Direct light is sampled as in PathTracing ; the specular surfaces (and
+//  the GGX ones, taken as smooth) are followed as in WhittedShader.
+//  With interleaved sampling (Keller and Heidrich, "Interleaved sampling",
+//  EGWR 2001) the VPLs are split into k*k subsets and each pixel of a k*k
+//  tile gathers from a different one, at 1/(k*k) of the cost.
+//  One diffuse bounce, as PathTracing ; the BRDF value of diffuse surfaces is Kd.
+//
+
+#ifndef VPLShader_hpp
+#define VPLShader_hpp
+
+#include "shader.hpp"
+#include "BRDF.hpp"
+#include "directLighting.hpp"
+#include "RNG.hpp"
+#include <random>
+#include <vector>
+
+// specular bounces of the light paths and of the camera rays
+#define VPL_MAX_DEPTH 8
+
+class VPLShader: public Shader {
+    typedef struct VPL {
+        Point p;
+        Vector n;       // facing the side the light arrived from
+        RGB power;      // reflected flux (flux times Kd)
+    } VPL;
+    std::vector<VPL> vpls;
+    RGB background;
+    int interleave;     // tiles of interleave * interleave pixels
+    float min_dist2;    // clamping of the geometry term
+    RGB specularReflection (Intersection isect, BRDF *f, int depth);
+    RGB specularTransmission (Intersection isect, BRDF *f, int depth);
+    RGB indirect (Intersection isect, RGB Kd);
+    /****************************************
+
+     Our Random Number Generator (rng) */
+    std::random_device rdev{};
+    RNG rng{rdev()};
+    std::uniform_real_distribution<float>U_dist{0.0,1.0};  // uniform distribution in[0,1[
+public:
+    // paths: light paths traced ; interleave: 1 gathers from all the VPLs at every pixel
+    // min_dist <= 0: 5% of the largest dimension of the scene
+    VPLShader (Scene *scene, RGB bg, const int paths=2048, const int interleave=8, const float min_dist=0.f);
+    int size (void) const { return (int)vpls.size(); }
+    RGB shade (bool intersected, Intersection isect, int depth);
+};
+
+#endif /* VPLShader_hpp */
@@ -7,189 +7,293 @@
 
 #include "directLighting.hpp"
 
+#include <algorithm>
+#include <cassert>
+
 #include "AmbientLight.hpp"
 #include "AreaLight.hpp"
+#include "QuadAreaLight.hpp"
+#include "MeshLight.hpp"
+#include "EnvironmentLight.hpp"
 #include "PointLight.hpp"
 #include "Shader_Utils.hpp"
+#include "LightAOV.hpp"
 
 static RGB direct_AmbientLight(AmbientLight *l, BRDF *f);
 static RGB direct_PointLight(PointLight *l, Scene *scene, Intersection isect, BRDF *f);
-static RGB direct_AreaLight(AreaLight *l, Scene *scene, Intersection isect, BRDF *f, float *r);
+template <class AL> static RGB direct_AreaLight(AL *l, Scene *scene, Intersection isect, BRDF *f, float *r, float select, float bsdfSelect, const DTree *guide, RGB *unweighted);
 
-static RGB sample_light(Scene *scene, Light *light, Intersection isect, BRDF *f, std::mt19937 &rng, std::uniform_real_distribution<float> U_dist) {
+// select: probability with which the light was selected (for the MIS weights)
+// bsdfSelect, guide: see directLighting ; bsdfSelect 0 disables MIS
+// unweighted: if not NULL receives the contribution without the MIS weight
+static RGB sample_light(Scene *scene, Light *light, Intersection isect, BRDF *f, RNG &rng, std::uniform_real_distribution<float> U_dist, float select=1.f, float bsdfSelect=0.f, const DTree *guide=NULL, RGB *unweighted=NULL) {
     switch (light->type) {
         case AMBIENT_LIGHT: {
-            return direct_AmbientLight((AmbientLight *)light, f);
+            RGB const color = direct_AmbientLight((AmbientLight *)light, f);
+            if (unweighted != NULL) *unweighted = color;
+            return color;
         }
         case POINT_LIGHT: {
-            return direct_PointLight((PointLight *)light, scene, isect, f);
+            RGB const color = direct_PointLight((PointLight *)light, scene, isect, f);
+            if (unweighted != NULL) *unweighted = color;
+            return color;
         }
         case AREA_LIGHT: {
             float r[2];
             r[0] = U_dist(rng);
             r[1] = U_dist(rng);
-            return direct_AreaLight((AreaLight *)light, scene, isect, f, r);
+            return direct_AreaLight((AreaLight *)light, scene, isect, f, r, select, bsdfSelect, guide, unweighted);
+        }
+        case QUAD_AREA_LIGHT: {
+            float r[2];
+            r[0] = U_dist(rng);
+            r[1] = U_dist(rng);
+            return direct_AreaLight((QuadAreaLight *)light, scene, isect, f, r, select, bsdfSelect, guide, unweighted);
+        }
+        case MESH_LIGHT: {
+            float r[2];
+            r[0] = U_dist(rng);
+            r[1] = U_dist(rng);
+            return direct_AreaLight((MeshLight *)light, scene, isect, f, r, select, bsdfSelect, guide, unweighted);
+        }
+        case ENVIRONMENT_LIGHT: {
+            float r[2];
+            r[0] = U_dist(rng);
+            r[1] = U_dist(rng);
+            return direct_AreaLight((EnvironmentLight *)light, scene, isect, f, r, select, bsdfSelect, guide, unweighted);
         }
         case NO_LIGHT: {
+            if (unweighted != NULL) *unweighted = RGB(0., 0., 0.);
             return RGB(0., 0., 0.);
         }
     }
 }
 
-static float estimateContribution(Scene *scene, Intersection &isect, Light *light, BRDF *f, std::mt19937 &rng, std::uniform_real_distribution<float> U_dist) {
-    constexpr float EPS = 1e-6f;
+// IMPORTANCE_ONE weight of a single light, read from the scene light table
+static float estimateContribution(Scene *scene, Intersection &isect, const int l) {
+    return scene->lightTable.importance1(l, isect.p, isect.sn);
+}
 
-    switch (light->type) {
-        case AMBIENT_LIGHT: {
-            return 0.f;
+// Evaluate the selection weights of all lights (SIMD over the scene light table)
+static void lightWeights(Scene *scene, Intersection &isect, DIRECT_SAMPLE_MODE mode, float *w) {
+    const LightTable &lt = scene->lightTable;
+    switch (mode) {
+        case IMPORTANCE_ONE_NO_DISTANCE: {
+            lt.importance(isect.p, isect.sn, w, false);
+            break;
         }
-        case POINT_LIGHT: {
-            auto *pl = static_cast<PointLight *>(light);
-            Vector L = isect.p.vec2point(pl->pos);
-            float dist2 = L.normSQ();
-            if (dist2 < EPS) return 0.f;
-            L.normalize();
-            float cosS = std::max(0.f, L.dot(isect.sn));
-            if (cosS <= 0.f) return 0.f;
-            float lum = pl->color.Y();
-            return lum * cosS / dist2;
+        case DISTANCE_ONE: {
+            lt.inverseDistance(isect.p, w);
+            break;
         }
-        case AREA_LIGHT: {
-            auto *al = static_cast<AreaLight *>(light);
-            Point C = (al->gem->v1 + al->gem->v2 + al->gem->v3) * (1.f / 3.f);
-
-            Vector L = isect.p.vec2point(C);
-            float dist2 = L.normSQ();
-            if (dist2 < EPS) return 0.f;
-
-            L.normalize();
-            float cosS = std::max(0.f, L.dot(isect.sn));
-            float cosL = std::max(0.f, -L.dot(al->gem->normal));
-            if (cosS <= 0.f || cosL <= 0.f) return 0.f;
-
-            float lum = al->intensity.Y();
-            float area = al->gem->area();
-
-            return lum * cosS * cosL * area / dist2;
+        case DISTANCE_SQUARED_ONE: {
+            lt.inverseDistance(isect.p, w, true);
+            break;
         }
-        case NO_LIGHT: {
-            return 0.f;
+        default: {
+            lt.importance(isect.p, isect.sn, w);
+            break;
         }
     }
 }
 
-static float estimateContributionNoDistance(Scene *scene, Intersection &isect, Light *light, BRDF *f, std::mt19937 &rng, std::uniform_real_distribution<float> U_dist) {
-    constexpr float EPS = 1e-6f;
-
-    switch (light->type) {
-        case AMBIENT_LIGHT: {
-            return 0.f;
-        }
-        case POINT_LIGHT: {
-            auto *pl = static_cast<PointLight *>(light);
-            Vector L = isect.p.vec2point(pl->pos);
-            L.normalize();
-            float cosS = std::max(0.f, L.dot(isect.sn));
-            if (cosS <= 0.f) return 0.f;
-            float lum = pl->color.Y();
-            return lum * cosS;
-        }
-        case AREA_LIGHT: {
-            auto *al = static_cast<AreaLight *>(light);
-            Point C = (al->gem->v1 + al->gem->v2 + al->gem->v3) * (1.f / 3.f);
-
-            Vector L = isect.p.vec2point(C);
-
-            L.normalize();
-            float cosS = std::max(0.f, L.dot(isect.sn));
-            float cosL = std::max(0.f, -L.dot(al->gem->normal));
-            if (cosS <= 0.f || cosL <= 0.f) return 0.f;
-
-            float lum = al->intensity.Y();
-            float area = al->gem->area();
+// Select a light with the CDF stored in the light cache cell of this shading point.
+// The cell is created with the same weights as IMPORTANCE_ONE times the Kd
+// luminance (the unoccluded contribution, the scale of the samples) and then learns
+// from the contributions returned by the sampled lights (zero if occluded)
+static LightCache::Cell *cacheCell(Scene *scene, LightCache *cache, Intersection &isect) {
+    LightCache::Cell *cell = cache->find(isect.p, isect.sn);
+    if (cell == NULL) {
+        BRDF *f = isect.f;
+        RGB Kd = (f->textured ? ((DiffuseTexture *)f)->GetKd(isect) : f->Kd);
+        float const albedo = Kd.Y();
+        std::vector<float> weights(scene->lightTable.size);
+        scene->lightTable.importance(isect.p, isect.sn, weights.data());
+        weights.resize(scene->numLights);
+        for (float &w : weights) w *= albedo;
+        cell = cache->insert(isect.p, isect.sn, weights);
+    }
+    return cell;
+}
 
-            return lum * cosS * cosL * area;
+void lightSelection(Scene *scene, Intersection &isect, DIRECT_SAMPLE_MODE mode, LightCache *cache, LightSelection &sel) {
+    assert(scene->lightTable.numLights == scene->numLights);
+    const LightTable &lt = scene->lightTable;
+    sel.mode = (mode == LIGHT_CACHE_ONE && cache == NULL ? IMPORTANCE_ONE : mode);
+    sel.numLights = scene->numLights;
+    sel.total = 0.f;
+    sel.cell = NULL;
+    switch (sel.mode) {
+        case IMPORTANCE_ONE:
+        case IMPORTANCE_ONE_NO_DISTANCE:
+        case DISTANCE_ONE:
+        case DISTANCE_SQUARED_ONE: {
+            sel.weights.resize(lt.size);
+            sel.cdf.resize(lt.size);
+            lightWeights(scene, isect, sel.mode, sel.weights.data());
+            sel.total = LightTable::prefixSum(sel.weights.data(), sel.cdf.data(), lt.size);
+            break;
         }
-        case NO_LIGHT: {
-            return 0.f;
+        case LIGHT_CACHE_ONE: {
+            // a copy: sampling updates the cell, and may rebuild its CDF
+            sel.cell = cacheCell(scene, cache, isect);
+            sel.cdf = sel.cell->cdf;
+            sel.weights.resize(sel.numLights);
+            for (int l = 0 ; l < sel.numLights ; l++) sel.weights[l] = cache->pmf(sel.cell, l);
+            sel.total = sel.cdf[sel.numLights-1];
+            break;
         }
+        default:
+            break;
     }
 }
 
-static float estimateDistance(Scene *scene, Intersection &isect, Light *light, BRDF *f, std::mt19937 &rng, std::uniform_real_distribution<float> U_dist) {
-    switch (light->type) {
-        case AMBIENT_LIGHT: {
-            return 0.f;
+float lightSelectionPdf(const LightSelection &sel, const int l) {
+    if (l < 0 || l >= sel.numLights) return 0.f;
+    switch (sel.mode) {
+        case ALL_LIGHTS: {
+            return 1.f;
         }
-        case POINT_LIGHT: {
-            auto *pl = static_cast<PointLight *>(light);
-            Vector L = isect.p.vec2point(pl->pos);
-            return 1.0f / L.norm();
+        case UNIFORM_ONE: {
+            return 1.f / sel.numLights;
         }
-        case AREA_LIGHT: {
-            auto *al = static_cast<AreaLight *>(light);
-            Point C = (al->gem->v1 + al->gem->v2 + al->gem->v3) * (1.f / 3.f);
-            Vector L = isect.p.vec2point(C);
-            return 1.0f / L.norm();
+        case RIS_ONE:
+        case RESTIR_ONE: {
+            return -1.f;
         }
-        case NO_LIGHT: {
-            return 0.f;
+        default: {
+            return (sel.total > 0.f ? sel.weights[l] / sel.total : 0.f);
         }
     }
 }
 
-template <typename WeightFunc>
-static RGB sampleLightDiscrete(Scene *scene, WeightFunc weight_func, Intersection &isect, BRDF *f, std::mt19937 &rng, std::uniform_real_distribution<float> U_dist) {
+// Select a light with the pmf of sel (IMPORTANCE_ONE, IMPORTANCE_ONE_NO_DISTANCE,
+// DISTANCE_ONE, DISTANCE_SQUARED_ONE and LIGHT_CACHE_ONE) ; with the light cache
+// the cell learns the contribution of the sampled light
+// chosen: the light sampled (-1: none) ; the same for sampleLightReservoir
+static RGB sampleLightSelection(Scene *scene, const LightSelection &sel, LightCache *cache, Intersection &isect, BRDF *f, RNG &rng, std::uniform_real_distribution<float> U_dist, float bsdfSelect, const DTree *guide, int &chosen) {
     RGB color(0., 0., 0.);
+    int const N = sel.numLights;
 
-    // Compute the contribution of each light source
-    std::vector<float> contributions;
-    float total_contribution = 0.f;
-    for (int i = 0; i < scene->numLights; ++i) {
-        auto weight = weight_func(scene, isect, scene->lights[i], f, rng, U_dist);
-        contributions.push_back(weight);
-        total_contribution += weight;
-    }
-
-    if (total_contribution <= 0.f) {
+    if (sel.total <= 0.f) {
         return color;  // No contribution from any light source
     }
 
-    // Build the CDF
-    std::vector<float> cdf;
-    for (int i = 0; i < scene->numLights; ++i) {
-        float last_cdf = (i == 0) ? 0.f : cdf[i - 1];
-        cdf.push_back(last_cdf + contributions[i] / total_contribution);
-    }
+    // Sample a random number and find the corresponding light source
+    float const rnd = U_dist(rng) * sel.total;
+    chosen = (int)(std::upper_bound(sel.cdf.begin(), sel.cdf.begin() + N, rnd) - sel.cdf.begin());
+    // rounding errors: fall back to the last light with a non zero weight
+    if (chosen >= N) chosen = N - 1;
+    while (chosen > 0 && sel.weights[chosen] <= 0.f) chosen--;
+
+    float const prob = sel.weights[chosen] / sel.total;
+    if (prob <= 0.f) return color;
+    RGB unweighted;
+    color = sample_light(scene, scene->lights[chosen], isect, f, rng, U_dist, prob, bsdfSelect, guide, &unweighted);
+    // learn the contribution of the light itself: neither divided by prob nor MIS weighted
+    if (sel.cell != NULL) cache->update(sel.cell, chosen, unweighted.Y());
+
+    return color / prob;
+}
 
-    cdf[scene->numLights - 1] = 1.f;  // Ensure the last CDF value is 1 (to avoid rounding errors)
+// Merge a reservoir built for another shading point (previous sample of this pixel
+// or a neighbour pixel) into r. The selected light is re-weighted with the target
+// function at this shading point. Returns the number of candidates merged (0 if
+// the reservoir was rejected)
+static float mergeReservoir(Reservoir &r, ReservoirBuffer::Entry *prev, Scene *scene, Intersection &isect, RNG &rng, std::uniform_real_distribution<float> U_dist) {
+    // clamp the history so that old samples do not dominate the reservoir
+    float const max_M = 20.f * RIS_CANDIDATES;
+
+    if (prev == NULL || !prev->valid || prev->r.light < 0 || prev->r.W <= 0.f) return 0.f;
+    // reject neighbours on a different surface
+    if (prev->n.dot(isect.sn) < 0.9f || fabsf(prev->depth - isect.depth) > 0.1f * isect.depth) return 0.f;
+
+    float const M = std::min(prev->r.M, max_M);
+    float const target = estimateContribution(scene, isect, prev->r.light);
+    r.update(prev->r.light, target * prev->r.W * M, U_dist(rng));
+    r.M += M - 1.f;  // update() counted a single candidate
+    return M;
+}
 
-    // Sample a random number and find the corresponding light source
-    float rnd = U_dist(rng);
-    int chosen = 0;
-    for (int i = 0; i < scene->numLights; ++i) {
-        if (rnd < cdf[i]) {
-            chosen = i;
-            break;
+// Resampled importance sampling: stream RIS_CANDIDATES uniformly selected lights
+// through a reservoir with estimateContribution as the target function and trace
+// a single shadow ray to the survivor. With reuse, primary hits also merge the
+// reservoirs of the previous sample of this pixel and of the left and upper pixels.
+static RGB sampleLightReservoir(Scene *scene, ReservoirBuffer *reservoirs, Intersection &isect, BRDF *f, RNG &rng, std::uniform_real_distribution<float> U_dist, int &chosen) {
+    RGB color(0., 0., 0.);
+    Reservoir r;
+
+    for (int k = 0; k < RIS_CANDIDATES; ++k) {
+        int l_ndx = U_dist(rng) * scene->numLights;
+        if (l_ndx >= scene->numLights) l_ndx = scene->numLights - 1;
+        // candidates pdf is 1/numLights
+        float const w = estimateContribution(scene, isect, l_ndx) * scene->numLights;
+        r.update(l_ndx, w, U_dist(rng));
+    }
+
+    ReservoirBuffer::Entry *entry = NULL;
+    // the reservoirs merged and their number of candidates (for the 1/Z normalization)
+    ReservoirBuffer::Entry *merged[3];
+    float merged_M[3];
+    int n_merged = 0;
+    if (reservoirs != NULL && isect.r_type == PRIMARY) {
+        entry = reservoirs->get(isect.pix_x, isect.pix_y);
+        ReservoirBuffer::Entry *const neighbours[3] = {entry, reservoirs->get(isect.pix_x - 1, isect.pix_y), reservoirs->get(isect.pix_x, isect.pix_y - 1)};
+        for (ReservoirBuffer::Entry *e : neighbours) {
+            float const M = mergeReservoir(r, e, scene, isect, rng, U_dist);
+            if (M > 0.f) {
+                merged[n_merged] = e;
+                merged_M[n_merged++] = M;
+            }
         }
     }
 
-    Light *l = scene->lights[chosen];
-    float contribution = contributions[chosen] / total_contribution;
-    color = sample_light(scene, l, isect, f, rng, U_dist) / contribution;
+    chosen = r.light;
+    if (r.light >= 0) {
+        float const target = estimateContribution(scene, isect, r.light);
+        // 1/M is biased when the merged reservoirs could not have produced the
+        // selected light (zero target at their shading point) ; 1/Z only counts
+        // the candidates of those that could
+        float Z = r.M;
+#if RESTIR_UNBIASED
+        if (n_merged > 0) {
+            Z = (target > 0.f ? (float)RIS_CANDIDATES : 0.f);
+            for (int k = 0; k < n_merged; ++k) {
+                if (scene->lightTable.importance1(r.light, merged[k]->p, merged[k]->n) > 0.f) Z += merged_M[k];
+            }
+        }
+#endif
+        r.W = (target > 0.f && Z > 0.f ? r.wsum / (Z * target) : 0.f);
+        color = sample_light(scene, scene->lights[r.light], isect, f, rng, U_dist) * r.W;
+        // do not propagate occluded lights to the next samples
+        if (color.isZero()) r.W = 0.f;
+    }
 
+    if (entry != NULL) {
+        entry->r = r;
+        entry->p = isect.p;
+        entry->n = isect.sn;
+        entry->depth = isect.depth;
+        entry->valid = true;
+    }
     return color;
 }
 
-RGB directLighting(Scene *scene, Intersection isect, BRDF *f, std::mt19937 &rng, std::uniform_real_distribution<float> U_dist, DIRECT_SAMPLE_MODE mode) {
+RGB directLighting(Scene *scene, Intersection isect, BRDF *f, RNG &rng, std::uniform_real_distribution<float> U_dist, DIRECT_SAMPLE_MODE mode, LightCache *cache, ReservoirBuffer *reservoirs, float bsdfSelect, const DTree *guide, const LightSelection *sel) {
     RGB color(0., 0., 0.);
 
     if (scene->numLights == 0) return color;
+    // the light table is built by Scene::SetLights, after the scene and before rendering
+    assert(scene->lightTable.numLights == scene->numLights);
 
+    // the light that gave color (per light AOVs)
+    int chosen = -1;
     switch (mode) {
         case ALL_LIGHTS: {
-            for (Light *light : scene->lights) {
-                color += sample_light(scene, light, isect, f, rng, U_dist);
+            for (int l = 0 ; l < scene->numLights ; l++) {
+                RGB c = sample_light(scene, scene->lights[l], isect, f, rng, U_dist, 1.f, bsdfSelect, guide);
+                LightAOV::record(l, isect.throughput * c);
+                color += c;
             }
             break;
         }
@@ -198,31 +302,34 @@ RGB directLighting(Scene *scene, Intersection isect, BRDF *f, std::mt19937 &rng,
             if (l_ndx >= scene->numLights) l_ndx = scene->numLights - 1;
             Light *l = scene->lights[l_ndx];
 
-            color = sample_light(scene, l, isect, f, rng, U_dist);
+            color = sample_light(scene, l, isect, f, rng, U_dist, 1.f / scene->numLights, bsdfSelect, guide);
             color = color * scene->numLights;
+            chosen = l_ndx;
             break;
         }
-        case IMPORTANCE_ONE: {
-            color = sampleLightDiscrete(scene, estimateContribution, isect, f, rng, U_dist);
-            break;
-        }
-        case IMPORTANCE_ONE_NO_DISTANCE: {
-            color = sampleLightDiscrete(scene, estimateContributionNoDistance, isect, f, rng, U_dist);
+        case IMPORTANCE_ONE:
+        case IMPORTANCE_ONE_NO_DISTANCE:
+        case DISTANCE_ONE:
+        case DISTANCE_SQUARED_ONE:
+        case LIGHT_CACHE_ONE: {
+            LightSelection own;
+            if (sel == NULL) {
+                lightSelection(scene, isect, mode, cache, own);
+                sel = &own;
+            }
+            color = sampleLightSelection(scene, *sel, cache, isect, f, rng, U_dist, bsdfSelect, guide, chosen);
             break;
         }
-        case DISTANCE_ONE: {
-            color = sampleLightDiscrete(scene, estimateDistance, isect, f, rng, U_dist);
+        case RIS_ONE: {
+            color = sampleLightReservoir(scene, NULL, isect, f, rng, U_dist, chosen);
             break;
         }
-        case DISTANCE_SQUARED_ONE: {
-            auto sampler = [](Scene *scene, Intersection &isect, Light *light, BRDF *f, std::mt19937 &rng, std::uniform_real_distribution<float> U_dist) {
-                auto dist = estimateDistance(scene, isect, light, f, rng, U_dist);
-                return dist * dist;
-            };
-            color = sampleLightDiscrete(scene, sampler, isect, f, rng, U_dist);
+        case RESTIR_ONE: {
+            color = sampleLightReservoir(scene, reservoirs, isect, f, rng, U_dist, chosen);
             break;
         }
     }
+    if (chosen >= 0) LightAOV::record(chosen, isect.throughput * color);
 
     return color;
 }
@@ -242,7 +349,7 @@ static RGB direct_PointLight(PointLight *l, Scene *scene, Intersection isect, BR
 
     if (f->textured) {
         DiffuseTexture *df = (DiffuseTexture *)f;
-        Kd = df->GetKd(isect.TexCoord);
+        Kd = df->GetKd(isect);
     } else {
         Kd = f->Kd;
     }
@@ -271,32 +378,34 @@ static RGB direct_PointLight(PointLight *l, Scene *scene, Intersection isect, BR
     return (color);
 }
 
-static RGB direct_AreaLight(AreaLight *l, Scene *scene, Intersection isect, BRDF *f, float *r) {
+// AL is AreaLight, QuadAreaLight, MeshLight or EnvironmentLight: all provide Sample_L (r, p, Lpos, pdf_w)
+template <class AL> static RGB direct_AreaLight(AL *l, Scene *scene, Intersection isect, BRDF *f, float *r, float select, float bsdfSelect, const DTree *guide, RGB *unweighted) {
     RGB color(0., 0., 0.);
+    if (unweighted != NULL) *unweighted = color;
     RGB Kd;
-    float pdf, cosL, cosLN_l, Ldistance;
+    float pdf, cosL, Ldistance;
     RGB L;
     Point Lpos;
 
     if (f->textured) {
         DiffuseTexture *df = (DiffuseTexture *)f;
-        Kd = df->GetKd(isect.TexCoord);
+        Kd = df->GetKd(isect);
     } else {
         Kd = f->Kd;
     }
 
     pdf = 0.;
     if (!Kd.isZero()) {
-        L = l->Sample_L(r, &Lpos, pdf);
-        // the pdf computed above is just 1/Area
+        // pdf is with respect to the solid angle at isect.p:
+        // 1/(spherical triangle area) if the light uses solid angle sampling,
+        // dist^2 / (Area * cos(light)) if it samples its area
+        L = l->Sample_L(r, isect.p, &Lpos, pdf);
+        if (pdf <= 0.f) return color;
         Vector Ldir = isect.p.vec2point(Lpos);
         Ldistance = Ldir.norm();
         Ldir.normalize();
         cosL = Ldir.dot(isect.sn);
-        // Ldir points into the light: * -1 to get the correct sign
-        cosLN_l = -1.f * Ldir.dot(l->gem->normal);
-        // The light source will only contribute if the above cosine is positive
-        if (cosL > 1.e-4 && cosLN_l > 1.e-4) {
+        if (cosL > 1.e-4) {
             Ray shadow = Ray(isect.p, Ldir, SHADOW);
             shadow.pix_x = isect.pix_x;
             shadow.pix_y = isect.pix_y;
@@ -304,10 +413,13 @@ static RGB direct_AreaLight(AreaLight *l, Scene *scene, Intersection isect, BRDF
             shadow.adjustOrigin(isect.gn);
 
             if (scene->visibility(shadow, Ldistance - EPSILON)) {
-                color = L * Kd * cosL;
-                if (pdf > 0.) color /= pdf;
-                if (Ldistance > 0.f) color /= (Ldistance * Ldistance);
-                color *= cosLN_l;
+                color = L * Kd * cosL / pdf;
+                if (unweighted != NULL) *unweighted = color;
+                // MIS with the BRDF sampling done by the caller (power heuristic)
+                if (bsdfSelect > 0.f) {
+                    float const bsdf_pdf = bsdfSelect * (guide != NULL ? GuidedPdf(guide, Ldir, isect.sn) : f->pdf(WorldToLocal(isect.wo, isect.sn), WorldToLocal(Ldir, isect.sn), DIFFUSE_REF));
+                    color *= PowerHeuristic(select * pdf, bsdf_pdf);
+                }
             }
         }
     }  // Kd is zero
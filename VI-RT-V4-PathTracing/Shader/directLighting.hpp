@@ -9,12 +9,17 @@
 #define directLighting_hpp
 
 #include <random>
+#include <vector>
 
 #include "DiffuseTexture.hpp"
 #include "RGB.hpp"
 #include "intersection.hpp"
 #include "scene.hpp"
 #include "shader.hpp"
+#include "LightCache.hpp"
+#include "Reservoir.hpp"
+#include "PathGuiding.hpp"
+#include "RNG.hpp"
 
 typedef enum {
     ALL_LIGHTS,
@@ -23,8 +28,47 @@ typedef enum {
     IMPORTANCE_ONE_NO_DISTANCE,
     DISTANCE_ONE,
     DISTANCE_SQUARED_ONE,
+    LIGHT_CACHE_ONE,
+    RIS_ONE,
+    RESTIR_ONE,
 } DIRECT_SAMPLE_MODE;
 
-RGB directLighting(Scene *scene, Intersection isect, BRDF *f, std::mt19937 &rng, std::uniform_real_distribution<float> U_dist, DIRECT_SAMPLE_MODE mode = ALL_LIGHTS);
+// number of candidate lights streamed through the reservoir by RIS_ONE and RESTIR_ONE
+#define RIS_CANDIDATES 16
+// RESTIR_ONE: 1 normalizes the reused reservoirs by 1/Z, the candidates of the
+// reservoirs whose shading point could have selected the light (unbiased) ; 0 by
+// 1/M, all candidates (biased across geometric discontinuities, as the original
+// ReSTIR ; the neighbours with a different normal or depth are rejected anyway)
+#define RESTIR_UNBIASED 1
+
+// light selection probabilities at a shading point, computed once by lightSelection
+// and shared by directLighting, which samples a light with them, and by the MIS
+// weights of the emitters hit by the BRDF samples at the same point
+typedef struct LightSelection {
+    DIRECT_SAMPLE_MODE mode;
+    int numLights;
+    std::vector<float> weights, cdf;    // per light, unnormalized (modes with a light table)
+    float total;                        // sum of the weights
+    LightCache::Cell *cell;             // LIGHT_CACHE_ONE: the cell they come from
+    LightSelection (): mode(ALL_LIGHTS), numLights(0), total(0.f), cell(NULL) {}
+} LightSelection;
+
+// LIGHT_CACHE_ONE requires a LightCache ; without one it behaves as IMPORTANCE_ONE
+// RESTIR_ONE requires a ReservoirBuffer ; without one it behaves as RIS_ONE
+// bsdfSelect > 0 if the caller also samples the diffuse BRDF at isect (with this
+// probability) and weights the emitters it hits with MIS: the light samples are then
+// weighted with the power heuristic. RIS_ONE and RESTIR_ONE do not support MIS.
+// guide is not NULL if the caller samples the diffuse lobe with the path guiding
+// mixture (GuidedPdf) instead of the cosine
+// sel: the light selection at isect for mode and cache ; NULL: computed here
+RGB directLighting(Scene *scene, Intersection isect, BRDF *f, RNG &rng, std::uniform_real_distribution<float> U_dist, DIRECT_SAMPLE_MODE mode = ALL_LIGHTS, LightCache *cache = NULL, ReservoirBuffer *reservoirs = NULL, float bsdfSelect = 0.f, const DTree *guide = NULL, const LightSelection *sel = NULL);
+
+// the light selection of directLighting (mode) at isect (with the light cache:
+// the pmf of its cell at this moment)
+void lightSelection(Scene *scene, Intersection &isect, DIRECT_SAMPLE_MODE mode, LightCache *cache, LightSelection &sel);
+
+// probability with which directLighting selects light l with sel
+// (the light pdf of MIS is this times Light::Pdf_L) ; -1 for RIS_ONE and RESTIR_ONE
+float lightSelectionPdf(const LightSelection &sel, const int l);
 
 #endif /* directLighting_hpp */
@@ -10,6 +10,7 @@
 
 #include "scene.hpp"
 #include "RGB.hpp"
+#include "image.hpp"
 
 class Shader {
 public:
@@ -17,6 +18,11 @@ public:
     Shader (Scene *_scene): scene(_scene) {}
     ~Shader () {}
     virtual RGB shade (bool intersected, Intersection isect, int depth) {return RGB();}
+    // called by the renderer after each progressive pass
+    virtual void EndPass (void) {}
+    // called by the renderer once all the samples are taken: adds the radiance the
+    // shader splatted onto arbitrary pixels (light tracing) to img ; scale is 1/spp
+    virtual void AddSplats (Image *img, const float scale) {}
 };
 
 #endif /* shader_hpp */
@@ -9,10 +9,16 @@
 #include "scene.hpp"
 #include "Perspective.hpp"
 #include "StandardRenderer.hpp"
+#include "MLTRenderer.hpp"
 #include "ImagePPM.hpp"
+#include "ImageAOV.hpp"
+#include "ImageStream.hpp"
 #include "AmbientShader.hpp"
 #include "WhittedShader.hpp"
 #include "PathTracingShader.hpp"
+#include "BDPTShader.hpp"
+#include "VPLShader.hpp"
+#include "RadiosityShader.hpp"
 #include "AmbientLight.hpp"
 #include "Sphere.hpp"
 #include "BuildScenes.hpp"
@@ -27,14 +33,41 @@ int main(int argc, const char *argv[]) {
     double cpu_time_used;
 
     // Image resolution
-    const int W = 640;
-    const int H = 640;
+    int W = 640;
+    int H = 640;
 
-    img = new ImagePPM(W, H);
-
-    // raytracer <output.ppm> <spp> <light_sampler_mode>
+    // raytracer <output.ppm> <spp> <light_sampler_mode> [options]
     if (argc < 4) {
-        fprintf(stderr, "Usage: %s <output.ppm> <spp> <light_sampler_mode>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <output.ppm> <spp> <light_sampler_mode> [options]\n", argv[0]);
+        fprintf(stderr, "Options:\n");
+        fprintf(stderr, "  --rr=fixed|adaptive   Russian roulette (adaptive: weight windows with splitting)\n");
+        fprintf(stderr, "  --rr-window=<s>       adaptive: ratio between the weight window bounds (5)\n");
+        fprintf(stderr, "  --rr-split=<n>        adaptive: maximum number of splits per vertex (4)\n");
+        fprintf(stderr, "  --guiding             path guiding of the diffuse bounces (SD-tree)\n");
+        fprintf(stderr, "  --passes=<n>          progressive passes of 1, 2, 4, ... spp (guiding: as many as fit)\n");
+        fprintf(stderr, "  --rcache=<bounces>    diffuse vertices this deep read a radiance cache (0: off)\n");
+        fprintf(stderr, "  --rcache-res=<n>      radiance cache cells along the largest scene dimension (64)\n");
+        fprintf(stderr, "  --caustics=<n>        caustic photon map with n emitted photons (0: off)\n");
+        fprintf(stderr, "  --caustics-k=<k>      photons per caustic density estimate (64)\n");
+        fprintf(stderr, "  --bdpt                bidirectional path tracing (ignores the options above)\n");
+        fprintf(stderr, "  --bdpt-depth=<n>      bdpt: maximum number of non specular bounces (2)\n");
+        fprintf(stderr, "  --vpl                 instant radiosity preview (ignores the path tracing options)\n");
+        fprintf(stderr, "  --vpl-paths=<n>       vpl: light paths depositing virtual point lights (2048)\n");
+        fprintf(stderr, "  --vpl-interleave=<k>  vpl: each pixel of a k x k tile gathers 1/k^2 of the VPLs (8)\n");
+        fprintf(stderr, "  --radiosity=<n>       radiosity pre-pass, n patches along the largest scene dimension\n");
+        fprintf(stderr, "  --radiosity-bounces=<b> radiosity: diffuse bounces after the direct light (1)\n");
+        fprintf(stderr, "  --aov=<file.aov>      also save the image of each light group (path tracing only ; see relight)\n");
+        fprintf(stderr, "  --denoise[=<n>]       edge-avoiding a-trous filter, n passes (5), on first hit albedo, normal, depth\n");
+        fprintf(stderr, "  --res=<W>x<H>         image resolution (640x640)\n");
+        fprintf(stderr, "  --stream[=<rows>]     write bands of rows (16) while rendering, no full image in memory\n");
+        fprintf(stderr, "                        (one pass ; no bdpt, mlt, aov or denoise)\n");
+        fprintf(stderr, "  --ring-light[=<p>]    add a ring shaped mesh light of power p (20000) under the ceiling\n");
+        fprintf(stderr, "                        (Cornell box scenes)\n");
+        fprintf(stderr, "  --mlt                 primary sample space Metropolis ; spp: mutations per pixel\n");
+        fprintf(stderr, "                        (no light_cache, restir, adaptive rr, guiding or rcache)\n");
+        fprintf(stderr, "  --mlt-chains=<n>      mlt: number of Markov chains (256)\n");
+        fprintf(stderr, "  --mlt-bootstrap=<n>   mlt: samples of the normalization pass (100000)\n");
+        fprintf(stderr, "  --mlt-large=<p>       mlt: large step probability (0.3)\n");
         return 1;
     }
 
@@ -55,11 +88,130 @@ int main(int argc, const char *argv[]) {
         light_sampler_mode = DISTANCE_ONE;
     } else if (strcmp(light_sampler_mode_name, "distance_squared") == 0) {
         light_sampler_mode = DISTANCE_SQUARED_ONE;
+    } else if (strcmp(light_sampler_mode_name, "light_cache") == 0) {
+        light_sampler_mode = LIGHT_CACHE_ONE;
+    } else if (strcmp(light_sampler_mode_name, "ris") == 0) {
+        light_sampler_mode = RIS_ONE;
+    } else if (strcmp(light_sampler_mode_name, "restir") == 0) {
+        light_sampler_mode = RESTIR_ONE;
     } else {
         fprintf(stderr, "Unknown light sampler mode: %s\n", light_sampler_mode_name);
         return 1;
     }
 
+    RR_MODE rr_mode = RR_FIXED;
+    float rr_window = 5.f;
+    int rr_split = 4;
+    bool guiding = false;
+    int passes = 0;
+    int rcache_bounces = 0, rcache_res = 64;
+    int caustic_photons = 0, caustic_k = 64;
+    bool bdpt = false;
+    int bdpt_depth = 2;
+    bool vpl = false;
+    int vpl_paths = 2048, vpl_interleave = 8;
+    int radiosity_res = 0, radiosity_bounces = 1;
+    const char *aov_file = NULL;
+    int denoise = 0;
+    int stream_rows = 0;
+    float ring_light = 0.f;
+    bool mlt = false;
+    int mlt_chains = 256, mlt_bootstrap = 100000;
+    float mlt_large = 0.3f;
+    for (int a = 4; a < argc; a++) {
+        if (strcmp(argv[a], "--rr=fixed") == 0) {
+            rr_mode = RR_FIXED;
+        } else if (strcmp(argv[a], "--rr=adaptive") == 0) {
+            rr_mode = RR_ADAPTIVE;
+        } else if (strncmp(argv[a], "--rr-window=", 12) == 0) {
+            rr_window = strtof(argv[a] + 12, nullptr);
+        } else if (strncmp(argv[a], "--rr-split=", 11) == 0) {
+            rr_split = strtol(argv[a] + 11, nullptr, 10);
+        } else if (strcmp(argv[a], "--guiding") == 0) {
+            guiding = true;
+        } else if (strncmp(argv[a], "--passes=", 9) == 0) {
+            passes = strtol(argv[a] + 9, nullptr, 10);
+        } else if (strncmp(argv[a], "--rcache=", 9) == 0) {
+            rcache_bounces = strtol(argv[a] + 9, nullptr, 10);
+        } else if (strncmp(argv[a], "--rcache-res=", 13) == 0) {
+            rcache_res = strtol(argv[a] + 13, nullptr, 10);
+        } else if (strncmp(argv[a], "--caustics=", 11) == 0) {
+            caustic_photons = strtol(argv[a] + 11, nullptr, 10);
+        } else if (strncmp(argv[a], "--caustics-k=", 13) == 0) {
+            caustic_k = strtol(argv[a] + 13, nullptr, 10);
+        } else if (strcmp(argv[a], "--bdpt") == 0) {
+            bdpt = true;
+        } else if (strncmp(argv[a], "--bdpt-depth=", 13) == 0) {
+            bdpt_depth = strtol(argv[a] + 13, nullptr, 10);
+        } else if (strcmp(argv[a], "--vpl") == 0) {
+            vpl = true;
+        } else if (strncmp(argv[a], "--vpl-paths=", 12) == 0) {
+            vpl_paths = strtol(argv[a] + 12, nullptr, 10);
+        } else if (strncmp(argv[a], "--vpl-interleave=", 17) == 0) {
+            vpl_interleave = strtol(argv[a] + 17, nullptr, 10);
+        } else if (strncmp(argv[a], "--radiosity=", 12) == 0) {
+            radiosity_res = strtol(argv[a] + 12, nullptr, 10);
+        } else if (strncmp(argv[a], "--radiosity-bounces=", 20) == 0) {
+            radiosity_bounces = strtol(argv[a] + 20, nullptr, 10);
+        } else if (strncmp(argv[a], "--aov=", 6) == 0) {
+            aov_file = argv[a] + 6;
+        } else if (strcmp(argv[a], "--denoise") == 0) {
+            denoise = 5;
+        } else if (strncmp(argv[a], "--denoise=", 10) == 0) {
+            denoise = strtol(argv[a] + 10, nullptr, 10);
+        } else if (strncmp(argv[a], "--res=", 6) == 0) {
+            if (sscanf(argv[a] + 6, "%dx%d", &W, &H) != 2 || W <= 0 || H <= 0) {
+                fprintf(stderr, "Bad resolution: %s\n", argv[a] + 6);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--stream") == 0) {
+            stream_rows = 16;
+        } else if (strncmp(argv[a], "--stream=", 9) == 0) {
+            stream_rows = strtol(argv[a] + 9, nullptr, 10);
+        } else if (strcmp(argv[a], "--ring-light") == 0) {
+            ring_light = 20000.f;
+        } else if (strncmp(argv[a], "--ring-light=", 13) == 0) {
+            ring_light = strtof(argv[a] + 13, nullptr);
+        } else if (strcmp(argv[a], "--mlt") == 0) {
+            mlt = true;
+        } else if (strncmp(argv[a], "--mlt-chains=", 13) == 0) {
+            mlt_chains = strtol(argv[a] + 13, nullptr, 10);
+        } else if (strncmp(argv[a], "--mlt-bootstrap=", 16) == 0) {
+            mlt_bootstrap = strtol(argv[a] + 16, nullptr, 10);
+        } else if (strncmp(argv[a], "--mlt-large=", 12) == 0) {
+            mlt_large = strtof(argv[a] + 12, nullptr);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[a]);
+            return 1;
+        }
+    }
+    // Metropolis needs a shader that is a fixed function of its random numbers
+    if (mlt && !bdpt && !vpl && radiosity_res <= 0 && (light_sampler_mode == LIGHT_CACHE_ONE || light_sampler_mode == RESTIR_ONE ||
+                         rr_mode == RR_ADAPTIVE || guiding || rcache_bounces > 0)) {
+        fprintf(stderr, "--mlt: the shader must not learn while rendering\n");
+        return 1;
+    }
+
+    // only the path tracer records the radiance of each light
+    if (aov_file != NULL && (bdpt || vpl || radiosity_res > 0 || mlt)) {
+        fprintf(stderr, "--aov: path tracing with the standard renderer only\n");
+        return 1;
+    }
+
+    // the features are recorded by the standard renderer
+    if (denoise > 0 && mlt) {
+        fprintf(stderr, "--denoise: not with --mlt\n");
+        return 1;
+    }
+
+    // the rows leave as they are done: nothing may touch the whole image after
+    if (stream_rows > 0 && (bdpt || mlt || aov_file != NULL || denoise > 0 || passes > 1 || guiding)) {
+        fprintf(stderr, "--stream: one pass of the standard renderer, no bdpt, mlt, aov, denoise or guiding\n");
+        return 1;
+    }
+    // streaming: no image plane
+    img = (stream_rows > 0 ? new ImagePPM() : new ImagePPM(W, H));
+
     /* Scenes*/
 
     /* Single Sphere */
@@ -91,6 +243,16 @@ int main(int argc, const char *argv[]) {
     const float deFocusRad = 5.*3.14f/180.f;    // to radians
     const float FocusDist = 5.;*/
 
+    /*EnvironmentScene (scene, "billFlowers.ppm", 2.f);
+    const Point Eye ={0.,2.5,-2.}, At={0.,1.,6.};
+    const float deFocusRad = 0.;
+    const float FocusDist = 1.;*/
+
+    if (ring_light > 0.f) CornellRingLight(scene, ring_light);
+
+    // build the light table used by the light selection strategies
+    scene.SetLights();
+
     const Vector Up = {0, 1, 0};
     const float fovH = 60.f;
     const float fovHrad = fovH * 3.14f / 180.f; // to radians
@@ -108,21 +270,75 @@ int main(int argc, const char *argv[]) {
     //shd = new AmbientShader(&scene, RGB(0.1,0.1,0.8));
     //shd = new WhittedShader(&scene, RGB(0.1,0.1,0.8));
     //shd = new DistributedShader(&scene, RGB(0.1,0.1,0.8));
-    shd = new PathTracing(&scene, RGB(0., 0., 0.2), light_sampler_mode);
+    if (bdpt) {
+        BDPT *bd = new BDPT(&scene, cam, RGB(0., 0., 0.2), W, H, bdpt_depth);
+        // the Metropolis chains only see the radiance returned by shade
+        bd->SetLightTracing(!mlt);
+        shd = bd;
+    } else if (vpl) {
+        VPLShader *vs = new VPLShader(&scene, RGB(0., 0., 0.2), vpl_paths, vpl_interleave);
+        fprintf(stderr, "%d virtual point lights\n", vs->size());
+        shd = vs;
+    } else if (radiosity_res > 0) {
+        // view independent: solved once, before rendering
+        clock_t const solve = clock();
+        Radiosity *rad = new Radiosity(&scene, radiosity_res, radiosity_bounces);
+        fprintf(stderr, "%d patches, %d shot ; radiosity time = %.3lf secs\n", rad->size(), rad->shot, ((double) (clock() - solve)) / CLOCKS_PER_SEC);
+        shd = new RadiosityShader(&scene, RGB(0., 0., 0.2), rad);
+    } else {
+        PathTracing *pt = new PathTracing(&scene, RGB(0., 0., 0.2), light_sampler_mode, W, H);
+        pt->SetRussianRoulette(rr_mode, rr_window, rr_split);
+        pt->SetPathGuiding(guiding);
+        pt->SetRadianceCache(rcache_bounces, rcache_res);
+        pt->SetCausticPhotons(caustic_photons, caustic_k);
+        shd = pt;
+    }
     // declare the renderer
 
-    bool const jitter = true;
-    StandardRenderer myRender(cam, &scene, img, shd, spp, jitter);
+    Renderer *myRender;
+    ImageAOV *aov = NULL;
+    FeatureBuffers *features = NULL;
+    ImageStream *stream = NULL;
+    if (mlt) {
+        MLTRenderer *mltRender = new MLTRenderer(cam, &scene, img, shd, spp, mlt_chains, mlt_bootstrap);
+        mltRender->SetMutations(0.01f, mlt_large);
+        myRender = mltRender;
+    } else {
+        bool const jitter = true;
+        StandardRenderer *stdRender = new StandardRenderer(cam, &scene, img, shd, spp, jitter);
+        if (passes == 0 && guiding) passes = spp;
+        stdRender->SetPasses(passes);
+        if (aov_file != NULL) {
+            aov = new ImageAOV(W, H, scene.lightGroupNames);
+            stdRender->SetLightAOV(aov);
+        }
+        if (denoise > 0) {
+            features = new FeatureBuffers(W, H);
+            stdRender->SetFeatures(features);
+            img->SetDenoiser(features, denoise);
+        }
+        if (stream_rows > 0) {
+            stream = new ImageStream(W, H, stream_rows);
+            if (!stream->Open(output_file)) return 1;
+            stdRender->SetStream(stream);
+        }
+        myRender = stdRender;
+    }
     // render
     start = clock();
 
-    myRender.Render();
+    myRender->Render();
 
     end = clock();
     cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
 
     // save the image
-    img->Save(output_file);
+    if (stream != NULL) {
+        if (!stream->Close()) fprintf(stderr, "Error writing %s\n", output_file);
+    } else {
+        img->Save(output_file);
+    }
+    if (aov != NULL) aov->Save(aov_file);
 
     fprintf(stdout, "Rendering time = %.3lf secs\n\n", cpu_time_used);
 
@@ -0,0 +1,78 @@
+//
+//  AliasTable.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Walker's alias method (with Vose's construction): after an O(N) build,
+//  an index is sampled with probability proportional to its weight in O(1).
+//
+
+#ifndef AliasTable_hpp
+#define AliasTable_hpp
+
+#include <vector>
+#include <cstddef>
+
+class AliasTable {
+    std::vector<float> prob;    // probability of keeping the bin's own index
+    std::vector<int> alias;     // index returned otherwise
+    std::vector<float> pmfs;    // normalized weights
+public:
+    AliasTable () {}
+    AliasTable (const std::vector<float> &weights) { build(weights); }
+    int size (void) const { return (int)pmfs.size(); }
+    // weights must be >= 0 ; if all are 0 the distribution is uniform
+    void build (const std::vector<float> &weights) {
+        int const N = (int)weights.size();
+        prob.assign(N, 1.f);
+        alias.resize(N);
+        pmfs.resize(N);
+        if (N == 0) return;
+        double total = 0.;
+        for (int i=0 ; i<N ; i++) total += weights[i];
+        for (int i=0 ; i<N ; i++) pmfs[i] = (total > 0. ? (float)(weights[i] / total) : 1.f / N);
+        // scaled probabilities: bins with less than 1 are filled with the excess of the others
+        std::vector<double> q(N);
+        std::vector<int> small, large;
+        for (int i=0 ; i<N ; i++) {
+            q[i] = (double)pmfs[i] * N;
+            alias[i] = i;
+            if (q[i] < 1.) small.push_back(i);
+            else large.push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            int const s = small.back(); small.pop_back();
+            int const l = large.back(); large.pop_back();
+            prob[s] = (float)q[s];
+            alias[s] = l;
+            q[l] -= 1. - q[s];
+            if (q[l] < 1.) small.push_back(l);
+            else large.push_back(l);
+        }
+        // the remaining bins are (up to rounding errors) full
+        for (int i : small) prob[i] = 1.f;
+        for (int i : large) prob[i] = 1.f;
+    }
+    // sample an index with u in [0,1[ ; pmf is its probability
+    // u_remapped is a new uniform number in [0,1[ derived from u, that may be reused
+    int sample (const float u, float &pmf, float *u_remapped=NULL) const {
+        int const N = (int)prob.size();
+        float const uN = u * N;
+        int i = (int)uN;
+        if (i >= N) i = N-1;
+        float const up = uN - i;
+        int chosen;
+        if (up < prob[i]) {
+            chosen = i;
+            if (u_remapped != NULL) *u_remapped = up / prob[i];
+        } else {
+            chosen = alias[i];
+            if (u_remapped != NULL) *u_remapped = (up - prob[i]) / (1.f - prob[i]);
+        }
+        if (u_remapped != NULL && *u_remapped >= 1.f) *u_remapped = 0.99999994f;
+        pmf = pmfs[chosen];
+        return chosen;
+    }
+    float pmf (const int i) const { return pmfs[i]; }
+};
+
+#endif /* AliasTable_hpp */
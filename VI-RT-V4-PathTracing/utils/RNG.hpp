@@ -0,0 +1,111 @@
+//
+//  RNG.hpp
+//  VI-RT-V4-PathTracing
+//
+//  The random number engine of the shaders and cameras. It is a Mersenne
+//  Twister, unless a PrimarySample is active on the calling thread: then it
+//  returns the coordinates of that primary sample vector, in the order they
+//  are asked for. std::uniform_real_distribution<float> takes a single 32 bit
+//  value per number, so each U_dist(rng) call reads exactly one coordinate.
+//
+//  PrimarySample is the mutating vector of primary sample space Metropolis
+//  light transport (Kelemen et al., "A simple and robust mutation strategy
+//  for the Metropolis light transport algorithm", 2002 ; pbrt book, sec 16.4.2):
+//  large steps draw fresh uniform coordinates, small steps perturb them with a
+//  normal of standard deviation sigma (wrapped to [0,1[). Coordinates are
+//  mutated lazily, when used, catching up with the iterations they missed.
+//
+
+#ifndef RNG_hpp
+#define RNG_hpp
+
+#include <random>
+#include <vector>
+#include <cstdint>
+#include <math.h>
+
+class PrimarySample {
+    typedef struct Coord {
+        float value, backup;
+        long modified, backup_modified;   // iteration of the last mutation
+    } Coord;
+    std::vector<Coord> X;
+    std::mt19937 rng;
+    std::uniform_real_distribution<float> U_dist{0.0,1.0};
+    std::normal_distribution<float> N_dist{0.0,1.0};
+    float sigma, large_step_prob;
+    long iteration, last_large_step;
+    bool large_step;
+    int index;      // next coordinate
+    // bring X[i] up to date with the current iteration
+    void mutate (const int i) {
+        if (i >= (int)X.size()) X.resize(i + 1, Coord{0.f, 0.f, 0, 0});
+        Coord &c = X[i];
+        if (c.modified < last_large_step) {
+            c.value = U_dist(rng);
+            c.modified = last_large_step;
+        }
+        c.backup = c.value;
+        c.backup_modified = c.modified;
+        if (large_step) {
+            c.value = U_dist(rng);
+        } else if (c.modified < iteration) {
+            // the small steps it missed add up to a single normal
+            float const s = sigma * sqrtf((float)(iteration - c.modified));
+            c.value += N_dist(rng) * s;
+            c.value -= floorf(c.value);
+        }
+        c.modified = iteration;
+    }
+public:
+    // seed: the same seed gives the same first (large step) sample
+    PrimarySample (const unsigned long seed, const float sigma=0.01f, const float large_step_prob=0.3f):
+        rng(seed), sigma(sigma), large_step_prob(large_step_prob), iteration(0), last_large_step(0), large_step(true), index(0) {}
+    // the next sample: a large step with probability large_step_prob (the first always is)
+    void StartIteration (void) {
+        iteration++;
+        large_step = (iteration == 1 || U_dist(rng) < large_step_prob);
+        index = 0;
+    }
+    bool LargeStep (void) const { return large_step; }
+    void Accept (void) {
+        if (large_step) last_large_step = iteration;
+    }
+    // restore the coordinates the rejected iteration changed
+    void Reject (void) {
+        for (Coord &c : X) {
+            if (c.modified == iteration) {
+                c.value = c.backup;
+                c.modified = c.backup_modified;
+            }
+        }
+        iteration--;
+    }
+    float Next (void) {
+        mutate(index);
+        float const v = X[index++].value;
+        return (v < 1.f ? v : nextafterf(1.f, 0.f));
+    }
+    // the PrimarySample the RNGs of the calling thread read (NULL: none)
+    static PrimarySample *&Active (void) {
+        static thread_local PrimarySample *active = NULL;
+        return active;
+    }
+};
+
+class RNG {
+    std::mt19937 engine;
+public:
+    typedef uint32_t result_type;
+    RNG () {}
+    RNG (const result_type seed): engine(seed) {}
+    static constexpr result_type min (void) { return 0; }
+    static constexpr result_type max (void) { return 0xffffffffu; }
+    result_type operator() (void) {
+        PrimarySample *ps = PrimarySample::Active();
+        if (ps == NULL) return (result_type)engine();
+        return (result_type)(ps->Next() * 4294967296.);
+    }
+};
+
+#endif /* RNG_hpp */
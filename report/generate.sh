@@ -1,6 +1,6 @@
 spps=( 1 4 8 16 32 )
 
-samplermodes=( all_lights uniform importance importance_no_distance distance distance_squared )
+samplermodes=( all_lights uniform importance importance_no_distance distance distance_squared light_cache ris restir )
 
 EXEC="./build/apps/VI-RT-V4-PathTracing"
 OUTPUT_PATH="./report/outputs"
@@ -145,6 +145,49 @@
   ],
 )
 
+#generate(
+  title: [Light Cache],
+  description: [Grelha espacial (hash) em que cada célula guarda uma CDF sobre as luzes. A CDF é inicializada com a fórmula do _Importance_ multiplicada pela luminância de $K_d$ (a contribuição sem oclusão, na escala das amostras) e refinada com as contribuições reais (já com visibilidade) das luzes amostradas nessa célula.],
+  paths: generate_paths_spps("light_cache", spps),
+  formula: $
+    P_i = (1 - epsilon) times (overline(C_i)) / (sum_j overline(C_j)) + epsilon / N
+  $,
+  variables: [
+    - $overline(C_i)$ - Média das contribuições da luz $i$ amostradas na célula (a estimativa inicial conta como uma amostra)
+    - $epsilon$ - Fração uniforme ($= 0.1$), garante que nenhuma luz fica com probabilidade nula
+    - $N$ - número de luzes na cena
+  ],
+)
+
+#generate(
+  title: [RIS],
+  description: [_Resampled Importance Sampling_: são escolhidas $M$ luzes candidatas uniformemente e uma delas é mantida num _reservoir_ com peso proporcional à fórmula do _Importance_. É traçado um único raio de sombra para a luz escolhida.],
+  paths: generate_paths_spps("ris", spps),
+  formula: $
+    P_i = hat(p)_i / (sum_(j=1)^M hat(p)_j), quad W = 1 / (hat(p)_y) times 1 / M times sum_(j=1)^M hat(p)_j times N
+  $,
+  variables: [
+    - $hat(p)_i$ - Contribuição estimada da luz $i$ (fórmula do _Importance_)
+    - $M$ - número de candidatas ($= 16$)
+    - $N$ - número de luzes na cena
+  ],
+)
+
+#generate(
+  title: [ReSTIR],
+  description: [Igual ao _RIS_, mas nas interseções primárias o _reservoir_ é combinado com o da amostra anterior do mesmo pixel e com os dos pixeis à esquerda e acima (se estiverem na mesma superfície). A normalização é $1 / Z$ (`RESTIR_UNBIASED`): só contam as candidatas dos _reservoirs_ que poderiam ter escolhido a luz final. Dividir por $sum_k M_k$ é enviesado quando essa luz tem contribuição nula no ponto de algum deles.],
+  paths: generate_paths_spps("restir", spps),
+  formula: $
+    W = 1 / (hat(p)(y)) times (sum_(j=1)^M hat(p)(x_j) N + sum_k hat(p)(y_k) W_k M_k) / Z, quad Z = M [hat(p)(y) > 0] + sum_k M_k [hat(p)_k (y) > 0]
+  $,
+  variables: [
+    - $x_j$ - candidatas do _RIS_ neste ponto, $y$ - luz escolhida
+    - $W_k$, $M_k$ - peso e número de candidatas de cada _reservoir_ combinado ($M_k$ limitado a $20 M$)
+    - $hat(p)_k (y)$ - contribuição estimada da luz $y$ no ponto do _reservoir_ $k$
+    - $[dot]$ - 1 se a condição se verifica, 0 caso contrário
+  ],
+)
+
 = Imagens Resultados Agregadas
 
 #let paths = (
@@ -153,6 +196,9 @@
   (name: "distance_squared", title: "Distance Squared"),
   (name: "importance_no_distance", title: "Importance No Distance"),
   (name: "importance", title: "Importance"),
+  (name: "light_cache", title: "Light Cache"),
+  (name: "ris", title: "RIS"),
+  (name: "restir", title: "ReSTIR"),
   (name: "all_lights", title: "All Lights"),
 )
 
@@ -220,6 +266,37 @@
   generate_aggregated_table(paths, spp)
 }
 
+= Russian Roulette: Fixa vs Adaptativa
+
+Com `--rr=adaptive` o _path tracer_ compara o _throughput_ do caminho vezes a radiância secundária média com a estimativa corrente do pixel: abaixo da janela de pesos o caminho sobrevive com probabilidade proporcional, acima é dividido (_splitting_). A roleta fixa termina os caminhos com probabilidade constante depois de `MIN_DEPTH`.
+
+Medições na cena `DLightChallenge` com o _sampler_ _Importance_, num único núcleo. O tempo é o da execução completa (carregamento da cena incluído) e o RMSE (8 bits) é calculado contra uma referência de 256 SPP com a roleta fixa.
+
+#let rr_results = (
+  (rr: "Fixa", spp: 4, time: 6.1, rmse: 15.514),
+  (rr: "Adaptativa", spp: 4, time: 6.9, rmse: 15.493),
+  (rr: "Fixa", spp: 8, time: 11.9, rmse: 11.793),
+  (rr: "Adaptativa", spp: 8, time: 12.5, rmse: 11.998),
+  (rr: "Fixa", spp: 16, time: 21.1, rmse: 8.977),
+  (rr: "Adaptativa", spp: 16, time: 22.2, rmse: 9.214),
+)
+
+#table(
+  columns: 5,
+  [Russian Roulette], [SPP], [Tempo (s)], [RMSE], [Eficiência ($10^3 / ("RMSE" times t)$)],
+  ..rr_results
+    .map(entry => (
+      entry.rr,
+      str(entry.spp),
+      [#entry.time],
+      [#entry.rmse],
+      [#calc.round(1000 / (entry.rmse * entry.time), digits: 2)],
+    ))
+    .flatten()
+)
+
+A roleta adaptativa é 5 a 13% mais lenta para o mesmo número de amostras (o custo da estimativa por pixel e dos caminhos divididos) e só reduz o RMSE a 4 SPP, e por muito pouco (15.49 vs 15.51). A 8 e 16 SPP o RMSE é até ligeiramente maior. A eficiência da roleta fixa é superior em todas as medições: *a tempo igual, a roleta adaptativa perde nesta medição*. Os caminhos desta cena são curtos e o _throughput_ varia pouco, pelo que a janela de pesos provavelmente pouco difere da roleta fixa; a roleta fixa continua a ser o valor por omissão.
+
 #pagebreak()
 
 = Metodologia